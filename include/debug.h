@@ -12,6 +12,7 @@ void DebugStart(size_t line, const char* file);
 void DebugEnd();
 size_t DebugGetSizeBytes(void* ptr);
 void DebugPrintMemory();
+void DebugThreadEnd();
 
 #ifdef DEBUG
 
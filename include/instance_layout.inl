@@ -0,0 +1,57 @@
+// Instance layouts, the single source for the C structs in vk.h, their vertex attributes and the vertex
+// shader inputs. Included from C and from GLSL, so only the preprocessor may see this file.
+//
+// FIELD(location, c_declaration, c_name, vk_format, glsl_declaration)
+// Fields are tightly packed in the order listed, vk_format is what the vertex fetch reads from the buffer
+// and glsl_declaration what the shader receives after conversion.
+#ifndef INSTANCE_LAYOUT_INL
+#define INSTANCE_LAYOUT_INL
+
+#define INSTANCE_DATA_SIZE 64
+#define INSTANCE_DATA_FIELDS(FIELD) \
+    FIELD(0, float pos[2],              pos,            VK_FORMAT_R32G32_SFLOAT,        vec2 inPos)             /* pixels, 0 to target width and height */ \
+    FIELD(1, float size[2],             size,           VK_FORMAT_R32G32_SFLOAT,        vec2 inSize)            /* width, height */ \
+    FIELD(2, float rotation,            rotation,       VK_FORMAT_R32_SFLOAT,           float inRotation)       /* degrees */ \
+    FIELD(3, float corner_radius,       corner_radius,  VK_FORMAT_R32_SFLOAT,           float inCornerRadius)   /* pixels */ \
+    FIELD(4, unsigned int color,        color,          VK_FORMAT_R32_UINT,             uint inColor)           /* background color packed as RGBA8 */ \
+    FIELD(5, unsigned int tex_index,    tex_index,      VK_FORMAT_R32_UINT,             uint inTexIndex)        /* texture ID and other info */ \
+    FIELD(6, float tex_rect[4],         tex_rect,       VK_FORMAT_R32G32B32A32_SFLOAT,  vec4 inTexRect)         /* u, v, width, height */ \
+    FIELD(7, unsigned int corner_radii, corner_radii,   VK_FORMAT_R32_UINT,             uint inCornerRadii)     /* pixels per corner, see VK_CORNER_RADII, 0 uses corner_radius for all four */ \
+    FIELD(8, unsigned int border_color, border_color,   VK_FORMAT_R32_UINT,             uint inBorderColor)     /* RGBA8 */ \
+    FIELD(9, float border_width,        border_width,   VK_FORMAT_R32_SFLOAT,           float inBorderWidth)    /* pixels inside the edge, 0 for none */ \
+    FIELD(10, float edge_softness,      edge_softness,  VK_FORMAT_R32_SFLOAT,           float inEdgeSoftness)   /* pixels added to the one pixel anti-aliased edge */
+
+// Quantized to 24 bytes without per-corner radii, border or softness, see vk_InstanceData_Pack
+#define INSTANCE_PACKED_POS_SCALE 8.0
+#define INSTANCE_PACKED_POS_BIAS  4096.0
+#define INSTANCE_DATA_PACKED_SIZE 24
+#define INSTANCE_DATA_PACKED_FIELDS(FIELD) \
+    FIELD(0, uint16_t pos[2],           pos,            VK_FORMAT_R16G16_UINT,          uvec2 inPosFixed)       /* pixels plus the bias in 13.3 fixed point, -4096 to 4095.875 */ \
+    FIELD(1, uint16_t size[2],          size,           VK_FORMAT_R16G16_SFLOAT,        vec2 inSize)            /* pixels as half floats */ \
+    FIELD(2, uint32_t rotation_radius,  rotation_radius, VK_FORMAT_R32_UINT,            uint inRotationRadius)  /* bits 0-15 rotation in 1/65536 turns, 16-23 corner radius in pixels, 24-31 texture index */ \
+    FIELD(3, uint32_t color,            color,          VK_FORMAT_R32_UINT,             uint inColor)           /* RGBA8 */ \
+    FIELD(4, uint16_t tex_rect[4],      tex_rect,       VK_FORMAT_R16G16B16A16_UNORM,   vec4 inTexRect)         /* unorm16 (u, v, width, height) */
+
+// Vertex pulling reads InstanceData as std430 from storage buffers in this set, indirected through a list
+// of 4 byte instance indices, instead of from a vertex buffer
+#define INSTANCE_PULL_SET               0
+#define INSTANCE_PULL_DATA_BINDING      0
+#define INSTANCE_PULL_INDICES_BINDING   1
+
+// Geometry the vertex shader generates per instance, its INSTANCE_MESH specialization constant. The
+// octagon cuts the corners outside the rounded shape, the ring is the octagon without the opaque interior
+// and the interior is that region alone, drawn without blending. Instances that are translucent or
+// textured have no opaque interior, it collapses and the ring covers them whole. Drawing every interior
+// and then every ring only keeps back to front order when the instances do not overlap, overlapping
+// instances use the quad or the octagon.
+#define INSTANCE_MESH_QUAD      0u
+#define INSTANCE_MESH_OCTAGON   1u
+#define INSTANCE_MESH_RING      2u
+#define INSTANCE_MESH_INTERIOR  3u
+
+// The vertex shader inputs, INSTANCE_DATA_FIELDS(INSTANCE_GLSL_INPUT)
+#define INSTANCE_GLSL_INPUT(loc, c_declaration, c_name, vk_format, glsl_declaration) layout(location = loc) in glsl_declaration;
+// Struct members and variables for shaders that pull the instances themselves
+#define INSTANCE_GLSL_DECLARATION(loc, c_declaration, c_name, vk_format, glsl_declaration) glsl_declaration;
+
+#endif
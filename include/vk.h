@@ -3,13 +3,31 @@
 // Λόγος
 
 #include <vulkan/vulkan.h>
+#ifdef VK_NO_SHADERC
+// Release builds only load prebuilt SPIR-V, these stand in for the shaderc types the API uses
+typedef enum {
+    shaderc_vertex_shader,
+    shaderc_fragment_shader,
+    shaderc_compute_shader,
+    shaderc_geometry_shader,
+    shaderc_tess_control_shader,
+    shaderc_tess_evaluation_shader,
+    shaderc_glsl_vertex_shader          = shaderc_vertex_shader,
+    shaderc_glsl_fragment_shader        = shaderc_fragment_shader,
+    shaderc_glsl_compute_shader         = shaderc_compute_shader,
+} shaderc_shader_kind;
+typedef void* shaderc_compiler_t;
+typedef void* shaderc_compile_options_t;
+#else
 #include <shaderc/shaderc.h>
+#endif
 #include <vk_mem_alloc.h>
 #include "spirv_reflect.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> 
+#include <pthread.h>
 
 #define DEBUG
 #include "debug.h"
@@ -20,21 +38,89 @@ void* alloc(void* ptr, size_t size);
 
 // Structures
 
+#define VK_REFLECT_MAX_INPUTS           16
+#define VK_REFLECT_MAX_BINDINGS         16
+#define VK_REFLECT_MAX_SPEC_CONSTANTS   16
+#define VK_REFLECT_NAME_SIZE            32
+
 typedef struct {
-    const unsigned int* code;
-    size_t          size;
+    unsigned int        location;
+    VkFormat            format;
+} Vk_ReflectedInput;
+
+typedef struct {
+    unsigned int        set;
+    unsigned int        binding;
+    VkDescriptorType    type;
+    unsigned int        count;
+} Vk_ReflectedBinding;
+
+typedef struct {
+    unsigned int        constant_id;
+    char                name[VK_REFLECT_NAME_SIZE];
+} Vk_ReflectedSpecConstant;
+
+// What the pipeline code needs from a shader. Reflected once and plain data, so it is cached on disk with the SPIR-V.
+typedef struct {
+    VkShaderStageFlagBits       stage;
+    unsigned int                local_size[3];          // compute only
+    unsigned int                inputs_count;           // without built-ins, sorted by location
+    Vk_ReflectedInput           inputs[VK_REFLECT_MAX_INPUTS];
+    unsigned int                bindings_count;
+    Vk_ReflectedBinding         bindings[VK_REFLECT_MAX_BINDINGS];
+    unsigned int                push_constant_offset;   // range this stage uses, size 0 without push constants
+    unsigned int                push_constant_size;
+    unsigned int                spec_constants_count;
+    Vk_ReflectedSpecConstant    spec_constants[VK_REFLECT_MAX_SPEC_CONSTANTS];
+} Vk_ShaderReflection;
+
+typedef struct {
+    const unsigned int*         code;
+    size_t                      size;
+    const Vk_ShaderReflection*  p_reflection;   // NULL until reflected, then right after the code in the same allocation
 } SpvShader;
 
 typedef struct {
-    float pos[2];        // middle_x, middle_y
-    float size[2];       // width, height
-    float rotation;      // rotation angle
-    float corner_radius; // pixels
-    unsigned int color;      // background color packed as RGBA8
-    unsigned int tex_index;  // texture ID and other info
-    float tex_rect[4];   // texture rectangle (u, v, width, height)
+    const char*     name;
+    const char*     value;      // NULL defines the name without a value
+} Vk_ShaderDefine;
+
+// Specialization constant set by the name the shader declares it with, bools and floats as their 32 bits
+typedef struct {
+    const char*     name;
+    unsigned int    value;
+} Vk_SpecConstant;
+
+// The instance layouts are generated from instance_layout.inl, which the vertex shader includes too
+#include "instance_layout.inl"
+#define VK_INSTANCE_STRUCT_FIELD(location, c_declaration, c_name, vk_format, glsl_declaration) c_declaration;
+
+typedef struct {
+    INSTANCE_DATA_FIELDS(VK_INSTANCE_STRUCT_FIELD)
 } InstanceData;
 
+// Bits 0-7 top-left, 8-15 top-right, 16-23 bottom-right, 24-31 bottom-left, in pixels
+#define VK_CORNER_RADII(top_left, top_right, bottom_right, bottom_left) \
+    ((unsigned int)(top_left) | (unsigned int)(top_right) << 8 | (unsigned int)(bottom_right) << 16 | (unsigned int)(bottom_left) << 24)
+
+// InstanceData quantized to 24 bytes, decoded by shader_packed.vert.glsl. Pack with vk_InstanceData_Pack,
+// draw with the layout from vk_VertexLayout_InstanceDataPacked. Positions outside -4096 to 4095.875 pixels
+// clamp to that range, texture indices above 255 and corner radii outside 0 to 255 clamp too.
+typedef struct {
+    INSTANCE_DATA_PACKED_FIELDS(VK_INSTANCE_STRUCT_FIELD)
+} InstanceDataPacked;
+
+#define VK_INSTANCE_PACKED_POS_SCALE ((float)INSTANCE_PACKED_POS_SCALE)
+#define VK_INSTANCE_PACKED_POS_BIAS  ((float)INSTANCE_PACKED_POS_BIAS)
+
+// Instance attributes of one vertex buffer binding, see vk_VertexLayout_InstanceData. A stride of 0 has no
+// binding, the vertex shader pulls its instances.
+typedef struct {
+    const VkVertexInputAttributeDescription*    p_attributes;
+    unsigned int                                attributes_count;
+    unsigned int                                stride;
+} Vk_VertexLayout;
+
 typedef struct {
     float targetWidth;
     float targetHeight;
@@ -42,6 +128,13 @@ typedef struct {
     float padding[2];
 } UniformBufferObject;
 
+// Small per-draw data pushed with the draw instead of going through a uniform buffer, laid out like the
+// push_constant block of shader.vert.inl
+typedef struct {
+    float           target_size[2];     // pixels
+    float           scroll_offset[2];   // pixels, added to every instance position
+} Vk_PushConstants;
+
 typedef struct {
     unsigned int graphics;
     unsigned int present;
@@ -63,42 +156,377 @@ typedef struct {
     VmaMemoryUsage usage;
 } Buffer;
 
+typedef enum {
+    VK_IMAGE_USE_COPY_SRC,          // copy or blit source
+    VK_IMAGE_USE_COPY_DST,          // copy, blit or clear destination
+    VK_IMAGE_USE_SAMPLED,           // sampled in fragment shaders
+    VK_IMAGE_USE_SAMPLED_COMPUTE,   // sampled in compute shaders
+    VK_IMAGE_USE_STORAGE,           // read and written as a storage image in compute shaders
+    VK_IMAGE_USE_COLOR_ATTACHMENT,
+    VK_IMAGE_USE_DEPTH_ATTACHMENT,
+    VK_IMAGE_USE_PRESENT,
+    VK_IMAGE_USE_COUNT
+} Vk_ImageUse;
+
+typedef struct {
+    VkImageLayout           layout;
+    VkPipelineStageFlags2   stage;          // stages of the accesses since the last barrier
+    VkAccessFlags2          access;
+    unsigned int            queue_family;   // of the first use that named one, VK_QUEUE_FAMILY_IGNORED before
+} Vk_ImageState;
+
 typedef struct {
     VkImage image;
-    VkImageLayout layout;
+    VkImageLayout layout;           // of the first subresource, the same for all of them unless tracked per range
     VkExtent2D extent;
     VkFormat format;
     VmaAllocation allocation;
     VkImageView view;
     VkSampler sampler;
+    unsigned int mip_levels;
+    unsigned int array_layers;
+    Vk_ImageState* p_states;        // mip_levels * array_layers, layer major, allocated on first tracked use
+    unsigned int texture_index;     // slot in the texture table, the tex_index instances sample it with, 0 for none
 } Image;
 
+#define VK_BARRIER_BATCH_MAX_IMAGE_BARRIERS  16
+#define VK_BARRIER_BATCH_MAX_BUFFER_BARRIERS 16
+
+typedef struct {
+    VkMemoryBarrier2        memory_barrier;     // all global barriers of a sync point are merged into one
+    bool                    has_memory_barrier;
+    VkImageMemoryBarrier2   image_barriers[VK_BARRIER_BATCH_MAX_IMAGE_BARRIERS];
+    unsigned int            image_barriers_count;
+    VkBufferMemoryBarrier2  buffer_barriers[VK_BARRIER_BATCH_MAX_BUFFER_BARRIERS];
+    unsigned int            buffer_barriers_count;
+} Vk_BarrierBatch;
+
+#define VK_RECORDER_MAX_DESC_SETS      8
+#define VK_RECORDER_MAX_VERTEX_BUFFERS 4
+#define VK_RECORDER_MAX_PUSH_CONSTANTS 128  // the smallest maxPushConstantsSize a device may have
+
+// State commands a Vk_CommandRecorder was asked for, by kind
+typedef struct {
+    unsigned int pipeline_binds;
+    unsigned int desc_set_binds;
+    unsigned int vertex_buffer_binds;
+    unsigned int viewport_sets;
+    unsigned int scissor_sets;
+    unsigned int push_constant_sets;
+} Vk_RecorderCounters;
+
+typedef struct {
+    Vk_RecorderCounters issued;
+    Vk_RecorderCounters elided;
+} Vk_RecorderStats;
+
+typedef struct {
+    VkPipeline          pipeline;
+    VkPipelineLayout    pipeline_layout;
+    VkDescriptorSet     desc_sets[VK_RECORDER_MAX_DESC_SETS];
+} Vk_RecorderBindPoint;
+
+typedef struct {
+
+    VkCommandBuffer         command_buffer;
+    Vk_RecorderBindPoint    bind_points[2];     // graphics, compute
+    VkBuffer                vertex_buffers[VK_RECORDER_MAX_VERTEX_BUFFERS];
+    VkDeviceSize            vertex_offsets[VK_RECORDER_MAX_VERTEX_BUFFERS];
+    VkViewport              viewport;
+    bool                    viewport_valid;
+    VkRect2D                scissor;
+    bool                    scissor_valid;
+    VkPipelineLayout        push_constants_layout;  // of the last push, VK_NULL_HANDLE until something was pushed
+    VkPushConstantRange     push_constants_range;
+    unsigned char           push_constants[VK_RECORDER_MAX_PUSH_CONSTANTS];
+    Vk_RecorderStats        stats;
+
+} Vk_CommandRecorder;
+
+typedef enum {
+    VK_FRAME_STAGE_UPLOAD,      // staging copies and fills recorded by Vk_FrameSubmit
+    VK_FRAME_STAGE_COMPUTE,
+    VK_FRAME_STAGE_RENDER,
+    VK_FRAME_STAGE_READBACK,    // device to host copies recorded by Vk_FrameSubmit
+    VK_FRAME_STAGE_COUNT
+} Vk_FrameStage;
+
+// vk_StartApp waits on the previous frame's fence before recording the next, so only one frame is in flight
+#define VK_FRAMES_IN_FLIGHT                 1
+#define VK_FRAME_SUBMIT_MAX_COMMAND_BUFFERS 8
+#define VK_FRAME_SUBMIT_MAX_SEMAPHORES      4
+
+typedef struct {
+    VkCommandBufferSubmitInfo   command_buffers[VK_FRAME_SUBMIT_MAX_COMMAND_BUFFERS];
+    unsigned int                command_buffers_count;
+    VkSemaphoreSubmitInfo       waits[VK_FRAME_SUBMIT_MAX_SEMAPHORES];
+    unsigned int                waits_count;
+    VkSemaphoreSubmitInfo       signals[VK_FRAME_SUBMIT_MAX_SEMAPHORES];
+    unsigned int                signals_count;
+} Vk_SubmitBatch;
+
+typedef struct {
+    VkBuffer        buffer;
+    VkDeviceSize    offset;
+    VkDeviceSize    size;
+} Vk_BufferRange;
+
+typedef struct {
+    Buffer          staging;
+    void*           p_dst;
+    size_t          size;
+} Vk_Readback;
+
+typedef enum {
+    VK_RETIRED_BUFFER,
+    VK_RETIRED_IMAGE,
+    VK_RETIRED_IMAGE_VIEW,
+    VK_RETIRED_SAMPLER,
+    VK_RETIRED_DESCRIPTOR_SET,
+    VK_RETIRED_PIPELINE,
+    VK_RETIRED_PIPELINE_LAYOUT,
+    VK_RETIRED_COMMAND_BUFFER,
+    VK_RETIRED_TEXTURE_SLOT,
+} Vk_RetiredKind;
+
+// A resource retired while frame_index is recorded is destroyed once that frame completed. Command buffers
+// recorded once and submitted every frame, like the swapchain ones, keep referencing what they were recorded
+// with, so whoever retires such a resource records them again before frame_index is submitted. The retired
+// command buffers then go through the queue as well.
+typedef struct {
+    Vk_RetiredKind      kind;
+    uint64_t            retire_point;   // destroyed once this frame or timeline point has completed on the GPU
+    union {
+        struct { VkBuffer buffer; VmaAllocation allocation; }          buffer;
+        struct { VkImage image; VmaAllocation allocation; }            image;
+        VkImageView                                                     view;
+        VkSampler                                                       sampler;
+        struct { VkDescriptorPool pool; VkDescriptorSet set; }         desc_set;
+        VkPipeline                                                      pipeline;
+        VkPipelineLayout                                                pipeline_layout;
+        struct { VkCommandPool pool; VkCommandBuffer command_buffer; } command_buffer;
+        unsigned int                                                    texture_slot;
+    };
+} Vk_RetiredResource;
+
+#define VK_CACHE_PATH_SIZE              512
+
+// Optional device features, each one is only enabled when the device has it
+typedef struct {
+    unsigned int    api_version;                    // lower of the instance and device versions
+    bool            timeline_semaphore;
+    bool            synchronization2;
+    bool            descriptor_indexing;            // partially bound, non uniformly indexed, update after bind sampled image arrays, required by the texture table
+    bool            buffer_device_address;
+    bool            extended_dynamic_state;
+    bool            memory_budget;                  // VK_EXT_memory_budget, VMA tracks heap budgets with it
+    bool            pipeline_creation_cache_control;
+    bool            multi_draw_indirect;            // together with drawIndirectFirstInstance
+    unsigned int    max_draw_indirect_count;
+} Vk_Caps;
+
+#define VK_DESCRIPTOR_TYPES             (VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 1)  // the core types, counted per layout
+#define VK_DESCRIPTOR_POOL_MIN_SETS     32
+#define VK_DESCRIPTOR_POOL_MAX_SETS     4096
+
+// Descriptors of each type one set of the layout takes, recorded when the layout is created
+typedef struct {
+    VkDescriptorSetLayout   layout;
+    unsigned int            counts[VK_DESCRIPTOR_TYPES];
+} Vk_DescriptorLayoutSizes;
+
+// Hands out descriptor sets from a list of pools and creates another one when they have all run out. A new
+// pool takes the average descriptors per set allocated so far. Persistent sets are freed one at a time
+// through the deletion queue, transient ones all at once with vk_DescriptorAllocator_Reset.
+typedef struct {
+    bool                transient;
+    VkDescriptorPool*   p_pools;            // [0, ready_count) may have room left, the rest have run out
+    unsigned int        pools_count;
+    unsigned int        ready_count;
+    unsigned int        pools_capacity;
+    unsigned int        next_pool_sets;     // maxSets of the next pool, doubles with every pool
+    unsigned int        sets_since_reset;
+    uint64_t            sets_allocated;     // everything ever allocated, for the descriptors per set
+    uint64_t            descriptors_allocated[VK_DESCRIPTOR_TYPES];
+} Vk_DescriptorAllocator;
+
+// Every image is registered in one array of combined image samplers that stays bound, tex_index selects
+// the slot directly and slot 0 stays empty for untextured instances. The capacity is the lower of
+// VK_TEXTURE_TABLE_CAPACITY and the update after bind limits of the device.
+#define VK_TEXTURE_TABLE_SET        1
+#define VK_TEXTURE_TABLE_BINDING    0
+#define VK_TEXTURE_TABLE_CAPACITY   4096
+
+typedef struct {
+    VkDescriptorPool        pool;
+    VkDescriptorSetLayout   set_layout;     // shared by every pipeline layout with the table at VK_TEXTURE_TABLE_SET
+    VkDescriptorSet         set;
+    unsigned int            capacity;
+    unsigned int            used;           // slots below this were handed out at least once
+    unsigned int*           p_free;         // released slots, reused before used grows
+    unsigned int            free_count;
+} Vk_TextureTable;
+
 typedef struct {
 
     shaderc_compiler_t          shaderc_compiler;
     shaderc_compile_options_t   shaderc_options;
+    uint64_t                    shaderc_options_hash;       // of everything in shaderc_options that changes the output
+    char                        spv_cache_dir[VK_CACHE_PATH_SIZE];  // empty when compiled SPIR-V is not cached
     void*                       window_p;
     VkInstance                  instance;
     VkDebugUtilsMessengerEXT    debug_messenger;
     VkSurfaceKHR                surface;
     VkPhysicalDevice            physical_device;
     VkDevice                    device;
+    Vk_Caps                     caps;
     VkQueueFamilyIndices        queue_family_indices;
     VkQueues                    queues;
     VkCommandPool               command_pool;
-    VkDescriptorPool            descriptor_pool;
+    Vk_DescriptorAllocator      descriptor_allocator;       // persistent sets, freed through the deletion queue
+    Vk_DescriptorLayoutSizes*   p_layout_sizes;             // of every layout vk_DescriptorSetLayout_Create made
+    size_t                      layout_sizes_count;
+    size_t                      layout_sizes_capacity;
+    Vk_TextureTable             texture_table;
+    VkPipelineCache             pipeline_cache;             // shared by every pipeline, persisted per device and driver
+    char                        pipeline_cache_path[VK_CACHE_PATH_SIZE];
+    size_t                      pipeline_cache_saved_size;  // of the data on disk, saves are skipped while the data
+    uint64_t                    pipeline_cache_saved_hash;  // has the same size and hash
     VmaAllocator                allocator;
     VkSwapchainKHR              swap_chain;
     Image*                      p_images;
     size_t                      images_count;
+    Vk_RecorderStats            recorder_stats_this_frame;  // of the command recorders ended while recording the current frame
+    Vk_RecorderStats            recorder_stats_last_frame;  // the same for the previous frame, what vk_RecorderStats_Print shows
+    uint64_t                    frame_index;                // of the frame being recorded, starts at 1
+    Vk_RetiredResource*         p_retired;                  // deletion queue, ordered by retire_point
+    size_t                      retired_count;
+    size_t                      retired_capacity;
 
 } Vk;
 
+typedef struct {
+
+    Vk*                     p_vk;
+    VkQueue                 queue;
+    VkCommandPool           command_pool;           // reset as a whole in Vk_FrameSubmit_Begin
+    VkCommandBuffer         upload_command_buffer;
+    VkCommandBuffer         readback_command_buffer;
+    VkCommandBuffer         render_command_buffer;
+    bool                    upload_recording;
+    bool                    readback_recording;
+    bool                    render_recording;
+    Vk_SubmitBatch          batches[VK_FRAME_STAGE_COUNT];
+
+    bool                    async_compute;          // the compute stage goes to its own queue
+    VkQueue                 compute_queue;
+    unsigned int            compute_queue_family;
+    VkCommandPool           compute_command_pool;   // of compute_queue_family, reset with command_pool
+    VkCommandBuffer         compute_command_buffer;
+    bool                    compute_recording;
+    VkSemaphore             timeline;               // orders the stages across the two queues
+    uint64_t                timeline_value;         // last value signaled
+    uint64_t                compute_value;          // signaled by the last compute submission, the render stage of the same frame waits on it
+
+    Vk_DescriptorAllocator  descriptors;            // transient, one per frame in flight, reset in Vk_FrameSubmit_Begin
+
+    Buffer                  staging;                // linear arena, rewound every frame
+    VkDeviceSize            staging_offset;
+    Buffer*                 p_retired_staging;      // outgrown arenas, destroyed once the frame completed
+    size_t                  retired_staging_count;
+    size_t                  retired_staging_capacity;
+
+    Vk_BufferRange*         p_written;              // transfer writes since the last transfer barrier
+    size_t                  written_count;
+    size_t                  written_capacity;
+
+    Vk_Readback*            p_readbacks;
+    size_t                  readbacks_count;
+    size_t                  readbacks_capacity;
+
+} Vk_FrameSubmit;
+
+#define VK_TASK_GRAPH_MAX_TASKS         32
+#define VK_TASK_GRAPH_MAX_THREADS       16
+#define VK_TASK_MAX_DEPENDENCIES        8
+
+typedef void (*Vk_TaskFunction)(void* p_arg);
+
+typedef struct {
+    const char*         p_name;
+    Vk_TaskFunction     function;
+    void*               p_arg;
+    bool                main_thread;    // SDL windowing stays on the thread that calls Vk_TaskGraph_Run
+    unsigned int        dependencies[VK_TASK_MAX_DEPENDENCIES];
+    unsigned int        dependencies_count;
+    bool                started;
+    bool                finished;
+    unsigned int        thread;         // that ran the task, 0 is the calling thread
+    double              start_ms;       // relative to the start of Vk_TaskGraph_Run
+    double              end_ms;
+} Vk_Task;
+
+typedef struct {
+    Vk_Task             tasks[VK_TASK_GRAPH_MAX_TASKS];
+    unsigned int        tasks_count;
+    unsigned int        finished_count;
+    unsigned int        threads_count;  // including the calling thread
+    pthread_mutex_t     mutex;
+    pthread_cond_t      condition;      // signaled whenever a task finishes
+    double              run_start_ms;
+    double              run_ms;
+} Vk_TaskGraph;
+
+#define VK_SHADER_WATCH_MAX_FILES 8
+
+typedef VkPipeline (*Vk_ShaderWatchBuild)(void* p_arg);                     // watcher thread, VK_NULL_HANDLE on failure
+typedef void       (*Vk_ShaderWatchApply)(void* p_arg, VkPipeline pipeline); // render thread, owns the pipeline from then on
+
+// Rebuilds a pipeline in the background when its shader sources change on disk
+typedef struct {
+    Vk*                     p_vk;
+    char                    directory[VK_CACHE_PATH_SIZE];
+    char                    files[VK_SHADER_WATCH_MAX_FILES][128];     // names inside directory
+    unsigned int            files_count;
+    Vk_ShaderWatchBuild     build;
+    Vk_ShaderWatchApply     apply;
+    void*                   p_arg;
+    int                     inotify_fd;
+    int                     stop_fds[2];
+    pthread_t               thread;
+    bool                    running;
+    pthread_mutex_t         mutex;
+    VkPipeline              pending;                // built, waiting for the next frame boundary
+    uint64_t                generation;             // bumped by the watcher whenever pending is replaced
+    uint64_t                applied_generation;     // render thread only
+} Vk_ShaderWatch;
+
+#define VK_PIPELINE_VARIANTS_MAX 16
+
+typedef struct {
+    uint64_t                key;                // hash of p_description
+    unsigned char*          p_description;      // the defines and constants, compared on a key match
+    size_t                  description_size;
+    VkPipeline              pipeline;
+} Vk_PipelineVariant;
+
+// Pipelines built from one vertex and fragment shader pair and one layout, one per set of defines and
+// specialization constants. Variants are built on first use and kept until invalidated or destroyed.
+typedef struct {
+    Vk*                     p_vk;
+    VkPipelineLayout        pipeline_layout;
+    const Vk_VertexLayout*  p_vertex_layout;    // NULL uses the reflected vertex inputs
+    char                    vertex_filename[128];
+    char                    fragment_filename[128];
+    Vk_PipelineVariant      variants[VK_PIPELINE_VARIANTS_MAX];
+    unsigned int            variants_count;
+} Vk_PipelineVariants;
+
 typedef struct {
     const unsigned int*     p_spv_code;
     size_t                  spv_code_size;
     shaderc_shader_kind     shader_kind;
-    SpvReflectShaderModule  reflect_shader_module;
+    Vk_ShaderReflection     reflection;
     VkShaderModule          shader_module;
 } Gui_Shader;
 
@@ -110,95 +538,310 @@ typedef struct {
     VkDescriptorSetLayoutCreateInfo*    p_desc_sets_layout_create_info;
     VkDescriptorSetLayout*              p_desc_sets_layout;
     size_t                              desc_sets_count;
+    VkPushConstantRange                 push_constant_range;    // merged across stages, size 0 without push constants
     VkPipelineLayout                    pipeline_layout;
     VkPipeline                          graphics_pipeline;
+    bool                                dynamic_scissor; // viewport and scissor are set while recording
+    bool                                vertex_pulling;  // the vertex shader reads instances from storage buffers
+    unsigned int                        instance_mesh;   // INSTANCE_MESH_*, chosen before CreatePipeline
+    unsigned int                        vertex_count;    // per instance, drawn for instance_mesh
 
 } Vk_GraphicsPipeline;
 
 typedef struct {
 
-    Vk*                     p_vk;  
+    Vk*                                 p_vk;
+    Gui_Shader                          shader;
+    VkDescriptorSetLayoutCreateInfo*    p_desc_sets_layout_create_info;
+    VkDescriptorSetLayout*              p_desc_sets_layout;
+    size_t                              desc_sets_count;
+    VkPushConstantRange                 push_constant_range;    // size 0 without push constants
+    unsigned int                        local_size[3];          // workgroup size declared by the shader
+    VkPipelineLayout                    pipeline_layout;
+    VkPipeline                          compute_pipeline;
+
+} Vk_ComputePipeline;
+
+typedef struct {
+    unsigned int            layer;           // items are only reordered within the same layer, their instances must not overlap
+    Vk_GraphicsPipeline*    p_pipeline;      // NULL means the pipeline of the rendering, which then draws quads
+    VkDescriptorSet*        p_desc_sets;     // NULL means the descriptor sets of the rendering
+    size_t                  desc_sets_count;
+    VkRect2D                scissor;         // zero extent means the whole target
+    unsigned int            first_instance;
+    unsigned int            instance_count;
+    unsigned int            order;           // insertion index, keeps the sort stable
+} Vk_DrawItem;
+
+typedef struct {
+    Vk_GraphicsPipeline*    p_pipeline;
+    VkDescriptorSet*        p_desc_sets;
+    size_t                  desc_sets_count;
+    VkRect2D                scissor;
+    unsigned int            first_command;   // index into p_commands and the indirect buffer
+    unsigned int            commands_count;
+} Vk_DrawRun;
+
+typedef struct {
+
+    Vk*                     p_vk;
+
+    Vk_DrawItem*            p_items;
+    size_t                  items_count;
+    size_t                  items_capacity;
+
+    VkDrawIndirectCommand*  p_commands;
+    size_t                  commands_count;
+    Vk_DrawRun*             p_runs;
+    size_t                  runs_count;
+
+    Buffer                  indirect_buffer; // containing p_commands once the frame that built them uploaded
+    bool                    multi_draw_indirect;
+    unsigned int            max_draw_indirect_count;
+
+} Vk_DrawBatch;
+
+typedef struct {
+
+    Vk*                     p_vk;
     Vk_GraphicsPipeline*    p_pipeline;
     Image*                  p_target_image;
 
     VkDescriptorSet*        p_desc_sets;
     size_t                  desc_sets_count;
+    VkDescriptorPool        desc_pool;      // the descriptor allocator pool p_desc_sets came from
 
     VkCommandBuffer         command_buffer;
     bool                    command_buffer_needs_recording;
 
     Buffer                  indirect_buffer; // containing VkDrawIndirectCommand
     Buffer                  instance_buffer; // containing InstanceData array
+    Buffer                  instance_indices; // uint32 indices into instance_buffer, for pipelines with vertex pulling
+    Vk_DrawBatch*           p_draw_batch;    // replaces the single draw when not NULL
+    Vk_PushConstants        push_constants;  // pushed when the pipeline declares push constants
 
 } Vk_Rendering;
 
 // bedrock
+Vk                          vk_Initialize();
+void                        vk_Create_Shaderc(Vk* p_vk);
+void                        vk_Create_Instance(Vk* p_vk, unsigned int width, unsigned int height, const char* title);
+void                        vk_Create_Device(Vk* p_vk);
+void                        vk_Create_Swapchain(Vk* p_vk, unsigned int width, unsigned int height);
+void                        vk_Create_Pools(Vk* p_vk);
 Vk                          vk_Create(unsigned int width, unsigned int height, const char* title);
-void                        vk_StartApp(Vk* p_vk,VkSemaphore imageAvailableSemaphore,VkSemaphore renderFinishedSemaphore,VkFence inFlightFence,VkCommandBuffer* commandBuffers,VkBuffer uniformBuffer,VmaAllocation uniformBufferAllocation,Buffer instance_buffer);
+void                        vk_StartApp(Vk* p_vk,VkSemaphore imageAvailableSemaphore,VkSemaphore renderFinishedSemaphore,VkFence inFlightFence,Vk_GraphicsPipeline* p_pipeline,VkDescriptorSet* p_desc_sets,const Vk_PushConstants* p_push_constants,Buffer instance_buffer,unsigned int texture_index,Vk_ShaderWatch* p_shader_watch);
 void                        vk_Destroy(Vk* p_vk,VkPipeline graphicsPipeline,VkPipelineLayout pipelineLayout,VkDescriptorSetLayout descriptorSetLayout,VkBuffer uniformBuffer,VmaAllocation uniformBufferAllocation,VkBuffer instanceBuffer,VmaAllocation instanceBufferAllocation,VkDescriptorSet descriptorSet,VkCommandBuffer* commandBuffers,VkSemaphore imageAvailableSemaphore,VkSemaphore renderFinishedSemaphore,VkFence inFlightFence);
 
 // buffer
 Buffer                      vk_Buffer_Create( Vk* p_vk, VkDeviceSize size, VkBufferUsageFlags usage );
+Buffer                      vk_Buffer_CreateShared( Vk* p_vk, VkDeviceSize size, VkBufferUsageFlags usage );
 void                        vk_Buffer_Clear( Vk* p_vk, Buffer buffer, int clear_value) ;
 void                        vk_Buffer_Update( Vk* p_vk, Buffer buffer, VkDeviceSize dst_offset, const void* p_src_data, VkDeviceSize size );
 
 // image
 Image                       vk_Image_Create_ReadWrite( Vk* p_vk,  VkExtent2D extent,  VkFormat format );
+unsigned char*              vk_Image_DecodeFile( const char* filename, VkExtent2D* p_extent );
+void                        vk_Image_FreeDecoded( unsigned char* p_pixels );
+Image                       vk_Image_CreateFromPixels( Vk* p_vk, const unsigned char* p_pixels, VkExtent2D extent, VkFormat format, VkImageLayout layout );
 Image                       vk_Image_CreateFromImageFile( Vk* p_vk, const char* filename, VkFormat format, VkImageLayout layout );
 Image                       vk_Image_LoadFromFile( Vk* p_vk, const char* filename );
 Image                       vk_Image_CreateAtlas( Vk* p_vk, const char** filenames, unsigned int imageCount );
 void                        vk_Image_CopyData( Vk* p_vk, Image* p_image, VkImageLayout final_layout, const void* p_data, const VkRect2D rect, const size_t pixel_size );
-void                        vk_Image_TransitionLayout(VkCommandBuffer command_buffer, Image* p_image, VkImageLayout new_layout);
+VkImageAspectFlags          vk_Image_AspectMask(VkFormat format);
+VkImageSubresourceRange     vk_Image_FullRange(const Image* p_image);
+void                        vk_Image_Use(Vk_BarrierBatch* p_batch, Image* p_image, VkImageSubresourceRange range, Vk_ImageUse use);
+void                        vk_Image_UseOnQueue(Vk_BarrierBatch* p_batch, Image* p_image, VkImageSubresourceRange range, Vk_ImageUse use, unsigned int queue_family);
+void                        vk_Image_Release(Vk_BarrierBatch* p_batch, Image* p_image, VkImageSubresourceRange range, Vk_ImageUse use, unsigned int dst_queue_family);
+void                        vk_Image_TransitionLayout(Vk_BarrierBatch* p_batch, Image* p_image, VkImageSubresourceRange range, VkImageLayout new_layout);
 void                        vk_Image_TransitionLayoutWithoutCommandBuffer(Vk* p_vk, Image* p_image, VkImageLayout new_layout);
-void                        vk_Image_TransitionLayout_0(VkCommandBuffer command_buffer, VkImage* p_image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout);
-void                        vk_Image_Destroy( VkDevice device, VkImage* vulkanImage );
+void                        vk_Image_Destroy(Vk* p_vk, Image* p_image);
 
 // shader
 size_t                              readFile(const char* filename, char** dst_buffer);
+#ifndef VK_NO_SHADERC
 SpvShader                           vk_SpvShader_Create(Vk* p_vk, const char* p_glsl_code, size_t glsl_size, const char* glsl_filename, shaderc_shader_kind kind);
+SpvShader                           vk_SpvShader_CreateWithDefines(Vk* p_vk, const char* p_glsl_code, size_t glsl_size, const char* glsl_filename, shaderc_shader_kind kind, const Vk_ShaderDefine* p_defines, size_t defines_count);
 SpvShader                           vk_SpvShader_CreateFromGlslFile(Vk* p_vk, const char* filename, shaderc_shader_kind shader_kind);
+bool                                vk_SpvShader_TryCreateFromGlslFile(Vk* p_vk, const char* glsl_filename, shaderc_shader_kind shader_kind, SpvShader* p_spv_shader);
 void                                vk_SpvShader_CreateSpvFileFromGlslFile(Vk* p_vk, const char* glsl_filename, const char* spv_filename, shaderc_shader_kind shader_kind);
+VkShaderModule                      vk_ShaderModule_CreateFromGlslFile(Vk* p_vk, const char* filename, shaderc_shader_kind shader_kind);
+shaderc_include_result*             vk_ShaderInclude_Resolve(void* p_user_data, const char* p_requested, int type, const char* p_requesting, size_t depth);
+void                                vk_ShaderInclude_Release(void* p_user_data, shaderc_include_result* p_result);
+#endif
+SpvShader                           vk_SpvShader_CreateFromSpvFile(const char* spv_filename);
+bool                                vk_SpvShader_FindEmbedded(const char* spv_filename, SpvShader* p_spv_shader);
+SpvShader                           vk_SpvShader_Load(Vk* p_vk, const char* glsl_filename, shaderc_shader_kind shader_kind);
 SpvReflectShaderModule              vk_SpvReflectShaderModule_Create(SpvShader spv_shader);
+void                                vk_SpvShader_Reflect(SpvShader* p_spv_shader);
+Vk_ShaderReflection                 vk_ShaderReflection_Create(SpvShader spv_shader);
 VkShaderModule                      vk_ShaderModule_Create(Vk* p_vk, SpvShader spv_shader);
-VkShaderModule                      vk_ShaderModule_CreateFromGlslFile(Vk* p_vk, const char* filename, shaderc_shader_kind shader_kind);
 VkVertexInputAttributeDescription*  vk_VertexInputAttributeDescriptions_CreateFromVertexShader( SpvShader spv_shader, unsigned int* p_attribute_count, unsigned int* p_binding_stride );
+VkVertexInputAttributeDescription*  vk_VertexInputAttributeDescriptions_CreateFromReflection( const Vk_ShaderReflection* p_reflection, unsigned int* p_attribute_count, unsigned int* p_binding_stride );
 
 // descriptor
-VkDescriptorSetLayoutCreateInfo*    vk_DescriptorSetLayoutCreateInfo_Create( Vk* p_vk, const SpvReflectShaderModule* p_shader_modules, unsigned int shader_modules_count, size_t* p_desc_set_layout_count ); 
+VkDescriptorSetLayoutCreateInfo*    vk_DescriptorSetLayoutCreateInfo_Create( Vk* p_vk, const Vk_ShaderReflection* p_reflections, unsigned int reflections_count, size_t* p_desc_set_layout_count ); 
 void                                vk_DescriptorSetLayoutCreateInfo_Print(const VkDescriptorSetLayoutCreateInfo* p_create_info, const size_t create_info_count);
 VkDescriptorSetLayout*              vk_DescriptorSetLayout_Create(Vk* p_vk, const VkDescriptorSetLayoutCreateInfo* p_create_info, const size_t create_info_count);
 VkDescriptorSetLayout               vk_DescriptorSetLayout_Create_0(Vk* p_vk);
-VkDescriptorSet*                    vk_DescriptorSet_Create(Vk* p_vk, const VkDescriptorSetLayout* p_desc_set_layout, size_t desc_set_layouts_count);
-VkDescriptorSet*                    vk_DescriptorSet_Create_0(Vk* p_vk, const VkDescriptorSetLayout* p_desc_set_layout, size_t desc_set_layouts_count, VkBuffer buffer, Image* p_image);
+void                                vk_DescriptorSetLayout_Destroy(Vk* p_vk, VkDescriptorSetLayout layout);
+VkDescriptorSet*                    vk_DescriptorSet_Create(Vk* p_vk, const VkDescriptorSetLayout* p_desc_set_layout, size_t desc_set_layouts_count, VkDescriptorPool* p_pool);
+VkDescriptorSet*                    vk_DescriptorSet_Create_0(Vk* p_vk, const VkDescriptorSetLayout* p_desc_set_layout, size_t desc_set_layouts_count, VkBuffer buffer, Image* p_image, VkDescriptorPool* p_pool);
+
+// descriptor allocator
+Vk_DescriptorAllocator              vk_DescriptorAllocator_Create(bool transient);
+VkDescriptorPool                    vk_DescriptorAllocator_Allocate(Vk* p_vk, Vk_DescriptorAllocator* p_allocator, const VkDescriptorSetLayout* p_layouts, unsigned int layouts_count, VkDescriptorSet* p_sets);
+void                                vk_DescriptorAllocator_Free(Vk* p_vk, Vk_DescriptorAllocator* p_allocator, VkDescriptorPool pool, const VkDescriptorSet* p_sets, unsigned int sets_count);
+void                                vk_DescriptorAllocator_Reset(Vk* p_vk, Vk_DescriptorAllocator* p_allocator);
+void                                vk_DescriptorAllocator_Destroy(Vk* p_vk, Vk_DescriptorAllocator* p_allocator);
+void                                vk_DescriptorAllocator_AddLayout(Vk* p_vk, VkDescriptorSetLayout layout, const VkDescriptorSetLayoutCreateInfo* p_create_info);
+void                                vk_DescriptorAllocator_RemoveLayout(Vk* p_vk, VkDescriptorSetLayout layout);
+
+// texture table
+void                                vk_TextureTable_Create(Vk* p_vk);
+void                                vk_TextureTable_Destroy(Vk* p_vk);
+unsigned int                        vk_TextureTable_Register(Vk* p_vk, const Image* p_image);
+void                                vk_TextureTable_Unregister(Vk* p_vk, unsigned int texture_index);
+bool                                vk_TextureTable_IsLayout(Vk* p_vk, unsigned int set_number, const VkDescriptorSetLayoutCreateInfo* p_create_info);
 
 // pipeline
-VkPipelineLayout            vk_PipelineLayout_Create(VkDevice device, VkDescriptorSetLayout* p_set_layouts, size_t set_layout_count);
+VkPushConstantRange         vk_PushConstantRange_CreateFromReflections(const Vk_ShaderReflection* p_reflections, unsigned int reflections_count);
+VkPipelineLayout            vk_PipelineLayout_Create(VkDevice device, VkDescriptorSetLayout* p_set_layouts, size_t set_layout_count, VkPushConstantRange push_constant_range);
 VkPipeline                  vk_Pipeline_Graphics_Create(Vk* p_vk, VkPipelineLayout pipelineLayout);
+VkPipeline                  vk_Pipeline_Graphics_CreateFromSpv(Vk* p_vk, VkPipelineLayout pipelineLayout, SpvShader spv_vertex_shader, SpvShader spv_fragment_shader);
+VkPipeline                  vk_Pipeline_Graphics_CreateSpecialized(Vk* p_vk, VkPipelineLayout pipelineLayout, SpvShader spv_vertex_shader, SpvShader spv_fragment_shader, const Vk_SpecConstant* p_constants, size_t constants_count, const Vk_VertexLayout* p_vertex_layout);
+
+// pipeline variants
+Vk_PipelineVariants         Vk_PipelineVariants_Create(Vk* p_vk, VkPipelineLayout pipeline_layout, const char* vertex_filename, const char* fragment_filename, const Vk_VertexLayout* p_vertex_layout);
+VkPipeline                  Vk_PipelineVariants_Get(Vk_PipelineVariants* p_variants, const Vk_ShaderDefine* p_defines, size_t defines_count, const Vk_SpecConstant* p_constants, size_t constants_count);
+void                        Vk_PipelineVariants_Add(Vk_PipelineVariants* p_variants, const Vk_ShaderDefine* p_defines, size_t defines_count, const Vk_SpecConstant* p_constants, size_t constants_count, VkPipeline pipeline);
+void                        Vk_PipelineVariants_Invalidate(Vk_PipelineVariants* p_variants);
+void                        Vk_PipelineVariants_Destroy(Vk_PipelineVariants* p_variants);
+
+// disk cache
+#define                     VK_FNV1A64_INIT 0xcbf29ce484222325ULL
+bool                        vk_DiskCache_Directory(const char* p_subdir, char* p_dir, size_t size);
+void*                       vk_DiskCache_Read(const char* p_path, size_t* p_size);
+bool                        vk_DiskCache_WriteAtomic(const char* p_path, const void* p_data, size_t size);
+uint64_t                    vk_Hash_Fnv1a64(uint64_t hash, const void* p_data, size_t size);
+
+// instance layout
+Vk_VertexLayout             vk_VertexLayout_InstanceData(void);
+Vk_VertexLayout             vk_VertexLayout_InstanceDataPacked(void);
+Vk_VertexLayout             vk_VertexLayout_ForShader(const Vk_ShaderReflection* p_reflection);
+void                        vk_VertexLayout_Verify(const Vk_VertexLayout* p_layout, const Vk_ShaderReflection* p_reflection);
+void                        vk_InstanceData_Pack(const InstanceData* p_src, InstanceDataPacked* p_dst, size_t count);
+unsigned int                vk_InstanceMesh_VertexCount(unsigned int mesh);
+bool                        vk_InstanceMesh_Blends(unsigned int mesh);
+bool                        vk_InstanceMesh_MapEntry(const Vk_ShaderReflection* p_reflection, VkSpecializationMapEntry* p_entry);
+
+// pipeline cache
+void                        vk_PipelineCache_Create(Vk* p_vk);
+void                        vk_PipelineCache_Save(Vk* p_vk);
+void                        vk_PipelineCache_Destroy(Vk* p_vk);
 
 // command buffer
-VkCommandBuffer*            vk_CommandBuffer_CreateForSwapchain(Vk* p_vk, VkDescriptorSet* p_desc_set, size_t desc_set_count, VkPipeline graphics_pipeline,VkPipelineLayout graphics_pipeline_layout,VkBuffer instance_buffer, Image* p_image);
+VkCommandBuffer*            vk_CommandBuffer_CreateForSwapchain(Vk* p_vk, VkDescriptorSet* p_desc_set, size_t desc_set_count, VkPipeline graphics_pipeline,VkPipelineLayout graphics_pipeline_layout,VkPushConstantRange push_constant_range,const Vk_PushConstants* p_push_constants,VkBuffer instance_buffer,unsigned int vertex_count, Image* p_image);
 VkCommandBuffer*            vk_CommandBuffer_CreateForSwapchain_0( Vk* p_vk, Vk_Rendering* p_rendering, VkBuffer instance_buffer, size_t instance_count, Image* p_image);
+void                        vk_CommandBuffer_RecordDrawBatch(Vk* p_vk, VkCommandBuffer command_buffer, Image* p_target_image, Vk_GraphicsPipeline* p_pipeline, VkDescriptorSet* p_desc_sets, const Vk_PushConstants* p_push_constants, VkBuffer instance_buffer, Vk_DrawBatch* p_draw_batch);
 VkCommandBuffer             vk_CommandBuffer_CreateAndBeginSingleTimeUsage(Vk* p_vk);
 void                        vk_CommandBuffer_EndAndDestroySingleTimeUsage(Vk* p_vk, VkCommandBuffer command_buffer);
 VkCommandBuffer             vk_CommandBuffer_CreateWithImageAttachment( Vk* p_vk, Image* p_image, VkDescriptorSet* p_desc_set, size_t desc_set_count, VkPipeline graphics_pipeline, VkPipelineLayout graphics_pipeline_layout, VkBuffer instance_buffer, unsigned int vertex_count, unsigned int instance_count); 
 void                        vk_CommandBuffer_Submit(Vk* p_vk, VkCommandBuffer command_buffer);
 
+// command recorder
+Vk_CommandRecorder          Vk_CommandRecorder_Begin(VkCommandBuffer command_buffer);
+void                        Vk_CommandRecorder_BindPipeline(Vk_CommandRecorder* p_recorder, VkPipelineBindPoint bind_point, VkPipeline pipeline, bool dynamic_viewport_scissor);
+void                        Vk_CommandRecorder_BindDescriptorSets(Vk_CommandRecorder* p_recorder, VkPipelineBindPoint bind_point, VkPipelineLayout layout, unsigned int first_set, unsigned int sets_count, const VkDescriptorSet* p_sets);
+void                        Vk_CommandRecorder_BindVertexBuffers(Vk_CommandRecorder* p_recorder, unsigned int first_binding, unsigned int bindings_count, const VkBuffer* p_buffers, const VkDeviceSize* p_offsets);
+void                        Vk_CommandRecorder_SetViewport(Vk_CommandRecorder* p_recorder, VkViewport viewport);
+void                        Vk_CommandRecorder_SetScissor(Vk_CommandRecorder* p_recorder, VkRect2D scissor);
+void                        Vk_CommandRecorder_PushConstants(Vk_CommandRecorder* p_recorder, VkPipelineLayout layout, VkPushConstantRange range, const void* p_data);
+void                        Vk_CommandRecorder_End(Vk_CommandRecorder* p_recorder, Vk* p_vk);
+void                        vk_RecorderStats_NextFrame(Vk* p_vk);
+void                        vk_RecorderStats_Print(const Vk* p_vk);
+
 // synchronization
 VkSemaphore                 vk_Semaphore_Create(VkDevice device);
 VkFence                     vk_Fence_Create(VkDevice device);
 
+// deletion queue
+void                        vk_DeletionQueue_RetireBuffer(Vk* p_vk, Buffer buffer);
+void                        vk_DeletionQueue_RetireImage(Vk* p_vk, Image* p_image);
+void                        vk_DeletionQueue_RetireImageView(Vk* p_vk, VkImageView view);
+void                        vk_DeletionQueue_RetireSampler(Vk* p_vk, VkSampler sampler);
+void                        vk_DeletionQueue_RetireDescriptorSets(Vk* p_vk, VkDescriptorPool pool, const VkDescriptorSet* p_sets, size_t sets_count);
+void                        vk_DeletionQueue_RetirePipeline(Vk* p_vk, VkPipeline pipeline);
+void                        vk_DeletionQueue_RetirePipelineLayout(Vk* p_vk, VkPipelineLayout pipeline_layout);
+void                        vk_DeletionQueue_RetireCommandBuffer(Vk* p_vk, VkCommandPool pool, VkCommandBuffer command_buffer);
+void                        vk_DeletionQueue_RetireTextureSlot(Vk* p_vk, unsigned int texture_index);
+void                        vk_DeletionQueue_Collect(Vk* p_vk, uint64_t completed_point);
+
+// barrier
+void                        vk_Barrier_LayoutStageAccess(VkImageLayout layout, bool is_source, VkPipelineStageFlags2* p_stage, VkAccessFlags2* p_access);
+void                        vk_Barrier_AddMemory(Vk_BarrierBatch* p_batch, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access);
+void                        vk_Barrier_AddBuffer(Vk_BarrierBatch* p_batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access);
+void                        vk_Barrier_AddImage(Vk_BarrierBatch* p_batch, VkImage image, VkImageSubresourceRange range, VkImageLayout old_layout, VkImageLayout new_layout, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access);
+void                        vk_Barrier_Flush(Vk_BarrierBatch* p_batch, VkCommandBuffer command_buffer);
+
+// frame submit
+Vk_FrameSubmit              Vk_FrameSubmit_Create(Vk* p_vk, VkQueue queue, unsigned int queue_family);
+void                        Vk_FrameSubmit_Begin(Vk_FrameSubmit* p_frame);
+void                        Vk_FrameSubmit_UploadBuffer(Vk_FrameSubmit* p_frame, Buffer dst_buffer, VkDeviceSize dst_offset, const void* p_src_data, VkDeviceSize size);
+void                        Vk_FrameSubmit_ClearBuffer(Vk_FrameSubmit* p_frame, Buffer dst_buffer, int clear_value);
+void                        Vk_FrameSubmit_ReadbackBuffer(Vk_FrameSubmit* p_frame, Buffer src_buffer, VkDeviceSize src_offset, void* p_dst_data, VkDeviceSize size);
+VkCommandBuffer             Vk_FrameSubmit_ComputeCommandBuffer(Vk_FrameSubmit* p_frame);
+VkCommandBuffer             Vk_FrameSubmit_RenderCommandBuffer(Vk_FrameSubmit* p_frame);
+VkDescriptorSet             Vk_FrameSubmit_AllocateDescriptorSet(Vk_FrameSubmit* p_frame, VkDescriptorSetLayout layout);
+void                        Vk_FrameSubmit_AddCommandBuffer(Vk_FrameSubmit* p_frame, Vk_FrameStage stage, VkCommandBuffer command_buffer);
+void                        Vk_FrameSubmit_AddWait(Vk_FrameSubmit* p_frame, Vk_FrameStage stage, VkSemaphore semaphore, VkPipelineStageFlags2 stage_mask, uint64_t value);
+void                        Vk_FrameSubmit_AddSignal(Vk_FrameSubmit* p_frame, Vk_FrameStage stage, VkSemaphore semaphore, VkPipelineStageFlags2 stage_mask, uint64_t value);
+void                        Vk_FrameSubmit_Flush(Vk_FrameSubmit* p_frame, VkFence fence);
+void                        Vk_FrameSubmit_Destroy(Vk_FrameSubmit* p_frame);
+
+// task graph
+Vk_TaskGraph                Vk_TaskGraph_Create(unsigned int threads_count);
+unsigned int                Vk_TaskGraph_Add(Vk_TaskGraph* p_graph, const char* p_name, Vk_TaskFunction function, void* p_arg, bool main_thread, const unsigned int* p_dependencies, unsigned int dependencies_count);
+void                        Vk_TaskGraph_Run(Vk_TaskGraph* p_graph);
+void                        Vk_TaskGraph_PrintReport(const Vk_TaskGraph* p_graph);
+
+// shader watch
+void                        Vk_ShaderWatch_Start(Vk_ShaderWatch* p_watch, Vk* p_vk, const char** p_files, unsigned int files_count, Vk_ShaderWatchBuild build, Vk_ShaderWatchApply apply, void* p_arg);
+void                        Vk_ShaderWatch_Apply(Vk_ShaderWatch* p_watch);
+void                        Vk_ShaderWatch_Stop(Vk_ShaderWatch* p_watch);
+
 // gui_graphics_pipeline 
 Vk_GraphicsPipeline        Vk_GraphicsPipeline_Initialize(Vk* p_vk);
 void                        Vk_GraphicsPipeline_AddShader(Vk_GraphicsPipeline* p_pipeline, SpvShader spv_shader, shaderc_shader_kind shader_kind);
 void                        Vk_GraphicsPipeline_CreatePipeline(Vk_GraphicsPipeline* p_pipeline, VkFormat format);
 void                        Vk_GraphicsPipeline_CreatePipeline_0(Vk_GraphicsPipeline* p_pipeline, VkFormat format);
 
+// compute pipeline
+Vk_ComputePipeline          Vk_ComputePipeline_Create(Vk* p_vk, SpvShader spv_shader);
+void                        Vk_ComputePipeline_Bind(Vk_ComputePipeline* p_pipeline, Vk_CommandRecorder* p_recorder, const VkDescriptorSet* p_desc_sets, size_t desc_sets_count);
+void                        Vk_ComputePipeline_PushConstants(Vk_ComputePipeline* p_pipeline, Vk_CommandRecorder* p_recorder, unsigned int offset, unsigned int size, const void* p_data);
+void                        Vk_ComputePipeline_Dispatch(Vk_ComputePipeline* p_pipeline, Vk_CommandRecorder* p_recorder, unsigned int group_count_x, unsigned int group_count_y, unsigned int group_count_z);
+void                        Vk_ComputePipeline_DispatchThreads(Vk_ComputePipeline* p_pipeline, Vk_CommandRecorder* p_recorder, unsigned int threads_x, unsigned int threads_y, unsigned int threads_z);
+void                        Vk_ComputePipeline_DispatchIndirect(Vk_ComputePipeline* p_pipeline, Vk_CommandRecorder* p_recorder, VkBuffer buffer, VkDeviceSize offset);
+void                        Vk_ComputePipeline_Destroy(Vk_ComputePipeline* p_pipeline);
+
+// gui_draw_batch
+Vk_DrawBatch                Vk_DrawBatch_Create(Vk* p_vk);
+void                        Vk_DrawBatch_Clear(Vk_DrawBatch* p_batch);
+void                        Vk_DrawBatch_Add(Vk_DrawBatch* p_batch, Vk_DrawItem item);
+void                        Vk_DrawBatch_Build(Vk_DrawBatch* p_batch, Vk_FrameSubmit* p_frame);
+void                        Vk_DrawBatch_Record(Vk_DrawBatch* p_batch, Vk_CommandRecorder* p_recorder, Vk_GraphicsPipeline* p_default_pipeline, VkDescriptorSet* p_default_desc_sets, size_t default_desc_sets_count, VkBuffer instance_buffer, VkExtent2D target_extent);
+void                        Vk_DrawBatch_Destroy(Vk_DrawBatch* p_batch);
+
 // gui_rendering
 Vk_Rendering               Vk_Rendering_Create();
 void                        Vk_Rendering_SetGraphicsPipeline(Vk_Rendering* p_rendering, Vk_GraphicsPipeline* p_pipeline, VkBuffer buffer, Image* p_image);
 void                        Vk_Rendering_SetTargetImage(Vk_Rendering* p_rendering, Image* p_target_image);
+void                        Vk_Rendering_SetDrawBatch(Vk_Rendering* p_rendering, Vk_DrawBatch* p_draw_batch);
+void                        Vk_Rendering_SetPushConstants(Vk_Rendering* p_rendering, const Vk_PushConstants* p_push_constants);
 void                        Vk_Rendering_UpdateInstanceBuffer(Vk_Rendering* p_rendering, size_t dst_offset, void* p_src_data, size_t size);
 void                        Vk_Rendering_UpdateInstanceBufferWithBuffer(Vk_Rendering* p_rendering, size_t dst_offset, Buffer src_buffer, size_t src_offset, size_t size);
+void                        Vk_Rendering_UpdateInstanceIndices(Vk_Rendering* p_rendering, size_t first_index, const uint32_t* p_indices, size_t indices_count);
 void                        Vk_Rendering_UpdateInstanceDrawRange(Vk_Rendering* p_rendering, unsigned int first_instance, unsigned int instance_count);
 void                        Vk_Rendering_RecordCommandBuffer(Vk_Rendering* p_rendering);
 void                        Vk_Rendering_RecordCommandBuffer_0(Vk_Rendering* p_rendering);
@@ -1,41 +1,64 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec4        fragColor;
 layout(location = 1) in vec2        fragTexCoord;
 layout(location = 2) flat in uint   fragTexIndex;
-layout(location = 3) in float       fragCornerRadiusWidth;
-layout(location = 4) in float       fragCornerRadiusHeight;
+layout(location = 3) in vec2        fragLocalPos;       // pixels from the box center, before rotation
+layout(location = 4) flat in vec2   fragHalfSize;
+layout(location = 5) flat in vec4   fragCornerRadii;    // top-left, top-right, bottom-right, bottom-left
+layout(location = 6) flat in vec4   fragBorderColor;
+layout(location = 7) flat in vec2   fragBorderSoftness; // border width, edge softness
 
 layout(location = 0) out vec4 outColor;
 
-layout(set = 1, binding = 0) uniform sampler2D textures[16];
+// The texture table, VK_TEXTURE_TABLE_SET and VK_TEXTURE_TABLE_BINDING. fragTexIndex is the slot, 0 is untextured.
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
-void main() {
+// Pipeline variants specialise these, the driver drops the paths a variant does not take
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const bool ROUNDED_CORNERS = true;
+
+// Signed distance in pixels to the edge of a box centered on 0, negative inside. y points down, so the
+// bottom corners are the ones with positive y.
+float roundedBoxDistance(vec2 p, vec2 halfSize, vec4 radii) {
+    radii.xy = p.x > 0.0 ? radii.yz : radii.xw;
+    float radius = p.y > 0.0 ? radii.y : radii.x;
+    vec2 q = abs(p) - halfSize + radius;
+    return min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - radius;
+}
 
-    vec4 textureColor = texture(textures[fragTexIndex - 1], fragTexCoord);
-    vec4 color = 
-        fragTexIndex == 0 || fragTexIndex >= 16 ? 
-        fragColor : 
-        fragColor*textureColor;
+void main() {
+    // local pixels per screen pixel, the same in every direction whatever the rotation. Derivatives are
+    // only defined before control flow diverges.
+    vec2 dx = dFdx(fragLocalPos);
+    vec2 dy = dFdy(fragLocalPos);
+    float pixel = sqrt(0.5 * (dot(dx, dx) + dot(dy, dy)));
 
-    float x = fragTexCoord.x; x = x>0.5 ? 1.0-x : x;
-    float y = fragTexCoord.y; y = y>0.5 ? 1.0-y : y;
-    float edge = 0.003;
+    vec4 color = fragColor;
+    if (TEXTURED && fragTexIndex != 0) {
+        // flat per instance, but the instances of one draw sample different slots
+        color *= texture(textures[nonuniformEXT(fragTexIndex)], fragTexCoord);
+    }
 
-    if (fragCornerRadiusWidth < 0.0001 || fragCornerRadiusHeight < 0.0001 || x >= fragCornerRadiusWidth+edge || y >= fragCornerRadiusHeight + edge) {
+    if (!ROUNDED_CORNERS) {
         outColor = color;
         return;
     }
-    x=x-fragCornerRadiusWidth*0.98;
-    y=y-fragCornerRadiusHeight*0.98;
-    float a = (pow(x/fragCornerRadiusWidth,2)) + (pow(y/fragCornerRadiusHeight,2));
-    if (a < 1.0) {
-        if (a > 0.9) {
-            outColor = vec4(color.rgb, color.a*(1.0-a)*10.0);
-            return;
-        }
+
+    float borderWidth = fragBorderSoftness.x;
+    float ramp = pixel + fragBorderSoftness.y;
+
+    // most fragments are inside the straight part, further from the edges than the border and the ramp
+    float radius = max(max(fragCornerRadii.x, fragCornerRadii.y), max(fragCornerRadii.z, fragCornerRadii.w));
+    if (all(lessThan(abs(fragLocalPos), fragHalfSize - (max(radius, borderWidth) + ramp)))) {
         outColor = color;
         return;
     }
-    outColor = vec4(0.0,0.0,0.0,0.0);
-}
\ No newline at end of file
+
+    float edgeDistance = roundedBoxDistance(fragLocalPos, fragHalfSize, fragCornerRadii);
+    if (borderWidth > 0.0) {
+        color = mix(fragBorderColor, color, clamp(0.5 - (edgeDistance + borderWidth) / ramp, 0.0, 1.0));
+    }
+    outColor = vec4(color.rgb, color.a * clamp(0.5 - edgeDistance / ramp, 0.0, 1.0));
+}
@@ -0,0 +1,169 @@
+// The vertex shader body, shader.vert.glsl and shader_packed.vert.glsl pick the instance input
+
+// Instance data inputs, generated from the same schema as InstanceData and InstanceDataPacked
+#include "instance_layout.inl"
+
+#if defined(PACKED_INSTANCES) && defined(VERTEX_PULLING)
+#error "vertex pulling reads InstanceData, not InstanceDataPacked"
+#endif
+
+#ifdef PACKED_INSTANCES
+// The vertex fetch already converts the half floats and unorm16
+INSTANCE_DATA_PACKED_FIELDS(INSTANCE_GLSL_INPUT)
+
+vec2 inPos;
+float inRotation;
+float inCornerRadius;
+uint inTexIndex;
+uint inCornerRadii = 0u;
+uint inBorderColor = 0u;
+float inBorderWidth = 0.0;
+float inEdgeSoftness = 0.0;
+
+void decodeInstance() {
+    inPos = vec2(inPosFixed) / INSTANCE_PACKED_POS_SCALE - INSTANCE_PACKED_POS_BIAS;
+    inRotation = float(inRotationRadius & 0xFFFFu) / 65536.0 * 360.0;
+    inCornerRadius = float((inRotationRadius >> 16) & 0xFFu);
+    inTexIndex = inRotationRadius >> 24;
+}
+#elif defined(VERTEX_PULLING)
+// No vertex inputs, so the pipeline binds no vertex buffer. The draw's instances select indices, which
+// select the instance records.
+struct Instance {
+    INSTANCE_DATA_FIELDS(INSTANCE_GLSL_DECLARATION)
+};
+layout(std430, set = INSTANCE_PULL_SET, binding = INSTANCE_PULL_DATA_BINDING) readonly buffer Instances {
+    Instance instances[];
+};
+layout(std430, set = INSTANCE_PULL_SET, binding = INSTANCE_PULL_INDICES_BINDING) readonly buffer InstanceIndices {
+    uint instanceIndices[];
+};
+
+INSTANCE_DATA_FIELDS(INSTANCE_GLSL_DECLARATION)
+
+void decodeInstance() {
+    Instance instance = instances[instanceIndices[gl_InstanceIndex]];
+    inPos = instance.inPos;
+    inSize = instance.inSize;
+    inRotation = instance.inRotation;
+    inCornerRadius = instance.inCornerRadius;
+    inColor = instance.inColor;
+    inTexIndex = instance.inTexIndex;
+    inTexRect = instance.inTexRect;
+    inCornerRadii = instance.inCornerRadii;
+    inBorderColor = instance.inBorderColor;
+    inBorderWidth = instance.inBorderWidth;
+    inEdgeSoftness = instance.inEdgeSoftness;
+}
+#else
+INSTANCE_DATA_FIELDS(INSTANCE_GLSL_INPUT)
+
+void decodeInstance() {
+}
+#endif
+
+// Outputs to fragment shader
+layout(location = 0) out vec4       fragColor;
+layout(location = 1) out vec2       fragTexCoord;
+layout(location = 2) flat out uint  fragTexIndex;
+layout(location = 3) out vec2       fragLocalPos;       // pixels from the box center, before rotation
+layout(location = 4) flat out vec2  fragHalfSize;
+layout(location = 5) flat out vec4  fragCornerRadii;    // top-left, top-right, bottom-right, bottom-left
+layout(location = 6) flat out vec4  fragBorderColor;
+layout(location = 7) flat out vec2  fragBorderSoftness; // border width, edge softness
+
+// Per-draw data, matches Vk_PushConstants
+layout(push_constant) uniform PushConstants {
+    vec2 targetSize;     // Size of the rendering target in pixels
+    vec2 scrollOffset;   // Added to every instance position
+} pc;
+
+// Pipelines specialise the geometry, quad, octagon, ring or interior, see instance_layout.inl
+layout(constant_id = 2) const uint INSTANCE_MESH = INSTANCE_MESH_QUAD;
+
+vec4 unpackColor(uint inColor) {
+    // Extract each 8-bit channel using bitwise operations
+    float r = float((inColor >> 24) & 0xFF) / 255.0;
+    float g = float((inColor >> 16) & 0xFF) / 255.0;
+    float b = float((inColor >> 8) & 0xFF) / 255.0;
+    float a = float(inColor & 0xFF) / 255.0;
+    
+    return vec4(r, g, b, a);
+}
+
+// Octagon corners clockwise from the left end of the top edge. Each chamfer is the tangent to the corner
+// arc moved out by the anti-aliased edge, at one pixel per unit, so it only cuts transparent fragments.
+vec2 octagonVertex(uint index, vec4 radii, float ramp) {
+    vec4 chamfers = max(radii * (2.0 - sqrt(2.0)) - sqrt(2.0) * ramp, 0.0);
+    vec2 vertices[8] = vec2[](
+        vec2(chamfers.x, 0.0),          vec2(inSize.x - chamfers.y, 0.0),
+        vec2(inSize.x, chamfers.y),     vec2(inSize.x, inSize.y - chamfers.z),
+        vec2(inSize.x - chamfers.z, inSize.y), vec2(chamfers.w, inSize.y),
+        vec2(0.0, inSize.y - chamfers.w), vec2(0.0, chamfers.x)
+    );
+    return vertices[index];
+}
+
+// Corners of the region that is only opaque fill, clockwise from the top-left. It keeps clear of the
+// corners, the border and the edge, and collapses onto the center when there is no such region.
+vec2 interiorVertex(uint corner, vec4 radii, float ramp) {
+    bool opaque = (inColor & 0xFFu) == 0xFFu && inTexIndex == 0u;
+    // left, top, right, bottom
+    vec4 insets = max(max(radii.xxyz, radii.wyzw), max(inBorderWidth, 0.0)) + ramp;
+    vec2 minCorner = insets.xy;
+    vec2 maxCorner = inSize - insets.zw;
+    if (!opaque || any(greaterThanEqual(minCorner, maxCorner))) {
+        return inSize * 0.5;
+    }
+    return vec2(corner == 1u || corner == 2u ? maxCorner.x : minCorner.x, corner >= 2u ? maxCorner.y : minCorner.y);
+}
+
+// Triangle strips wound like the quad, top-left, top-right, bottom-left
+vec2 meshVertex(uint index, vec4 radii) {
+    if (INSTANCE_MESH == INSTANCE_MESH_QUAD) {
+        return vec2(index & 1u, (index >> 1) & 1u) * inSize;
+    }
+    float ramp = 1.0 + max(inEdgeSoftness, 0.0);
+    if (INSTANCE_MESH == INSTANCE_MESH_OCTAGON) {
+        const uint strip[8] = uint[](0u, 1u, 7u, 2u, 6u, 3u, 5u, 4u);
+        return octagonVertex(strip[index], radii, ramp);
+    }
+    if (INSTANCE_MESH == INSTANCE_MESH_RING) {
+        // interior and octagon vertices alternate around the ring and close on the first pair
+        const uint interiorCorner[8] = uint[](0u, 1u, 1u, 2u, 2u, 3u, 3u, 0u);
+        uint k = (index >> 1) % 8u;
+        return (index & 1u) == 0u ? interiorVertex(interiorCorner[k], radii, ramp) : octagonVertex(k, radii, ramp);
+    }
+    const uint quadCorner[4] = uint[](0u, 1u, 3u, 2u);
+    return interiorVertex(quadCorner[index], radii, ramp);
+}
+
+void main() {
+    decodeInstance();
+    vec2 center = inSize * 0.5;
+    // radii larger than the box would make the SDF bulge
+    vec4 radii = inCornerRadii != 0u ? vec4(inCornerRadii & 0xFFu, (inCornerRadii >> 8) & 0xFFu, (inCornerRadii >> 16) & 0xFFu, inCornerRadii >> 24) : vec4(inCornerRadius);
+    radii = clamp(radii, 0.0, min(center.x, center.y));
+
+    vec2 pos = meshVertex(uint(gl_VertexIndex), radii);
+    vec2 centeredPos = pos - center;
+    float rad = radians(inRotation);
+    mat2 rotationMatrix = mat2(
+        cos(rad), -sin(rad),
+        sin(rad),  cos(rad)
+    );
+    vec2 rotatedPos = rotationMatrix * centeredPos;
+    vec2 finalPos = rotatedPos + center + inPos + pc.scrollOffset;
+    vec2 ndcPos = (finalPos / pc.targetSize) * 2.0 - 1.0;
+    gl_Position = vec4(ndcPos, 0.0, 1.0);
+
+    
+    fragColor = unpackColor(inColor);
+    fragTexCoord = inTexRect.xy + (pos / inSize) * inTexRect.zw;
+    fragTexIndex = inTexIndex;
+    fragLocalPos = centeredPos;
+    fragHalfSize = center;
+    fragCornerRadii = radii;
+    fragBorderColor = unpackColor(inBorderColor);
+    fragBorderSoftness = vec2(max(inBorderWidth, 0.0), max(inEdgeSoftness, 0.0));
+}
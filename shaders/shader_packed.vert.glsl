@@ -0,0 +1,6 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Reads InstanceDataPacked, filled by vk_InstanceData_Pack
+#define PACKED_INSTANCES
+#include "shader.vert.inl"
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <pthread.h>
 
 typedef struct {
     void* ptr;
@@ -18,12 +19,30 @@ typedef struct {
     size_t            all_allocs_size;
     size_t            all_allocs_count;
     unsigned int      start_time_ms;
-    char*             code_location;
-    size_t            code_location_size;
 } debug_data_t;
 static debug_data_t debug_data;
+// the allocation table is shared by all threads, the TRACK call stack is per thread
+static pthread_mutex_t debug_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread char*  code_location;
+static __thread size_t code_location_size;
+static void CodeLocationInit() {
+    if (code_location) {
+        return;
+    }
+    code_location = malloc(2048 * sizeof(char));
+    if (code_location == NULL) {
+		printf("ERROR | code_location = malloc(2048 * sizeof(char));\n");
+		exit(EXIT_FAILURE);
+    }
+	memset(code_location, 0, 2048 * sizeof(char));
+    code_location_size = 2048;
+}
 void ExitFunction() {
+	// worker threads that were not joined may still allocate. An exit() from a tracking function already
+	// holds the lock, the report then goes ahead without it instead of deadlocking.
+	int locked = pthread_mutex_trylock(&debug_mutex) == 0;
 	if (debug_data.all_allocs_count == 0) {
+		if (locked) pthread_mutex_unlock(&debug_mutex);
 		return;
 	}
 	printf("\nMEMORY NOT FREED:\n");
@@ -34,6 +53,7 @@ void ExitFunction() {
 									debug_data.all_allocs[i].line);
 		free(debug_data.all_allocs[i].ptr);
 	}
+	if (locked) pthread_mutex_unlock(&debug_mutex);
 }
 void CrashFunction(int sig, siginfo_t *info, void *context) {
     size_t buffer_size = 2048;
@@ -43,7 +63,7 @@ void CrashFunction(int sig, siginfo_t *info, void *context) {
     // Construct the initial error message
     temp = snprintf(buffer + offset, buffer_size - offset,
                     "\nERROR program crashed with signal %d in %s\n",
-                    sig, debug_data.code_location);
+                    sig, code_location ? code_location : "");
     if (temp > 0 && temp < buffer_size - offset) {
         offset += temp;
     }
@@ -86,14 +106,7 @@ void DebugDataInit() {
     debug_data.all_allocs_count = 0;
     debug_data.start_time_ms = (unsigned int)(clock() * 1000 / CLOCKS_PER_SEC);
 
-    debug_data.code_location = malloc(2048 * sizeof(char));
-    if (debug_data.code_location == NULL) {
-		printf("ERROR | debug_data.code_location = malloc(2048 * sizeof(char));\n");
-		exit(EXIT_FAILURE);
-    }
-
-	memset(debug_data.code_location, 0, 2048 * sizeof(char));
-    debug_data.code_location_size = 2048;
+    CodeLocationInit();
 
 	atexit(ExitFunction);
 
@@ -110,9 +123,12 @@ void DebugDataInit() {
 }
 void DebugPrintf(const char* message, size_t line, const char* file) {
 	unsigned int current_time = (unsigned int)(clock() * 1000 / CLOCKS_PER_SEC);
-	printf("%dms %s %s:%ld | %s", current_time-debug_data.start_time_ms, debug_data.code_location, file, line, message);
+	CodeLocationInit();
+	printf("%dms %s %s:%ld | %s", current_time-debug_data.start_time_ms, code_location, file, line, message);
 }
 void* DebugMalloc (size_t size, size_t line, const char* file) {
+	CodeLocationInit();
+	pthread_mutex_lock(&debug_mutex);
 
 	while (debug_data.all_allocs_count >= debug_data.all_allocs_size) {
 		debug_data.all_allocs_size *= 2;
@@ -134,7 +150,7 @@ void* DebugMalloc (size_t size, size_t line, const char* file) {
 	debug_data.all_allocs[debug_data.all_allocs_count].size_bytes = size;
 	debug_data.all_allocs[debug_data.all_allocs_count].line = line;
 
-	size_t string_length = strlen(debug_data.code_location) + strlen(file) + 2;
+	size_t string_length = strlen(code_location) + strlen(file) + 2;
 	if (!debug_data.all_allocs[debug_data.all_allocs_count].file) {
 		debug_data.all_allocs[debug_data.all_allocs_count].file = malloc(string_length);
 		if (!debug_data.all_allocs[debug_data.all_allocs_count].file) {
@@ -150,14 +166,17 @@ void* DebugMalloc (size_t size, size_t line, const char* file) {
 		}
 		debug_data.all_allocs[debug_data.all_allocs_count].file = tmp;
 	}
-	sprintf(debug_data.all_allocs[debug_data.all_allocs_count].file, "%s %s", debug_data.code_location, file);
+	sprintf(debug_data.all_allocs[debug_data.all_allocs_count].file, "%s %s", code_location, file);
 
 	debug_data.all_allocs_count++;
-	return debug_data.all_allocs[debug_data.all_allocs_count-1].ptr; // -1 because it is itterated once
+	void* ptr = debug_data.all_allocs[debug_data.all_allocs_count-1].ptr; // -1 because it is itterated once
+	pthread_mutex_unlock(&debug_mutex);
+	return ptr;
 }
 void* DebugRealloc(void* ptr, size_t size, size_t line, char* file) {
 
 	void* new_ptr = NULL;
+	pthread_mutex_lock(&debug_mutex);
 
     for (size_t i = 0; i < debug_data.all_allocs_count; i++) {
         if (debug_data.all_allocs[i].ptr == ptr) {
@@ -182,6 +201,7 @@ void* DebugRealloc(void* ptr, size_t size, size_t line, char* file) {
 	    exit(-1);
     }
 
+	pthread_mutex_unlock(&debug_mutex);
 	return new_ptr;
 }
 void  DebugFree   (void* ptr,              size_t line, const char* file) {
@@ -191,6 +211,7 @@ void  DebugFree   (void* ptr,              size_t line, const char* file) {
 		exit(EXIT_FAILURE);
 	}
 	int index = -1;
+	pthread_mutex_lock(&debug_mutex);
 	for (int i = 0; i < debug_data.all_allocs_count; i++) {
 		if (debug_data.all_allocs[i].ptr == ptr) { // Changed '=' to '==' for correct comparison
 			index = i;
@@ -207,6 +228,7 @@ void  DebugFree   (void* ptr,              size_t line, const char* file) {
 		debug_data.all_allocs[i] = debug_data.all_allocs[i+1]; // Changed '+1' to correct placement for struct copying
 	}
 	debug_data.all_allocs_count--;
+	pthread_mutex_unlock(&debug_mutex);
 }
 void DebugStart(size_t line, const char* file) {
 
@@ -215,32 +237,33 @@ void DebugStart(size_t line, const char* file) {
 		exit(EXIT_FAILURE);
 	}
 
+    CodeLocationInit();
     char adding_string[50];
     snprintf(adding_string, sizeof(adding_string), " %s:%ld", file, line);
-    size_t current_length = strlen(debug_data.code_location);
+    size_t current_length = strlen(code_location);
     size_t needed_size = current_length + strlen(adding_string) + 1;
 
-    if (debug_data.code_location_size < needed_size) {
+    if (code_location_size < needed_size) {
 
-        while (debug_data.code_location_size < needed_size) {
-            debug_data.code_location_size *= 2;
+        while (code_location_size < needed_size) {
+            code_location_size *= 2;
         }
 
-        void* tmp = realloc(debug_data.code_location, debug_data.code_location_size);
+        void* tmp = realloc(code_location, code_location_size);
         if (!tmp) {
-            printf("ERROR | void* tmp = realloc(debug_data.code_location, debug_data.code_location_size);\n");
+            printf("ERROR | void* tmp = realloc(code_location, code_location_size);\n");
             exit(EXIT_FAILURE);
         }
 
-        debug_data.code_location = tmp;
+        code_location = tmp;
     }
 
-    strcat(debug_data.code_location + strlen(debug_data.code_location), adding_string);
+    strcat(code_location + strlen(code_location), adding_string);
 }
 void DebugEnd() {
 	int index = -1;
-	for (int i = debug_data.code_location_size-1; i >= 0 ; i--) {
-		if (debug_data.code_location[i]==' ') {
+	for (int i = code_location_size-1; i >= 0 ; i--) {
+		if (code_location[i]==' ') {
 			index = i;
 			break;
 		}
@@ -249,25 +272,26 @@ void DebugEnd() {
 		printf("ERROR | index==-1");
 		exit(EXIT_FAILURE);
 	}
-	debug_data.code_location[index] = '\0';
+	code_location[index] = '\0';
 }
 size_t DebugGetSizeBytes(void* ptr) {
 	if (!ptr) {
 		return 0;
 	}
 	int index = -1;
+	pthread_mutex_lock(&debug_mutex);
 	for (int i = 0; i < debug_data.all_allocs_count; i++) {
 		if (debug_data.all_allocs[i].ptr == ptr) {
 			index = i;
 			break;
 		}
 	}
-	if (index == -1) {
-		return 0;
-	}
-	return debug_data.all_allocs[index].size_bytes;
+	size_t size_bytes = index == -1 ? 0 : debug_data.all_allocs[index].size_bytes;
+	pthread_mutex_unlock(&debug_mutex);
+	return size_bytes;
 }
 void DebugPrintMemory() {
+	pthread_mutex_lock(&debug_mutex);
 	printf("\nunfreed memory\n");
 	for (int i = 0; i < debug_data.all_allocs_count; i++) {
 		printf("	address %p | %zu bytes | at %s:%zu\n",  debug_data.all_allocs[i].ptr,
@@ -275,4 +299,13 @@ void DebugPrintMemory() {
 															debug_data.all_allocs[i].file,
 															debug_data.all_allocs[i].line);
 	}
-}
\ No newline at end of file
+	pthread_mutex_unlock(&debug_mutex);
+}
+// Worker threads call this before exiting, the main thread's stack lives until exit
+void DebugThreadEnd() {
+	if (code_location) {
+		free(code_location);
+		code_location = NULL;
+		code_location_size = 0;
+	}
+}
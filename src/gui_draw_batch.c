@@ -0,0 +1,234 @@
+#include "vk.h"
+
+static int CompareDescSets(const VkDescriptorSet* p_a, size_t a_count, const VkDescriptorSet* p_b, size_t b_count) {
+    if (a_count != b_count) {
+        return a_count < b_count ? -1 : 1;
+    }
+    if (p_a == p_b) {
+        return 0;
+    }
+    if (!p_a || !p_b) {
+        return p_a ? 1 : -1;
+    }
+    return memcmp(p_a, p_b, a_count * sizeof(VkDescriptorSet));
+}
+
+static int CompareScissors(VkRect2D a, VkRect2D b) {
+    if (a.offset.x != b.offset.x)           return a.offset.x < b.offset.x ? -1 : 1;
+    if (a.offset.y != b.offset.y)           return a.offset.y < b.offset.y ? -1 : 1;
+    if (a.extent.width != b.extent.width)   return a.extent.width < b.extent.width ? -1 : 1;
+    if (a.extent.height != b.extent.height) return a.extent.height < b.extent.height ? -1 : 1;
+    return 0;
+}
+
+// sorts by layer first so that painter's order between layers is kept, then by state
+static int CompareDrawItems(const void* p_a, const void* p_b) {
+    const Vk_DrawItem* a = p_a;
+    const Vk_DrawItem* b = p_b;
+
+    if (a->layer != b->layer) {
+        return a->layer < b->layer ? -1 : 1;
+    }
+    if (a->p_pipeline != b->p_pipeline) {
+        return (uintptr_t)a->p_pipeline < (uintptr_t)b->p_pipeline ? -1 : 1;
+    }
+    int desc_sets_order = CompareDescSets(a->p_desc_sets, a->desc_sets_count, b->p_desc_sets, b->desc_sets_count);
+    if (desc_sets_order != 0) {
+        return desc_sets_order;
+    }
+    int scissor_order = CompareScissors(a->scissor, b->scissor);
+    if (scissor_order != 0) {
+        return scissor_order;
+    }
+    if (a->first_instance != b->first_instance) {
+        return a->first_instance < b->first_instance ? -1 : 1;
+    }
+    return a->order < b->order ? -1 : (a->order > b->order);
+}
+
+static bool DrawRunMatchesItem(const Vk_DrawRun* p_run, const Vk_DrawItem* p_item) {
+    return p_run->p_pipeline == p_item->p_pipeline &&
+           CompareDescSets(p_run->p_desc_sets, p_run->desc_sets_count, p_item->p_desc_sets, p_item->desc_sets_count) == 0 &&
+           CompareScissors(p_run->scissor, p_item->scissor) == 0;
+}
+
+Vk_DrawBatch Vk_DrawBatch_Create(Vk* p_vk) {
+    VERIFY(p_vk, "NULL pointer");
+
+    Vk_DrawBatch batch;
+    memset(&batch, 0, sizeof(Vk_DrawBatch));
+    batch.p_vk = p_vk;
+
+    batch.multi_draw_indirect = p_vk->caps.multi_draw_indirect;
+    batch.max_draw_indirect_count = p_vk->caps.max_draw_indirect_count;
+
+    return batch;
+}
+
+void Vk_DrawBatch_Clear(Vk_DrawBatch* p_batch) {
+    VERIFY(p_batch, "NULL pointer");
+    p_batch->items_count = 0;
+    p_batch->commands_count = 0;
+    p_batch->runs_count = 0;
+}
+
+void Vk_DrawBatch_Add(Vk_DrawBatch* p_batch, Vk_DrawItem item) {
+    VERIFY(p_batch, "NULL pointer");
+    VERIFY(item.p_desc_sets || item.desc_sets_count == 0, "desc_sets_count is %zu but p_desc_sets is NULL", item.desc_sets_count);
+
+    if (item.instance_count == 0) {
+        return;
+    }
+
+    if (p_batch->items_count == p_batch->items_capacity) {
+        p_batch->items_capacity = p_batch->items_capacity ? p_batch->items_capacity * 2 : 64;
+        TRACK(p_batch->p_items = alloc(p_batch->p_items, p_batch->items_capacity * sizeof(Vk_DrawItem)));
+    }
+
+    item.order = (unsigned int)p_batch->items_count;
+    p_batch->p_items[p_batch->items_count++] = item;
+}
+
+// Between Vk_FrameSubmit_Begin and Flush, the indirect commands are uploaded with the frame and the batch is
+// recorded into a command buffer of one of its later stages
+void Vk_DrawBatch_Build(Vk_DrawBatch* p_batch, Vk_FrameSubmit* p_frame) {
+    VERIFY(p_batch && p_frame, "NULL pointer");
+    VERIFY(p_batch->p_vk, "NULL pointer");
+
+    p_batch->commands_count = 0;
+    p_batch->runs_count = 0;
+    if (p_batch->items_count == 0) {
+        return;
+    }
+
+    qsort(p_batch->p_items, p_batch->items_count, sizeof(Vk_DrawItem), CompareDrawItems);
+
+    // there is never more commands or runs than items
+    TRACK(p_batch->p_commands = alloc(p_batch->p_commands, p_batch->items_count * sizeof(VkDrawIndirectCommand)));
+    TRACK(p_batch->p_runs = alloc(p_batch->p_runs, p_batch->items_count * sizeof(Vk_DrawRun)));
+
+    for (size_t i = 0; i < p_batch->items_count; ++i) {
+        const Vk_DrawItem* p_item = &p_batch->p_items[i];
+        Vk_DrawRun* p_run = p_batch->runs_count ? &p_batch->p_runs[p_batch->runs_count - 1] : NULL;
+
+        if (p_run && DrawRunMatchesItem(p_run, p_item)) {
+            // adjacent instance ranges with the same state become one command
+            VkDrawIndirectCommand* p_last = &p_batch->p_commands[p_batch->commands_count - 1];
+            if (p_last->firstInstance + p_last->instanceCount == p_item->first_instance) {
+                p_last->instanceCount += p_item->instance_count;
+                continue;
+            }
+        } else {
+            p_run = &p_batch->p_runs[p_batch->runs_count++];
+            p_run->p_pipeline      = p_item->p_pipeline;
+            p_run->p_desc_sets     = p_item->p_desc_sets;
+            p_run->desc_sets_count = p_item->desc_sets_count;
+            p_run->scissor         = p_item->scissor;
+            p_run->first_command   = (unsigned int)p_batch->commands_count;
+            p_run->commands_count  = 0;
+        }
+
+        p_batch->p_commands[p_batch->commands_count++] = (VkDrawIndirectCommand){
+            .vertexCount   = p_item->p_pipeline ? p_item->p_pipeline->vertex_count : vk_InstanceMesh_VertexCount(INSTANCE_MESH_QUAD),
+            .instanceCount = p_item->instance_count,
+            .firstVertex   = 0,
+            .firstInstance = p_item->first_instance,
+        };
+        p_run->commands_count++;
+    }
+
+    if (!p_batch->multi_draw_indirect) {
+        return;
+    }
+
+    VkDeviceSize size = p_batch->commands_count * sizeof(VkDrawIndirectCommand);
+    if (p_batch->indirect_buffer.size < size) {
+        // the previous build may still be drawn by a frame in flight
+        TRACK(vk_DeletionQueue_RetireBuffer(p_batch->p_vk, p_batch->indirect_buffer));
+        TRACK(p_batch->indirect_buffer = vk_Buffer_Create(p_batch->p_vk, size * 2, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT));
+    }
+    TRACK(Vk_FrameSubmit_UploadBuffer(p_frame, p_batch->indirect_buffer, 0, p_batch->p_commands, size));
+}
+
+void Vk_DrawBatch_Record(
+    Vk_DrawBatch* p_batch,
+    Vk_CommandRecorder* p_recorder,
+    Vk_GraphicsPipeline* p_default_pipeline,
+    VkDescriptorSet* p_default_desc_sets,
+    size_t default_desc_sets_count,
+    VkBuffer instance_buffer,
+    VkExtent2D target_extent)
+{
+    VERIFY(p_batch, "NULL pointer");
+    VERIFY(p_recorder, "NULL pointer");
+    if (p_batch->runs_count == 0) {
+        return;
+    }
+
+    for (size_t r = 0; r < p_batch->runs_count; ++r) {
+        const Vk_DrawRun* p_run = &p_batch->p_runs[r];
+
+        Vk_GraphicsPipeline* p_pipeline = p_run->p_pipeline ? p_run->p_pipeline : p_default_pipeline;
+        VkDescriptorSet* p_desc_sets = p_run->p_desc_sets ? p_run->p_desc_sets : p_default_desc_sets;
+        size_t desc_sets_count = p_run->p_desc_sets ? p_run->desc_sets_count : default_desc_sets_count;
+
+        VERIFY(p_pipeline, "draw run %zu has no pipeline and there is no default pipeline", r);
+        VERIFY(p_pipeline->graphics_pipeline != VK_NULL_HANDLE, "graphics_pipeline is VK_NULL_HANDLE");
+        // a pipeline without dynamic viewport and scissor covers the whole target it was created for
+        VERIFY(p_pipeline->dynamic_scissor || p_run->scissor.extent.width == 0 || p_run->scissor.extent.height == 0, "draw run %zu has a scissor, its pipeline needs dynamic viewport and scissor", r);
+        VERIFY(p_run->p_pipeline || p_pipeline->instance_mesh == INSTANCE_MESH_QUAD, "draw run %zu was built for quads, items drawn with another mesh name their pipeline", r);
+
+        // the recorder drops whatever state is already bound, runs only need to state what they use
+        Vk_CommandRecorder_BindPipeline(p_recorder, VK_PIPELINE_BIND_POINT_GRAPHICS, p_pipeline->graphics_pipeline, p_pipeline->dynamic_scissor);
+        Vk_CommandRecorder_BindDescriptorSets(p_recorder, VK_PIPELINE_BIND_POINT_GRAPHICS, p_pipeline->pipeline_layout, 0, (unsigned int)desc_sets_count, p_desc_sets);
+        if (!p_pipeline->vertex_pulling) {
+            VERIFY(instance_buffer != VK_NULL_HANDLE, "instance_buffer is VK_NULL_HANDLE");
+            Vk_CommandRecorder_BindVertexBuffers(p_recorder, 0, 1, (VkBuffer[]){instance_buffer}, (VkDeviceSize[]){0});
+        }
+        if (p_pipeline->dynamic_scissor) {
+            Vk_CommandRecorder_SetViewport(p_recorder, (VkViewport){
+                .x = 0.0f,
+                .y = 0.0f,
+                .width = (float)target_extent.width,
+                .height = (float)target_extent.height,
+                .minDepth = 0.0f,
+                .maxDepth = 1.0f
+            });
+
+            VkRect2D scissor = p_run->scissor;
+            if (scissor.extent.width == 0 || scissor.extent.height == 0) {
+                scissor = (VkRect2D){ .offset = {0, 0}, .extent = target_extent };
+            }
+            Vk_CommandRecorder_SetScissor(p_recorder, scissor);
+        }
+
+        VkCommandBuffer command_buffer = p_recorder->command_buffer;
+        if (p_batch->multi_draw_indirect) {
+            unsigned int first = p_run->first_command;
+            unsigned int remaining = p_run->commands_count;
+            while (remaining > 0) {
+                unsigned int count = remaining < p_batch->max_draw_indirect_count ? remaining : p_batch->max_draw_indirect_count;
+                TRACK(vkCmdDrawIndirect(command_buffer, p_batch->indirect_buffer.buffer, first * sizeof(VkDrawIndirectCommand), count, sizeof(VkDrawIndirectCommand)));
+                first += count;
+                remaining -= count;
+            }
+        } else {
+            for (unsigned int c = 0; c < p_run->commands_count; ++c) {
+                const VkDrawIndirectCommand* p_cmd = &p_batch->p_commands[p_run->first_command + c];
+                TRACK(vkCmdDraw(command_buffer, p_cmd->vertexCount, p_cmd->instanceCount, p_cmd->firstVertex, p_cmd->firstInstance));
+            }
+        }
+    }
+}
+
+void Vk_DrawBatch_Destroy(Vk_DrawBatch* p_batch) {
+    VERIFY(p_batch, "NULL pointer");
+    // the last frames recorded with the batch may still read the indirect commands
+    if (p_batch->indirect_buffer.buffer != VK_NULL_HANDLE) {
+        TRACK(vk_DeletionQueue_RetireBuffer(p_batch->p_vk, p_batch->indirect_buffer));
+    }
+    if (p_batch->p_items)    free(p_batch->p_items);
+    if (p_batch->p_commands) free(p_batch->p_commands);
+    if (p_batch->p_runs)     free(p_batch->p_runs);
+    memset(p_batch, 0, sizeof(Vk_DrawBatch));
+}
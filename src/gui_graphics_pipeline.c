@@ -35,9 +35,8 @@ void Vk_GraphicsPipeline_AddShader(
     p_shader->spv_code_size = spv_shader.size;
     p_shader->shader_kind   = shader_kind;
 
-    // Create SPIRV-Reflect module
-    TRACK(SpvReflectResult result_0 = spvReflectCreateShaderModule(spv_shader.size, spv_shader.code, &p_shader->reflect_shader_module));
-    VERIFY(result_0 == SPV_REFLECT_RESULT_SUCCESS, "Failed to create SPIRV-Reflect shader module");
+    // Loaded shaders come reflected, this only copies the stored result
+    TRACK(p_shader->reflection = vk_ShaderReflection_Create(spv_shader));
 
     // Create Vulkan shader module
     VkShaderModuleCreateInfo create_info = {
@@ -57,16 +56,16 @@ void Vk_GraphicsPipeline_CreatePipeline(
     VERIFY(p_pipeline, "NULL pointer passed to Vk_GraphicsPipeline_CreateDescriptorSets");
     VERIFY(p_pipeline->shaders_count >= 2, "At least vertex and fragment shaders are required");
 
-    // Gather all reflect shader modules
-    TRACK(SpvReflectShaderModule* p_shader_modules = alloc(NULL, p_pipeline->shaders_count * sizeof(SpvReflectShaderModule)));
+    // Gather the reflection of every stage
+    TRACK(Vk_ShaderReflection* p_reflections = alloc(NULL, p_pipeline->shaders_count * sizeof(Vk_ShaderReflection)));
     for (unsigned int i = 0; i < p_pipeline->shaders_count; ++i) {
-        p_shader_modules[i] = p_pipeline->p_shaders[i].reflect_shader_module;
+        p_reflections[i] = p_pipeline->p_shaders[i].reflection;
     }
 
     // Create descriptor set layouts from reflection
     TRACK(p_pipeline->p_desc_sets_layout_create_info = vk_DescriptorSetLayoutCreateInfo_Create(
         p_pipeline->p_vk, 
-        p_shader_modules, 
+        p_reflections, 
         (unsigned int)p_pipeline->shaders_count, 
         &p_pipeline->desc_sets_count));
 
@@ -76,15 +75,18 @@ void Vk_GraphicsPipeline_CreatePipeline(
         p_pipeline->p_desc_sets_layout_create_info, 
         p_pipeline->desc_sets_count));
 
-    TRACK(free(p_shader_modules));
+    // Push constants of all stages merged into one range
+    p_pipeline->push_constant_range = vk_PushConstantRange_CreateFromReflections(p_reflections, (unsigned int)p_pipeline->shaders_count);
+
+    TRACK(free(p_reflections));
 
     // Create pipeline layout
     VkPipelineLayoutCreateInfo vk_pipeline_layoutInfo = {
         .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .setLayoutCount         = (uint32_t)p_pipeline->desc_sets_count,
         .pSetLayouts            = p_pipeline->p_desc_sets_layout,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges    = NULL
+        .pushConstantRangeCount = p_pipeline->push_constant_range.size > 0 ? 1 : 0,
+        .pPushConstantRanges    = &p_pipeline->push_constant_range
     };
 
     TRACK(VkResult result = vkCreatePipelineLayout(p_pipeline->p_vk->device, &vk_pipeline_layoutInfo, NULL, &p_pipeline->pipeline_layout));
@@ -99,19 +101,22 @@ void Vk_GraphicsPipeline_CreatePipeline(
     }
     VERIFY(vertex_index < p_pipeline->shaders_count, "Could not find vertex shader");
 
-    uint32_t vertex_attrib_count;
-    uint32_t vertex_binding_stride;
-    SpvShader spv_vertex_shader = {
-        .code = p_pipeline->p_shaders[vertex_index].p_spv_code,
-        .size = p_pipeline->p_shaders[vertex_index].spv_code_size,
+    // Vertex input attributes from the instance schema, checked against the stored reflection
+    Vk_VertexLayout vertex_layout = vk_VertexLayout_ForShader(&p_pipeline->p_shaders[vertex_index].reflection);
+    TRACK(vk_VertexLayout_Verify(&vertex_layout, &p_pipeline->p_shaders[vertex_index].reflection));
+    p_pipeline->vertex_pulling = vertex_layout.stride == 0;
+
+    // The instance mesh specialises the vertex shader, a shader without INSTANCE_MESH only draws quads
+    VkSpecializationMapEntry mesh_entry;
+    bool mesh_specialized = vk_InstanceMesh_MapEntry(&p_pipeline->p_shaders[vertex_index].reflection, &mesh_entry);
+    VERIFY(mesh_specialized || p_pipeline->instance_mesh == INSTANCE_MESH_QUAD, "the vertex shader has no INSTANCE_MESH to draw mesh %u with", p_pipeline->instance_mesh);
+    VkSpecializationInfo mesh_specialization = {
+        .mapEntryCount = 1,
+        .pMapEntries   = &mesh_entry,
+        .dataSize      = sizeof(unsigned int),
+        .pData         = &p_pipeline->instance_mesh,
     };
-
-    // Reflect vertex input attributes
-    TRACK(VkVertexInputAttributeDescription* vertex_input_attrib_desc = vk_VertexInputAttributeDescriptions_CreateFromVertexShader(
-        spv_vertex_shader, 
-        &vertex_attrib_count,
-        &vertex_binding_stride
-    ));
+    p_pipeline->vertex_count = vk_InstanceMesh_VertexCount(p_pipeline->instance_mesh);
 
     // Set up shader stages
     const unsigned int stage_count = (unsigned int)p_pipeline->shaders_count;
@@ -128,6 +133,7 @@ void Vk_GraphicsPipeline_CreatePipeline(
             p_stages[i].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         } else if (p_pipeline->p_shaders[i].shader_kind == shaderc_vertex_shader) {
             p_stages[i].stage = VK_SHADER_STAGE_VERTEX_BIT;
+            p_stages[i].pSpecializationInfo = mesh_specialized ? &mesh_specialization : NULL;
         } else {
             VERIFY(false, "Unsupported shader kind encountered");
         }
@@ -148,14 +154,14 @@ void Vk_GraphicsPipeline_CreatePipeline(
         .pStages             = p_stages,
         .pVertexInputState   = &(VkPipelineVertexInputStateCreateInfo) {
             .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            .vertexBindingDescriptionCount   = 1,
+            .vertexBindingDescriptionCount   = vertex_layout.stride ? 1 : 0,
             .pVertexBindingDescriptions      = (VkVertexInputBindingDescription[1]) {{
                 .binding   = 0,
-                .stride    = vertex_binding_stride,
+                .stride    = vertex_layout.stride,
                 .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
             }},
-            .vertexAttributeDescriptionCount = vertex_attrib_count,
-            .pVertexAttributeDescriptions    = vertex_input_attrib_desc,
+            .vertexAttributeDescriptionCount = vertex_layout.attributes_count,
+            .pVertexAttributeDescriptions    = vertex_layout.p_attributes,
         },
         .pInputAssemblyState = &(VkPipelineInputAssemblyStateCreateInfo) {
             .sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -210,7 +216,7 @@ void Vk_GraphicsPipeline_CreatePipeline(
                                        VK_COLOR_COMPONENT_G_BIT | 
                                        VK_COLOR_COMPONENT_B_BIT | 
                                        VK_COLOR_COMPONENT_A_BIT,
-                .blendEnable         = VK_TRUE,
+                .blendEnable         = vk_InstanceMesh_Blends(p_pipeline->instance_mesh) ? VK_TRUE : VK_FALSE,
                 .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
                 .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
                 .colorBlendOp        = VK_BLEND_OP_ADD,
@@ -229,10 +235,10 @@ void Vk_GraphicsPipeline_CreatePipeline(
         .basePipelineIndex   = -1
     };
 
-    TRACK(result = vkCreateGraphicsPipelines(p_pipeline->p_vk->device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &p_pipeline->graphics_pipeline));
+    TRACK(result = vkCreateGraphicsPipelines(p_pipeline->p_vk->device, p_pipeline->p_vk->pipeline_cache, 1, &pipeline_info, NULL, &p_pipeline->graphics_pipeline));
     VERIFY(result == VK_SUCCESS, "Failed to create graphics pipeline");
+    p_pipeline->dynamic_scissor = true;
     free(p_stages);
-    free(vertex_input_attrib_desc);
 }
 
 void Vk_GraphicsPipeline_CreatePipeline_0(
@@ -242,16 +248,16 @@ void Vk_GraphicsPipeline_CreatePipeline_0(
     VERIFY(p_pipeline, "NULL pointer passed to Vk_GraphicsPipeline_CreateDescriptorSets");
     VERIFY(p_pipeline->shaders_count >= 2, "At least vertex and fragment shaders are required");
 
-    // Gather all reflect shader modules
-    TRACK(SpvReflectShaderModule* p_shader_modules = alloc(NULL, p_pipeline->shaders_count * sizeof(SpvReflectShaderModule)));
+    // Gather the reflection of every stage
+    TRACK(Vk_ShaderReflection* p_reflections = alloc(NULL, p_pipeline->shaders_count * sizeof(Vk_ShaderReflection)));
     for (unsigned int i = 0; i < p_pipeline->shaders_count; ++i) {
-        p_shader_modules[i] = p_pipeline->p_shaders[i].reflect_shader_module;
+        p_reflections[i] = p_pipeline->p_shaders[i].reflection;
     }
 
     // Create descriptor set layouts from reflection
     TRACK(p_pipeline->p_desc_sets_layout_create_info = vk_DescriptorSetLayoutCreateInfo_Create(
         p_pipeline->p_vk, 
-        p_shader_modules, 
+        p_reflections, 
         (unsigned int)p_pipeline->shaders_count, 
         &p_pipeline->desc_sets_count));
 
@@ -261,15 +267,18 @@ void Vk_GraphicsPipeline_CreatePipeline_0(
         p_pipeline->p_desc_sets_layout_create_info, 
         p_pipeline->desc_sets_count));
 
-    TRACK(free(p_shader_modules));
+    // Push constants of all stages merged into one range
+    p_pipeline->push_constant_range = vk_PushConstantRange_CreateFromReflections(p_reflections, (unsigned int)p_pipeline->shaders_count);
+
+    TRACK(free(p_reflections));
 
     // Create pipeline layout
     VkPipelineLayoutCreateInfo vk_pipeline_layoutInfo = {
         .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .setLayoutCount         = (uint32_t)p_pipeline->desc_sets_count,
         .pSetLayouts            = p_pipeline->p_desc_sets_layout,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges    = NULL
+        .pushConstantRangeCount = p_pipeline->push_constant_range.size > 0 ? 1 : 0,
+        .pPushConstantRanges    = &p_pipeline->push_constant_range
     };
 
     TRACK(VkResult result = vkCreatePipelineLayout(p_pipeline->p_vk->device, &vk_pipeline_layoutInfo, NULL, &p_pipeline->pipeline_layout));
@@ -284,19 +293,22 @@ void Vk_GraphicsPipeline_CreatePipeline_0(
     }
     VERIFY(vertex_index < p_pipeline->shaders_count, "Could not find vertex shader");
 
-    uint32_t vertex_attrib_count;
-    uint32_t vertex_binding_stride;
-    SpvShader spv_vertex_shader = {
-        .code = p_pipeline->p_shaders[vertex_index].p_spv_code,
-        .size = p_pipeline->p_shaders[vertex_index].spv_code_size,
+    // Vertex input attributes from the instance schema, checked against the stored reflection
+    Vk_VertexLayout vertex_layout = vk_VertexLayout_ForShader(&p_pipeline->p_shaders[vertex_index].reflection);
+    TRACK(vk_VertexLayout_Verify(&vertex_layout, &p_pipeline->p_shaders[vertex_index].reflection));
+    p_pipeline->vertex_pulling = vertex_layout.stride == 0;
+
+    // The instance mesh specialises the vertex shader, a shader without INSTANCE_MESH only draws quads
+    VkSpecializationMapEntry mesh_entry;
+    bool mesh_specialized = vk_InstanceMesh_MapEntry(&p_pipeline->p_shaders[vertex_index].reflection, &mesh_entry);
+    VERIFY(mesh_specialized || p_pipeline->instance_mesh == INSTANCE_MESH_QUAD, "the vertex shader has no INSTANCE_MESH to draw mesh %u with", p_pipeline->instance_mesh);
+    VkSpecializationInfo mesh_specialization = {
+        .mapEntryCount = 1,
+        .pMapEntries   = &mesh_entry,
+        .dataSize      = sizeof(unsigned int),
+        .pData         = &p_pipeline->instance_mesh,
     };
-
-    // Reflect vertex input attributes
-    TRACK(VkVertexInputAttributeDescription* vertex_input_attrib_desc = vk_VertexInputAttributeDescriptions_CreateFromVertexShader(
-        spv_vertex_shader, 
-        &vertex_attrib_count,
-        &vertex_binding_stride
-    ));
+    p_pipeline->vertex_count = vk_InstanceMesh_VertexCount(p_pipeline->instance_mesh);
 
     // Set up shader stages
     const unsigned int stage_count = (unsigned int)p_pipeline->shaders_count;
@@ -313,6 +325,7 @@ void Vk_GraphicsPipeline_CreatePipeline_0(
             p_stages[i].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         } else if (p_pipeline->p_shaders[i].shader_kind == shaderc_vertex_shader) {
             p_stages[i].stage = VK_SHADER_STAGE_VERTEX_BIT;
+            p_stages[i].pSpecializationInfo = mesh_specialized ? &mesh_specialization : NULL;
         } else {
             VERIFY(false, "Unsupported shader kind encountered");
         }
@@ -346,14 +359,14 @@ void Vk_GraphicsPipeline_CreatePipeline_0(
         .pStages             = p_stages,
         .pVertexInputState   = &(VkPipelineVertexInputStateCreateInfo) {
             .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            .vertexBindingDescriptionCount   = 1,
+            .vertexBindingDescriptionCount   = vertex_layout.stride ? 1 : 0,
             .pVertexBindingDescriptions      = (VkVertexInputBindingDescription[1]) {{
                 .binding   = 0,
-                .stride    = vertex_binding_stride,
+                .stride    = vertex_layout.stride,
                 .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
             }},
-            .vertexAttributeDescriptionCount = vertex_attrib_count,
-            .pVertexAttributeDescriptions    = vertex_input_attrib_desc,
+            .vertexAttributeDescriptionCount = vertex_layout.attributes_count,
+            .pVertexAttributeDescriptions    = vertex_layout.p_attributes,
         },
         .pInputAssemblyState = &(VkPipelineInputAssemblyStateCreateInfo) {
             .sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -400,7 +413,7 @@ void Vk_GraphicsPipeline_CreatePipeline_0(
                                        VK_COLOR_COMPONENT_G_BIT | 
                                        VK_COLOR_COMPONENT_B_BIT | 
                                        VK_COLOR_COMPONENT_A_BIT,
-                .blendEnable         = VK_TRUE,
+                .blendEnable         = vk_InstanceMesh_Blends(p_pipeline->instance_mesh) ? VK_TRUE : VK_FALSE,
                 .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
                 .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
                 .colorBlendOp        = VK_BLEND_OP_ADD,
@@ -421,11 +434,11 @@ void Vk_GraphicsPipeline_CreatePipeline_0(
         .basePipelineIndex   = -1
     };
 
-    TRACK(result = vkCreateGraphicsPipelines(p_pipeline->p_vk->device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &p_pipeline->graphics_pipeline));
+    TRACK(result = vkCreateGraphicsPipelines(p_pipeline->p_vk->device, p_pipeline->p_vk->pipeline_cache, 1, &pipeline_info, NULL, &p_pipeline->graphics_pipeline));
     VERIFY(result == VK_SUCCESS, "Failed to create graphics pipeline");
+    p_pipeline->dynamic_scissor = false;
 
     free(p_stages);
-    free(vertex_input_attrib_desc);
 
     // Note: If you need to destroy the shader modules like in vk_Pipeline_Graphics_Create(), 
     // do so here, or ensure they're destroyed elsewhere after pipeline creation.
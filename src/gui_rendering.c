@@ -7,6 +7,19 @@ Vk_Rendering Vk_Rendering_Create()
     return rendering;
 }
 
+// Pipelines with vertex pulling read the instances and their indices as storage buffers, written again
+// whenever either buffer or the descriptor sets are replaced
+static void WriteInstancePullDescriptors(Vk_Rendering* p_rendering) {
+    if (!p_rendering->p_pipeline || !p_rendering->p_pipeline->vertex_pulling || !p_rendering->p_desc_sets) {
+        return;
+    }
+    if (p_rendering->instance_buffer.buffer == VK_NULL_HANDLE || p_rendering->instance_indices.buffer == VK_NULL_HANDLE) {
+        return;
+    }
+    TRACK(Vk_Rendering_UpdateStorageBuffer(p_rendering, INSTANCE_PULL_SET, INSTANCE_PULL_DATA_BINDING, 0, p_rendering->instance_buffer.buffer, 0, VK_WHOLE_SIZE));
+    TRACK(Vk_Rendering_UpdateStorageBuffer(p_rendering, INSTANCE_PULL_SET, INSTANCE_PULL_INDICES_BINDING, 0, p_rendering->instance_indices.buffer, 0, VK_WHOLE_SIZE));
+}
+
 void Vk_Rendering_SetGraphicsPipeline(
     Vk_Rendering* p_rendering,
     Vk_GraphicsPipeline* p_pipeline, VkBuffer buffer, Image* p_image)
@@ -24,17 +37,18 @@ void Vk_Rendering_SetGraphicsPipeline(
 
     // Creating descriptor sets
     if (p_rendering->p_desc_sets) {
-        TRACK(VkResult result = vkFreeDescriptorSets(p_pipeline->p_vk->device, p_pipeline->p_vk->descriptor_pool, p_rendering->desc_sets_count, p_rendering->p_desc_sets));
-        VERIFY(result == VK_SUCCESS, "Failed to free descriptor sets");
+        // the sets may still be bound by a frame in flight
+        TRACK(vk_DeletionQueue_RetireDescriptorSets(p_pipeline->p_vk, p_rendering->desc_pool, p_rendering->p_desc_sets, p_rendering->desc_sets_count));
         TRACK(free(p_rendering->p_desc_sets)); 
         p_rendering->p_desc_sets = NULL; 
     }
 
-    TRACK(p_rendering->p_desc_sets = vk_DescriptorSet_Create_0(p_pipeline->p_vk, p_pipeline->p_desc_sets_layout, p_pipeline->desc_sets_count, buffer, p_image));
+    TRACK(p_rendering->p_desc_sets = vk_DescriptorSet_Create_0(p_pipeline->p_vk, p_pipeline->p_desc_sets_layout, p_pipeline->desc_sets_count, buffer, p_image, &p_rendering->desc_pool));
     p_rendering->desc_sets_count = p_pipeline->desc_sets_count;
     p_rendering->p_vk = p_pipeline->p_vk; 
     p_rendering->p_pipeline = p_pipeline; 
     p_rendering->command_buffer_needs_recording = true;
+    WriteInstancePullDescriptors(p_rendering);
 }
 
 void Vk_Rendering_SetTargetImage(
@@ -51,13 +65,51 @@ void Vk_Rendering_SetTargetImage(
     VERIFY(p_target_image->format != VK_FORMAT_UNDEFINED, "Target image format is VK_FORMAT_UNDEFINED");
 
     if (p_rendering->command_buffer != VK_NULL_HANDLE) {
-        TRACK(vkFreeCommandBuffers(p_rendering->p_vk->device, p_rendering->p_vk->command_pool, 1, &p_rendering->command_buffer));
+        TRACK(vk_DeletionQueue_RetireCommandBuffer(p_rendering->p_vk, p_rendering->p_vk->command_pool, p_rendering->command_buffer));
+        p_rendering->command_buffer = VK_NULL_HANDLE;
     }
 
     p_rendering->p_target_image = p_target_image;
     p_rendering->command_buffer_needs_recording = true;
 }
 
+void Vk_Rendering_SetDrawBatch(
+    Vk_Rendering* p_rendering,
+    Vk_DrawBatch* p_draw_batch)
+{
+    VERIFY(p_rendering, "NULL pointer");
+
+    // Recording bakes in the runs of the last Vk_DrawBatch_Build, whose frame also uploads the indirect commands.
+    // After building the batch again, set it again so the command buffer is recorded with the new runs.
+    p_rendering->p_draw_batch = p_draw_batch;
+    p_rendering->command_buffer_needs_recording = true;
+}
+
+// The values are baked into the command buffer, so a change records it again
+void Vk_Rendering_SetPushConstants(
+    Vk_Rendering* p_rendering,
+    const Vk_PushConstants* p_push_constants)
+{
+    VERIFY(p_rendering, "NULL pointer");
+    VERIFY(p_push_constants, "NULL pointer");
+
+    if (memcmp(&p_rendering->push_constants, p_push_constants, sizeof(Vk_PushConstants)) == 0) {
+        return;
+    }
+    p_rendering->push_constants = *p_push_constants;
+    p_rendering->command_buffer_needs_recording = true;
+}
+
+// Pushes the part of Vk_PushConstants the pipeline declares
+static void PushConstants(Vk_Rendering* p_rendering, Vk_CommandRecorder* p_recorder) {
+    VkPushConstantRange range = p_rendering->p_pipeline->push_constant_range;
+    if (range.size == 0) {
+        return;
+    }
+    VERIFY(range.offset + range.size <= sizeof(Vk_PushConstants), "the pipeline declares push constants [%u, %u), Vk_PushConstants has %zu bytes", range.offset, range.offset + range.size, sizeof(Vk_PushConstants));
+    Vk_CommandRecorder_PushConstants(p_recorder, p_rendering->p_pipeline->pipeline_layout, range, (const unsigned char*)&p_rendering->push_constants + range.offset);
+}
+
 void Vk_Rendering_UpdateInstanceBuffer(
     Vk_Rendering* p_rendering, 
     size_t dst_offset, 
@@ -71,12 +123,13 @@ void Vk_Rendering_UpdateInstanceBuffer(
 
     if (p_rendering->instance_buffer.size < dst_offset + size || p_rendering->instance_buffer.buffer == VK_NULL_HANDLE) {
         Buffer tmp_buffer = p_rendering->instance_buffer;
-        p_rendering->instance_buffer = vk_Buffer_Create(p_rendering->p_vk, dst_offset+size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        p_rendering->instance_buffer = vk_Buffer_Create(p_rendering->p_vk, dst_offset+size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
         if (tmp_buffer.buffer != VK_NULL_HANDLE && tmp_buffer.size > 0) {
-            TRACK(vk_Buffer_CopyBuffer(p_rendering->p_vk, p_rendering->instance_buffer, tmp_buffer, 0, 0, tmp_buffer.size));
+            TRACK(vk_Buffer_CopyBuffer(p_rendering->p_vk, tmp_buffer, p_rendering->instance_buffer, 0, 0, tmp_buffer.size));
         }
-        TRACK(vmaDestroyBuffer(p_rendering->p_vk->allocator, tmp_buffer.buffer, tmp_buffer.allocation));
+        TRACK(vk_DeletionQueue_RetireBuffer(p_rendering->p_vk, tmp_buffer));
         p_rendering->command_buffer_needs_recording = true;
+        WriteInstancePullDescriptors(p_rendering);
     }
     TRACK(vk_Buffer_Update(p_rendering->p_vk, p_rendering->instance_buffer, dst_offset, p_src_data, size));
 }
@@ -95,19 +148,49 @@ void Vk_Rendering_UpdateInstanceBufferWithBuffer(
 
     if (p_rendering->instance_buffer.size < dst_offset + size || p_rendering->instance_buffer.buffer == VK_NULL_HANDLE) {
         Buffer tmp_buffer = p_rendering->instance_buffer;
-        TRACK(p_rendering->instance_buffer = vk_Buffer_Create(p_rendering->p_vk, dst_offset+size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT));
+        TRACK(p_rendering->instance_buffer = vk_Buffer_Create(p_rendering->p_vk, dst_offset+size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
         if (tmp_buffer.buffer != VK_NULL_HANDLE && tmp_buffer.size > 0) {
-            TRACK(vk_Buffer_CopyBuffer(p_rendering->p_vk, p_rendering->instance_buffer, tmp_buffer, 0, 0, tmp_buffer.size));
+            TRACK(vk_Buffer_CopyBuffer(p_rendering->p_vk, tmp_buffer, p_rendering->instance_buffer, 0, 0, tmp_buffer.size));
         }
-        TRACK(vmaDestroyBuffer(p_rendering->p_vk->allocator, tmp_buffer.buffer, tmp_buffer.allocation));
+        TRACK(vk_DeletionQueue_RetireBuffer(p_rendering->p_vk, tmp_buffer));
         if (p_rendering->command_buffer != VK_NULL_HANDLE) {
-            TRACK(vkFreeCommandBuffers(p_rendering->p_vk->device, p_rendering->p_vk->command_pool, 1, &p_rendering->command_buffer));
+            TRACK(vk_DeletionQueue_RetireCommandBuffer(p_rendering->p_vk, p_rendering->p_vk->command_pool, p_rendering->command_buffer));
+            p_rendering->command_buffer = VK_NULL_HANDLE;
         }
         p_rendering->command_buffer_needs_recording = true;
+        WriteInstancePullDescriptors(p_rendering);
     }
     TRACK(vk_Buffer_CopyBuffer(p_rendering->p_vk, src_buffer, p_rendering->instance_buffer, src_offset, dst_offset, size));
 }
 
+// The instances a pipeline with vertex pulling draws, gl_InstanceIndex selects an index and the index an
+// instance. Culling and sorting rewrite these 4 bytes per instance instead of moving InstanceData.
+void Vk_Rendering_UpdateInstanceIndices(
+    Vk_Rendering* p_rendering,
+    size_t first_index,
+    const uint32_t* p_indices,
+    size_t indices_count)
+{
+    VERIFY(p_rendering, "NULL pointer");
+    VERIFY(p_rendering->p_vk, "NULL pointer");
+    VERIFY(p_indices, "NULL pointer passed as source data");
+    VERIFY(indices_count > 0, "indices_count must be greater than zero");
+
+    size_t dst_offset = first_index * sizeof(uint32_t);
+    size_t size = indices_count * sizeof(uint32_t);
+    if (p_rendering->instance_indices.size < dst_offset + size || p_rendering->instance_indices.buffer == VK_NULL_HANDLE) {
+        Buffer tmp_buffer = p_rendering->instance_indices;
+        TRACK(p_rendering->instance_indices = vk_Buffer_Create(p_rendering->p_vk, dst_offset + size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
+        if (tmp_buffer.buffer != VK_NULL_HANDLE && tmp_buffer.size > 0) {
+            TRACK(vk_Buffer_CopyBuffer(p_rendering->p_vk, tmp_buffer, p_rendering->instance_indices, 0, 0, tmp_buffer.size));
+        }
+        TRACK(vk_DeletionQueue_RetireBuffer(p_rendering->p_vk, tmp_buffer));
+        p_rendering->command_buffer_needs_recording = true;
+        WriteInstancePullDescriptors(p_rendering);
+    }
+    TRACK(vk_Buffer_Update(p_rendering->p_vk, p_rendering->instance_indices, dst_offset, p_indices, size));
+}
+
 void Vk_Rendering_UpdateInstanceDrawRange(
     Vk_Rendering* p_rendering,
     unsigned int first_instance,
@@ -117,8 +200,9 @@ void Vk_Rendering_UpdateInstanceDrawRange(
 
     if (p_rendering->indirect_buffer.size == 0 && p_rendering->indirect_buffer.buffer == VK_NULL_HANDLE) {
         TRACK(p_rendering->indirect_buffer = vk_Buffer_Create(p_rendering->p_vk, sizeof(VkDrawIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT));
-        if (p_rendering->command_buffer == VK_NULL_HANDLE) {
-            TRACK(vkFreeCommandBuffers(p_rendering->p_vk->device, p_rendering->p_vk->command_pool, 1, &p_rendering->command_buffer));
+        if (p_rendering->command_buffer != VK_NULL_HANDLE) {
+            TRACK(vk_DeletionQueue_RetireCommandBuffer(p_rendering->p_vk, p_rendering->p_vk->command_pool, p_rendering->command_buffer));
+            p_rendering->command_buffer = VK_NULL_HANDLE;
         }
         p_rendering->command_buffer_needs_recording = true;
     }
@@ -127,7 +211,7 @@ void Vk_Rendering_UpdateInstanceDrawRange(
     VERIFY(p_rendering->indirect_buffer.buffer != VK_NULL_HANDLE, "VkBuffer cannot be NULL when buffer size is not 0");
 
     VkDrawIndirectCommand draw_cmd = {
-        .vertexCount = 4, 
+        .vertexCount = p_rendering->p_pipeline ? p_rendering->p_pipeline->vertex_count : vk_InstanceMesh_VertexCount(INSTANCE_MESH_QUAD),
         .instanceCount = instance_count,
         .firstVertex = 0, 
         .firstInstance = first_instance
@@ -191,25 +275,20 @@ void Vk_Rendering_RecordCommandBuffer(
 
     //TRACK(vk_Image_TransitionLayout(p_rendering->command_buffer, p_rendering->p_target_image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
 
-    VkImageMemoryBarrier barrier_to_color_attachment = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .srcAccessMask = 0,
-        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = p_rendering->p_target_image->image,
-        .subresourceRange = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
+    // the swapchain image is acquired by a semaphore waited at COLOR_ATTACHMENT_OUTPUT, so the transition chains to that stage
+    Vk_BarrierBatch barriers = {0};
+    VkImageSubresourceRange color_range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = 0,
+        .layerCount = 1,
     };
-
-    TRACK(vkCmdPipelineBarrier(p_rendering->command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 1, &barrier_to_color_attachment));
+    vk_Barrier_AddImage(&barriers, p_rendering->p_target_image->image, color_range,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+    TRACK(vk_Barrier_Flush(&barriers, p_rendering->command_buffer));
 
 
     VkRenderingInfo rendering_info = {
@@ -236,8 +315,11 @@ void Vk_Rendering_RecordCommandBuffer(
     };
 
     TRACK(vkCmdBeginRendering(p_rendering->command_buffer, &rendering_info));
-    TRACK(vkCmdBindPipeline(p_rendering->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, p_rendering->p_pipeline->graphics_pipeline));
-    TRACK(vkCmdBindDescriptorSets(p_rendering->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, p_rendering->p_pipeline->pipeline_layout, 0, (unsigned int)p_rendering->desc_sets_count, p_rendering->p_desc_sets, 0, NULL));
+
+    Vk_CommandRecorder recorder = Vk_CommandRecorder_Begin(p_rendering->command_buffer);
+    Vk_CommandRecorder_BindPipeline(&recorder, VK_PIPELINE_BIND_POINT_GRAPHICS, p_rendering->p_pipeline->graphics_pipeline, p_rendering->p_pipeline->dynamic_scissor);
+    Vk_CommandRecorder_BindDescriptorSets(&recorder, VK_PIPELINE_BIND_POINT_GRAPHICS, p_rendering->p_pipeline->pipeline_layout, 0, (unsigned int)p_rendering->desc_sets_count, p_rendering->p_desc_sets);
+    PushConstants(p_rendering, &recorder);
 
     VkViewport viewport = {
         .x = 0.0f, 
@@ -247,38 +329,38 @@ void Vk_Rendering_RecordCommandBuffer(
         .minDepth = 0.0f, 
         .maxDepth = 1.0f
     };
-    TRACK(vkCmdSetViewport(p_rendering->command_buffer, 0, 1, &viewport));
+    Vk_CommandRecorder_SetViewport(&recorder, viewport);
 
     VkRect2D scissor = {
         .offset = {0, 0},  
         .extent = p_rendering->p_target_image->extent
     };
-    TRACK(vkCmdSetScissor(p_rendering->command_buffer, 0, 1, &scissor));
-    TRACK( vkCmdBindVertexBuffers(p_rendering->command_buffer, 0, 1, (VkBuffer[]){p_rendering->instance_buffer.buffer}, (VkDeviceSize[]){0} ) );
-    TRACK(vkCmdDraw(p_rendering->command_buffer, 4,5,0,0));
-    //TRACK(vkCmdDrawIndirect(p_rendering->command_buffer, p_rendering->indirect_buffer.buffer, 0, 1, sizeof(VkDrawIndirectCommand)));
+    Vk_CommandRecorder_SetScissor(&recorder, scissor);
+    if (p_rendering->p_draw_batch) {
+        TRACK(Vk_DrawBatch_Record(
+            p_rendering->p_draw_batch,
+            &recorder,
+            p_rendering->p_pipeline,
+            p_rendering->p_desc_sets,
+            p_rendering->desc_sets_count,
+            p_rendering->instance_buffer.buffer,
+            p_rendering->p_target_image->extent));
+    } else {
+        if (!p_rendering->p_pipeline->vertex_pulling) {
+            Vk_CommandRecorder_BindVertexBuffers(&recorder, 0, 1, (VkBuffer[]){p_rendering->instance_buffer.buffer}, (VkDeviceSize[]){0});
+        }
+        TRACK(vkCmdDraw(p_rendering->command_buffer, p_rendering->p_pipeline->vertex_count, 5, 0, 0));
+        //TRACK(vkCmdDrawIndirect(p_rendering->command_buffer, p_rendering->indirect_buffer.buffer, 0, 1, sizeof(VkDrawIndirectCommand)));
+    }
+    Vk_CommandRecorder_End(&recorder, p_rendering->p_vk);
 
     TRACK(vkCmdEndRendering(p_rendering->command_buffer));
 
-    VkImageMemoryBarrier barrier_to_present = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-        .dstAccessMask = 0,
-        .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = p_rendering->p_target_image->image,
-        .subresourceRange = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
-    };
-
-    TRACK(vkCmdPipelineBarrier(p_rendering->command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier_to_present));
+    vk_Barrier_AddImage(&barriers, p_rendering->p_target_image->image, color_range,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+    TRACK(vk_Barrier_Flush(&barriers, p_rendering->command_buffer));
     
     VERIFY(vkEndCommandBuffer(p_rendering->command_buffer) == VK_SUCCESS, "Failed to end command buffer for GUI rendering");
 
@@ -339,25 +421,20 @@ void Vk_Rendering_RecordCommandBuffer_0(
     VERIFY(result == VK_SUCCESS, "Failed to begin command buffer for GUI rendering");
 
     // Image layout transitions remain the same
-    VkImageMemoryBarrier barrier_to_color_attachment = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .srcAccessMask = 0,
-        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = p_rendering->p_target_image->image,
-        .subresourceRange = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
+    // the swapchain image is acquired by a semaphore waited at COLOR_ATTACHMENT_OUTPUT, so the transition chains to that stage
+    Vk_BarrierBatch barriers = {0};
+    VkImageSubresourceRange color_range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = 0,
+        .layerCount = 1,
     };
-
-    TRACK(vkCmdPipelineBarrier(p_rendering->command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 1, &barrier_to_color_attachment));
+    vk_Barrier_AddImage(&barriers, p_rendering->p_target_image->image, color_range,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+    TRACK(vk_Barrier_Flush(&barriers, p_rendering->command_buffer));
 
     VkRenderingInfo rendering_info = {
         .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
@@ -383,42 +460,34 @@ void Vk_Rendering_RecordCommandBuffer_0(
     };
 
     TRACK(vkCmdBeginRendering(p_rendering->command_buffer, &rendering_info));
-    TRACK(vkCmdBindPipeline(p_rendering->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, p_rendering->p_pipeline->graphics_pipeline));
-    TRACK(vkCmdBindDescriptorSets(p_rendering->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, p_rendering->p_pipeline->pipeline_layout, 0, (unsigned int)p_rendering->desc_sets_count, p_rendering->p_desc_sets, 0, NULL));
+
+    Vk_CommandRecorder recorder = Vk_CommandRecorder_Begin(p_rendering->command_buffer);
+    Vk_CommandRecorder_BindPipeline(&recorder, VK_PIPELINE_BIND_POINT_GRAPHICS, p_rendering->p_pipeline->graphics_pipeline, p_rendering->p_pipeline->dynamic_scissor);
+    Vk_CommandRecorder_BindDescriptorSets(&recorder, VK_PIPELINE_BIND_POINT_GRAPHICS, p_rendering->p_pipeline->pipeline_layout, 0, (unsigned int)p_rendering->desc_sets_count, p_rendering->p_desc_sets);
+    PushConstants(p_rendering, &recorder);
 
     // Removed dynamic state commands since they're now set in the pipeline
     //TRACK(vkCmdSetViewport(p_rendering->command_buffer, 0, 1, &viewport));
     //TRACK(vkCmdSetScissor(p_rendering->command_buffer, 0, 1, &scissor));
 
-    TRACK(vkCmdBindVertexBuffers(p_rendering->command_buffer, 0, 1, (VkBuffer[]){p_rendering->instance_buffer.buffer}, (VkDeviceSize[]){0}));
+    if (!p_rendering->p_pipeline->vertex_pulling) {
+        Vk_CommandRecorder_BindVertexBuffers(&recorder, 0, 1, (VkBuffer[]){p_rendering->instance_buffer.buffer}, (VkDeviceSize[]){0});
+    }
     
     // Use either vkCmdDraw or vkCmdDrawIndirect based on your needs
-    TRACK(vkCmdDraw(p_rendering->command_buffer, 4, 5, 0, 0));
+    TRACK(vkCmdDraw(p_rendering->command_buffer, p_rendering->p_pipeline->vertex_count, 5, 0, 0));
     // or if using indirect drawing:
     // TRACK(vkCmdDrawIndirect(p_rendering->command_buffer, p_rendering->indirect_buffer.buffer, 0, 1, sizeof(VkDrawIndirectCommand)));
+    Vk_CommandRecorder_End(&recorder, p_rendering->p_vk);
 
     TRACK(vkCmdEndRendering(p_rendering->command_buffer));
 
     // Image layout transitions remain the same
-    VkImageMemoryBarrier barrier_to_present = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-        .dstAccessMask = 0,
-        .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = p_rendering->p_target_image->image,
-        .subresourceRange = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
-    };
-
-    TRACK(vkCmdPipelineBarrier(p_rendering->command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier_to_present));
+    vk_Barrier_AddImage(&barriers, p_rendering->p_target_image->image, color_range,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+    TRACK(vk_Barrier_Flush(&barriers, p_rendering->command_buffer));
     
     VERIFY(vkEndCommandBuffer(p_rendering->command_buffer) == VK_SUCCESS, "Failed to end command buffer for GUI rendering");
 
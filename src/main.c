@@ -1,22 +1,151 @@
 #include "vk.h"
 
+#define WINDOW_WIDTH    800
+#define WINDOW_HEIGHT   600
+
+// Everything the startup tasks produce
+typedef struct {
+    Vk                      vk;
+    SpvShader               spv_shaders[2];         // fragment, vertex
+    unsigned char*          p_image_pixels;
+    VkExtent2D              image_extent;
+    Image                   image;
+    Vk_GraphicsPipeline     p;
+    Vk_VertexLayout         packed_layout;          // the variants point at it
+    Vk_PipelineVariants     variants;
+} Startup;
+
+static void TaskShaderc(void* p_arg)    { Startup* p_s = p_arg; vk_Create_Shaderc(&p_s->vk); }
+static void TaskInstance(void* p_arg)   { Startup* p_s = p_arg; vk_Create_Instance(&p_s->vk, WINDOW_WIDTH, WINDOW_HEIGHT, "Vulkan GUI"); }
+static void TaskDevice(void* p_arg)     { Startup* p_s = p_arg; vk_Create_Device(&p_s->vk); }
+static void TaskSwapchain(void* p_arg)  { Startup* p_s = p_arg; vk_Create_Swapchain(&p_s->vk, WINDOW_WIDTH, WINDOW_HEIGHT); }
+static void TaskPools(void* p_arg)      { Startup* p_s = p_arg; vk_Create_Pools(&p_s->vk); }
+
+// The demo instances sample the texture table, variants without textures would specialise TEXTURED to 0.
+// They overlap and are translucent, so they draw as octagons, the ring and interior split needs instances
+// that neither overlap nor blend.
+#define DEMO_INSTANCE_MESH INSTANCE_MESH_OCTAGON
+static const Vk_SpecConstant demo_constants[] = { { "TEXTURED", 1 }, { "INSTANCE_MESH", DEMO_INSTANCE_MESH } };
+#define DEMO_CONSTANTS_COUNT (sizeof(demo_constants) / sizeof(demo_constants[0]))
+
+static void TaskFragShader(void* p_arg) {
+    Startup* p_s = p_arg;
+    p_s->spv_shaders[0] = vk_SpvShader_Load(&p_s->vk, "shaders/shader.frag.glsl", shaderc_fragment_shader);
+}
+static void TaskVertShader(void* p_arg) {
+    Startup* p_s = p_arg;
+    p_s->spv_shaders[1] = vk_SpvShader_Load(&p_s->vk, "shaders/shader_packed.vert.glsl", shaderc_vertex_shader);
+}
+static void TaskImageDecode(void* p_arg) {
+    Startup* p_s = p_arg;
+    p_s->p_image_pixels = vk_Image_DecodeFile("/home/tk/dev/Vulkan/images/Bitcoin.png", &p_s->image_extent);
+}
+// the only startup task that records and submits commands, so the command pool and queue need no locking
+static void TaskImageUpload(void* p_arg) {
+    Startup* p_s = p_arg;
+    p_s->image = vk_Image_CreateFromPixels(&p_s->vk, p_s->p_image_pixels, p_s->image_extent, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    vk_Image_FreeDecoded(p_s->p_image_pixels);
+    p_s->p_image_pixels = NULL;
+}
+static void TaskPipeline(void* p_arg) {
+    Startup* p_s = p_arg;
+    Vk_GraphicsPipeline* p_p = &p_s->p;
+    Vk_ShaderReflection reflections[2] = { *p_s->spv_shaders[0].p_reflection, *p_s->spv_shaders[1].p_reflection };
+    p_p->p_desc_sets_layout_create_info = vk_DescriptorSetLayoutCreateInfo_Create(&p_s->vk, reflections, 2, &p_p->desc_sets_count);
+    p_p->p_desc_sets_layout = vk_DescriptorSetLayout_Create(&p_s->vk, p_p->p_desc_sets_layout_create_info, p_p->desc_sets_count);
+    p_p->push_constant_range = vk_PushConstantRange_CreateFromReflections(reflections, 2);
+    p_p->pipeline_layout = vk_PipelineLayout_Create(p_s->vk.device, p_p->p_desc_sets_layout, p_p->desc_sets_count, p_p->push_constant_range);
+    p_p->instance_mesh = DEMO_INSTANCE_MESH;
+    p_p->vertex_count = vk_InstanceMesh_VertexCount(p_p->instance_mesh);
+    p_s->packed_layout = vk_VertexLayout_InstanceDataPacked();
+    // seeded with the shaders already loaded for reflection, so the cache does not load them again
+    p_s->variants = Vk_PipelineVariants_Create(&p_s->vk, p_p->pipeline_layout, "shaders/shader_packed.vert.glsl", "shaders/shader.frag.glsl", &p_s->packed_layout);
+    VkPipeline pipeline = vk_Pipeline_Graphics_CreateSpecialized(&p_s->vk, p_p->pipeline_layout, p_s->spv_shaders[1], p_s->spv_shaders[0], demo_constants, DEMO_CONSTANTS_COUNT, &p_s->packed_layout);
+    Vk_PipelineVariants_Add(&p_s->variants, NULL, 0, demo_constants, DEMO_CONSTANTS_COUNT, pipeline);
+    free((void*)p_s->spv_shaders[0].code);
+    free((void*)p_s->spv_shaders[1].code);
+}
+// the startup pipelines reach the disk on a worker, not on the first frames
+static void TaskPipelineCacheSave(void* p_arg) {
+    Startup* p_s = p_arg;
+    vk_PipelineCache_Save(&p_s->vk);
+}
+
+#ifndef VK_NO_SHADERC
+// Shader hot reload keeps the pipeline layout, so edits have to keep the shader interface
+typedef struct {
+    Vk*                     p_vk;
+    Vk_GraphicsPipeline*    p_pipeline;
+    Vk_PipelineVariants*    p_variants;
+} Reload;
+
+static VkPipeline ReloadBuild(void* p_arg) {
+    Reload* p_r = p_arg;
+    SpvShader vert_shader, frag_shader;
+    if (!vk_SpvShader_TryCreateFromGlslFile(p_r->p_vk, "shaders/shader_packed.vert.glsl", shaderc_vertex_shader, &vert_shader)) {
+        return VK_NULL_HANDLE;
+    }
+    if (!vk_SpvShader_TryCreateFromGlslFile(p_r->p_vk, "shaders/shader.frag.glsl", shaderc_fragment_shader, &frag_shader)) {
+        free((void*)vert_shader.code);
+        return VK_NULL_HANDLE;
+    }
+    VkPipeline pipeline = vk_Pipeline_Graphics_CreateSpecialized(p_r->p_vk, p_r->p_pipeline->pipeline_layout, vert_shader, frag_shader, demo_constants, DEMO_CONSTANTS_COUNT, p_r->p_variants->p_vertex_layout);
+    free((void*)vert_shader.code);
+    free((void*)frag_shader.code);
+    // still on the watcher thread, so the render thread never waits on the disk
+    if (pipeline != VK_NULL_HANDLE) {
+        vk_PipelineCache_Save(p_r->p_vk);
+    }
+    return pipeline;
+}
+// The render commands are recorded every frame, the next frame draws with the new pipeline
+static void ReloadApply(void* p_arg, VkPipeline pipeline) {
+    Reload* p_r = p_arg;
+    // every cached variant was built from the old shaders, the demo one is replaced by the pipeline just built
+    Vk_PipelineVariants_Invalidate(p_r->p_variants);
+    Vk_PipelineVariants_Add(p_r->p_variants, NULL, 0, demo_constants, DEMO_CONSTANTS_COUNT, pipeline);
+    p_r->p_pipeline->graphics_pipeline = pipeline;
+}
+#endif
+
 int main(int argc, char** argv) {
     (void)argc;
     (void)argv;
 
-    Vk vk = vk_Create(800, 600, "Vulkan GUI");
+    // Shader loading and image decoding overlap device creation. The pipeline layout and the image both need
+    // the texture table the pools task creates.
+    static Startup startup;
+    startup.vk = vk_Initialize();
+    TRACK(Vk_TaskGraph graph = Vk_TaskGraph_Create(0));
+    unsigned int shaderc   = Vk_TaskGraph_Add(&graph, "shaderc",        TaskShaderc,     &startup, false, NULL, 0);
+    unsigned int instance  = Vk_TaskGraph_Add(&graph, "instance",       TaskInstance,    &startup, true,  NULL, 0);
+    unsigned int device    = Vk_TaskGraph_Add(&graph, "device",         TaskDevice,      &startup, false, &instance, 1);
+    unsigned int swapchain = Vk_TaskGraph_Add(&graph, "swapchain",      TaskSwapchain,   &startup, false, &device, 1);
+    unsigned int pools     = Vk_TaskGraph_Add(&graph, "pools",          TaskPools,       &startup, false, &device, 1);
+    unsigned int frag      = Vk_TaskGraph_Add(&graph, "frag shader",    TaskFragShader,  &startup, false, &shaderc, 1);
+    unsigned int vert      = Vk_TaskGraph_Add(&graph, "vert shader",    TaskVertShader,  &startup, false, &shaderc, 1);
+    unsigned int decode    = Vk_TaskGraph_Add(&graph, "image decode",   TaskImageDecode, &startup, false, NULL, 0);
+    Vk_TaskGraph_Add(&graph, "image upload", TaskImageUpload, &startup, false, (unsigned int[]){ decode, pools }, 2);
+    unsigned int pipeline  = Vk_TaskGraph_Add(&graph, "pipeline",       TaskPipeline,    &startup, false, (unsigned int[]){ frag, vert, swapchain, pools }, 4);
+    Vk_TaskGraph_Add(&graph, "pipeline cache", TaskPipelineCacheSave, &startup, false, &pipeline, 1);
+    TRACK(Vk_TaskGraph_Run(&graph));
+    TRACK(Vk_TaskGraph_PrintReport(&graph));
 
-    TRACK(Buffer uniform_buffer = vk_Buffer_Create(&vk, sizeof(UniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT ));
-    UniformBufferObject ubo = {};
-    ubo.targetWidth = (float)vk.p_images[0].extent.width;
-    ubo.targetHeight = (float)vk.p_images[0].extent.height;
-    vk_Buffer_Update(&vk, uniform_buffer, 0, &ubo, sizeof(UniformBufferObject));
+    Vk vk = startup.vk;
+    // the variants were created against startup.vk, which is not used after the copy
+    Vk_PipelineVariants variants = startup.variants;
+    variants.p_vk = &vk;
 
-    TRACK(Buffer instance_buffer = vk_Buffer_Create(&vk, sizeof(InstanceData) * ALL_INSTANCE_COUNT, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT ));
+    // the target size is pushed with the draw, there is no uniform buffer to rewrite every frame
+    Vk_PushConstants push_constants = {
+        .target_size = { (float)vk.p_images[0].extent.width, (float)vk.p_images[0].extent.height },
+    };
+
+    // the demo instances only use what InstanceDataPacked keeps, vk_StartApp packs them
+    TRACK(Buffer instance_buffer = vk_Buffer_Create(&vk, sizeof(InstanceDataPacked) * ALL_INSTANCE_COUNT, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT ));
     VERIFY(instance_buffer.buffer!=VK_NULL_HANDLE,  "instance_buffer is VK_NULL_HANDLE");
 
-    TRACK(Image image = vk_Image_CreateFromImageFile(&vk, "/home/tk/dev/Vulkan/images/Bitcoin.png", VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
-    printf("create image\n");
+    Image image = startup.image;
 
     /*
     TRACK(SpvShader vert_shader = vk_SpvShader_CreateFromGlslFile(&vk, "shaders/shader.vert.glsl", shaderc_vertex_shader));
@@ -33,15 +162,8 @@ int main(int argc, char** argv) {
     // 3. remove indirect comparibility
 
     
-    Vk_GraphicsPipeline                    p;
-    
-    SpvReflectShaderModule                  spv_reflect_shader_modules[2];
-    TRACK(spv_reflect_shader_modules[0] = vk_SpvReflectShaderModule_Create(vk_SpvShader_CreateFromGlslFile(&vk, "shaders/shader.frag.glsl", shaderc_fragment_shader)));
-    TRACK(spv_reflect_shader_modules[1] = vk_SpvReflectShaderModule_Create(vk_SpvShader_CreateFromGlslFile(&vk, "shaders/shader.vert.glsl", shaderc_vertex_shader)));
-    TRACK(p.p_desc_sets_layout_create_info = vk_DescriptorSetLayoutCreateInfo_Create(&vk, spv_reflect_shader_modules, 2, &p.desc_sets_count));
-    TRACK(p.p_desc_sets_layout = vk_DescriptorSetLayout_Create(&vk, p.p_desc_sets_layout_create_info, p.desc_sets_count));
-    TRACK(p.pipeline_layout = vk_PipelineLayout_Create(vk.device, p.p_desc_sets_layout, p.desc_sets_count));
-    TRACK(p.graphics_pipeline = vk_Pipeline_Graphics_Create(&vk, p.pipeline_layout));
+    Vk_GraphicsPipeline                    p = startup.p;
+    TRACK(p.graphics_pipeline = Vk_PipelineVariants_Get(&variants, NULL, 0, demo_constants, DEMO_CONSTANTS_COUNT));
     
     
     /*
@@ -60,17 +182,7 @@ int main(int argc, char** argv) {
     }
     */  
     
-    TRACK(VkDescriptorSet*                  p_desc_sets = vk_DescriptorSet_Create_0(&vk, p.p_desc_sets_layout, p.desc_sets_count, uniform_buffer.buffer, &image));
-    
-    TRACK(VkCommandBuffer*                  swapChainCommandBuffers = vk_CommandBuffer_CreateForSwapchain(
-        &vk,
-        p_desc_sets,
-        p.desc_sets_count,
-        p.graphics_pipeline,
-        p.pipeline_layout,
-        instance_buffer.buffer,
-        &image
-    ));
+    TRACK(VkDescriptorSet*                  p_desc_sets = vk_DescriptorSet_Create_0(&vk, p.p_desc_sets_layout, p.desc_sets_count, VK_NULL_HANDLE, &image, NULL));
     
 
     /*
@@ -96,6 +208,17 @@ int main(int argc, char** argv) {
         &image
     ));
     */
+    Vk_ShaderWatch shader_watch = {0};
+#ifndef VK_NO_SHADERC
+    Reload reload = {
+        .p_vk               = &vk,
+        .p_pipeline         = &p,
+        .p_variants         = &variants,
+    };
+    const char* watched_shaders[] = { "shaders/shader_packed.vert.glsl", "shaders/shader.vert.inl", "shaders/shader.frag.glsl" };
+    TRACK(Vk_ShaderWatch_Start(&shader_watch, &vk, watched_shaders, 3, ReloadBuild, ReloadApply, &reload));
+#endif
+
     TRACK(VkSemaphore imageAvailableSemaphore = vk_Semaphore_Create(vk.device));
     TRACK(VkSemaphore renderFinishedSemaphore = vk_Semaphore_Create(vk.device));
     TRACK(VkFence inFlightFence = vk_Fence_Create(vk.device));
@@ -104,11 +227,16 @@ int main(int argc, char** argv) {
         imageAvailableSemaphore,
         renderFinishedSemaphore,
         inFlightFence,
-        swapChainCommandBuffers,
-        uniform_buffer.buffer,
-        uniform_buffer.allocation,
-        instance_buffer
+        &p,
+        p_desc_sets,
+        &push_constants,
+        instance_buffer,
+        image.texture_index,
+        &shader_watch
     ));
+    TRACK(Vk_ShaderWatch_Stop(&shader_watch));
+    TRACK(vk_Image_Destroy(&vk, &image));
+    TRACK(Vk_PipelineVariants_Destroy(&variants));
     /*
     TRACK(vk_Destroy(
         &vk,
@@ -127,15 +255,15 @@ int main(int argc, char** argv) {
     ));*/
     TRACK(vk_Destroy(
         &vk,
-        p.graphics_pipeline,
+        VK_NULL_HANDLE,
         p.p_desc_sets_layout,
         p.p_desc_sets_layout[0],
-        uniform_buffer.buffer,
-        uniform_buffer.allocation,
+        VK_NULL_HANDLE,
+        NULL,
         instance_buffer.buffer,
         instance_buffer.allocation,
         p_desc_sets[0],
-        swapChainCommandBuffers,
+        NULL,
         imageAvailableSemaphore,
         renderFinishedSemaphore,
         inFlightFence
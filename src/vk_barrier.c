@@ -0,0 +1,129 @@
+#include "vk.h"
+
+// Stages and accesses of the work that uses an image in the given layout. As a source only writes
+// need to be made available, reads just need the execution dependency.
+void vk_Barrier_LayoutStageAccess(VkImageLayout layout, bool is_source, VkPipelineStageFlags2* p_stage, VkAccessFlags2* p_access) {
+    VERIFY(p_stage && p_access, "NULL pointer");
+
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED:
+            *p_stage  = VK_PIPELINE_STAGE_2_NONE;
+            *p_access = VK_ACCESS_2_NONE;
+            break;
+        case VK_IMAGE_LAYOUT_PREINITIALIZED:
+            *p_stage  = VK_PIPELINE_STAGE_2_HOST_BIT;
+            *p_access = VK_ACCESS_2_HOST_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+            *p_stage  = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+            *p_access = is_source ? VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
+                                  : VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+            *p_stage  = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+            *p_access = is_source ? VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+                                  : VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            *p_stage  = VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT;
+            *p_access = is_source ? VK_ACCESS_2_NONE : VK_ACCESS_2_TRANSFER_READ_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            *p_stage  = VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT;
+            *p_access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            // textures are only sampled by fragment shaders
+            *p_stage  = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+            *p_access = is_source ? VK_ACCESS_2_NONE : VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_GENERAL:
+            *p_stage  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+            *p_access = is_source ? VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+                                  : VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+            // presentation is ordered by semaphores. Coming back from it, the acquire semaphore is waited at
+            // COLOR_ATTACHMENT_OUTPUT, so the transition has to start from that stage to chain to the wait.
+            *p_stage  = is_source ? VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_2_NONE;
+            *p_access = VK_ACCESS_2_NONE;
+            break;
+        default:
+            VERIFY(false, "unsupported layout %d\n", (int)layout);
+    }
+}
+
+void vk_Barrier_AddMemory(Vk_BarrierBatch* p_batch, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access) {
+    VERIFY(p_batch, "NULL pointer");
+    if (!p_batch->has_memory_barrier) {
+        p_batch->memory_barrier = (VkMemoryBarrier2){ .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+        p_batch->has_memory_barrier = true;
+    }
+    p_batch->memory_barrier.srcStageMask  |= src_stage;
+    p_batch->memory_barrier.srcAccessMask |= src_access;
+    p_batch->memory_barrier.dstStageMask  |= dst_stage;
+    p_batch->memory_barrier.dstAccessMask |= dst_access;
+}
+
+void vk_Barrier_AddBuffer(Vk_BarrierBatch* p_batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access) {
+    VERIFY(p_batch, "NULL pointer");
+    VERIFY(buffer != VK_NULL_HANDLE, "buffer is VK_NULL_HANDLE");
+    VERIFY(p_batch->buffer_barriers_count < VK_BARRIER_BATCH_MAX_BUFFER_BARRIERS, "too many buffer barriers in one batch");
+
+    p_batch->buffer_barriers[p_batch->buffer_barriers_count++] = (VkBufferMemoryBarrier2){
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .srcStageMask = src_stage,
+        .srcAccessMask = src_access,
+        .dstStageMask = dst_stage,
+        .dstAccessMask = dst_access,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+    };
+}
+
+void vk_Barrier_AddImage(Vk_BarrierBatch* p_batch, VkImage image, VkImageSubresourceRange range, VkImageLayout old_layout, VkImageLayout new_layout, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access) {
+    VERIFY(p_batch, "NULL pointer");
+    VERIFY(image != VK_NULL_HANDLE, "image is VK_NULL_HANDLE");
+    VERIFY(p_batch->image_barriers_count < VK_BARRIER_BATCH_MAX_IMAGE_BARRIERS, "too many image barriers in one batch");
+
+    p_batch->image_barriers[p_batch->image_barriers_count++] = (VkImageMemoryBarrier2){
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = src_stage,
+        .srcAccessMask = src_access,
+        .dstStageMask = dst_stage,
+        .dstAccessMask = dst_access,
+        .oldLayout = old_layout,
+        .newLayout = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = range,
+    };
+}
+
+// Records everything added since the last flush as one dependency
+void vk_Barrier_Flush(Vk_BarrierBatch* p_batch, VkCommandBuffer command_buffer) {
+    VERIFY(p_batch, "NULL pointer");
+    VERIFY(command_buffer != VK_NULL_HANDLE, "command_buffer is VK_NULL_HANDLE");
+    if (!p_batch->has_memory_barrier && p_batch->image_barriers_count == 0 && p_batch->buffer_barriers_count == 0) {
+        return;
+    }
+
+    VkDependencyInfo dependency_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = p_batch->has_memory_barrier ? 1 : 0,
+        .pMemoryBarriers = &p_batch->memory_barrier,
+        .bufferMemoryBarrierCount = p_batch->buffer_barriers_count,
+        .pBufferMemoryBarriers = p_batch->buffer_barriers,
+        .imageMemoryBarrierCount = p_batch->image_barriers_count,
+        .pImageMemoryBarriers = p_batch->image_barriers,
+    };
+    TRACK(vkCmdPipelineBarrier2(command_buffer, &dependency_info));
+
+    p_batch->has_memory_barrier = false;
+    p_batch->image_barriers_count = 0;
+    p_batch->buffer_barriers_count = 0;
+}
@@ -3,6 +3,9 @@
 #define VK_USE_PLATFORM_XLIB_KHR
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_vulkan.h>
+#include <ctype.h>
+
+#define RECORDER_STATS_INTERVAL 600 // frames between printouts of the recorder stats
 
 void* alloc(void* ptr, size_t size) {
     void* tmp = (ptr == NULL) ? malloc(size) : realloc(ptr, size);
@@ -14,6 +17,7 @@ void* alloc(void* ptr, size_t size) {
 }
 
 
+// a tex_index other than 0 marks a textured instance, vk_StartApp points it at the texture table slot
 const InstanceData all_instances[ALL_INSTANCE_COUNT] = {
     // Instance 0
     {
@@ -79,10 +83,237 @@ VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     return VK_FALSE;
 }
 
-Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
+static bool HasDeviceExtension(VkPhysicalDevice physical_device, const char* p_name) {
+    unsigned int extension_count = 0;
+    TRACK(vkEnumerateDeviceExtensionProperties(physical_device, NULL, &extension_count, NULL));
+    if (extension_count == 0) {
+        return false;
+    }
+    VkExtensionProperties* p_extensions = alloc(NULL, sizeof(VkExtensionProperties) * extension_count);
+    TRACK(vkEnumerateDeviceExtensionProperties(physical_device, NULL, &extension_count, p_extensions));
+    bool found = false;
+    for (unsigned int i = 0; i < extension_count && !found; i++) {
+        found = strcmp(p_extensions[i].extensionName, p_name) == 0;
+    }
+    free(p_extensions);
+    return found;
+}
+
+static const char* DeviceTypeName(VkPhysicalDeviceType type) {
+    switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   return "discrete";
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    return "virtual";
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:            return "cpu";
+        default:                                     return "other";
+    }
+}
+
+// 8-4-4-4-12 lowercase hex, the same form vulkaninfo prints
+static void DeviceUuidString(VkPhysicalDevice physical_device, char p_uuid[VK_UUID_SIZE * 2 + 5]) {
+    VkPhysicalDeviceIDProperties id_props = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+    VkPhysicalDeviceProperties2 props2 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &id_props };
+    TRACK(vkGetPhysicalDeviceProperties2(physical_device, &props2));
+    char* p_out = p_uuid;
+    for (unsigned int i = 0; i < VK_UUID_SIZE; i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            *p_out++ = '-';
+        }
+        p_out += sprintf(p_out, "%02x", id_props.deviceUUID[i]);
+    }
+    *p_out = '\0';
+}
+
+// LOGOS_DEVICE matches a case insensitive substring of the device name, or the full UUID with or without dashes
+static bool MatchesDeviceOverride(const char* p_override, const char* p_name, const char* p_uuid) {
+    char uuid_digits[VK_UUID_SIZE * 2 + 1];
+    size_t digits_count = 0;
+    for (const char* p = p_uuid; *p; p++) {
+        if (*p != '-') {
+            uuid_digits[digits_count++] = *p;
+        }
+    }
+    uuid_digits[digits_count] = '\0';
+    char override_digits[VK_UUID_SIZE * 2 + 1];
+    digits_count = 0;
+    for (const char* p = p_override; *p && digits_count < VK_UUID_SIZE * 2; p++) {
+        if (*p != '-') {
+            override_digits[digits_count++] = (char)tolower((unsigned char)*p);
+        }
+    }
+    override_digits[digits_count] = '\0';
+    if (strcmp(uuid_digits, override_digits) == 0) {
+        return true;
+    }
+
+    size_t override_length = strlen(p_override);
+    for (const char* p = p_name; *p; p++) {
+        size_t i = 0;
+        while (i < override_length && p[i] && tolower((unsigned char)p[i]) == tolower((unsigned char)p_override[i])) {
+            i++;
+        }
+        if (i == override_length) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Everything the texture table uses, see vk_TextureTable_Create
+static bool HasTextureTableFeatures(const VkPhysicalDeviceDescriptorIndexingFeatures* p_features) {
+    return p_features->runtimeDescriptorArray &&
+           p_features->descriptorBindingPartiallyBound &&
+           p_features->descriptorBindingVariableDescriptorCount &&
+           p_features->descriptorBindingSampledImageUpdateAfterBind &&
+           p_features->descriptorBindingUpdateUnusedWhilePending &&
+           p_features->shaderSampledImageArrayNonUniformIndexing;
+}
+
+// Returns -1 when the device cannot run the renderer, p_reason says what is missing or what the score is made of.
+// The device is scored on the version it would run at, the lower of its own and instance_version.
+static long long ScorePhysicalDevice(VkPhysicalDevice physical_device, VkSurfaceKHR surface, unsigned int instance_version, char* p_reason, size_t reason_size) {
+    VkPhysicalDeviceProperties props;
+    TRACK(vkGetPhysicalDeviceProperties(physical_device, &props));
+    unsigned int api_version = props.apiVersion < instance_version ? props.apiVersion : instance_version;
+
+    // hard requirements
+    if (api_version < VK_API_VERSION_1_3 && !HasDeviceExtension(physical_device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+        snprintf(p_reason, reason_size, "no dynamic rendering");
+        return -1;
+    }
+    if (!HasDeviceExtension(physical_device, VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+        snprintf(p_reason, reason_size, "no %s", VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        return -1;
+    }
+    if (api_version < VK_API_VERSION_1_2) {
+        snprintf(p_reason, reason_size, "no Vulkan 1.2 for descriptor indexing");
+        return -1;
+    }
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+    VkPhysicalDeviceSynchronization2Features sync2 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES, .pNext = &descriptor_indexing };
+    VkPhysicalDeviceFeatures2 features2 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &sync2 };
+    TRACK(vkGetPhysicalDeviceFeatures2(physical_device, &features2));
+    if (!sync2.synchronization2) {
+        snprintf(p_reason, reason_size, "no synchronization2");
+        return -1;
+    }
+    // every texture is sampled through the bindless texture table
+    if (!HasTextureTableFeatures(&descriptor_indexing)) {
+        snprintf(p_reason, reason_size, "no descriptor indexing for the texture table");
+        return -1;
+    }
+    if (!features2.features.samplerAnisotropy) {
+        snprintf(p_reason, reason_size, "no samplerAnisotropy");
+        return -1;
+    }
+
+    unsigned int queue_family_count = 0;
+    TRACK(vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, NULL));
+    if (queue_family_count == 0) {
+        snprintf(p_reason, reason_size, "no queue families");
+        return -1;
+    }
+    VkQueueFamilyProperties* queue_families = alloc(NULL, sizeof(VkQueueFamilyProperties) * queue_family_count);
+    TRACK(vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families));
+    bool has_graphics = false, has_present = false, graphics_presents = false;
+    bool has_dedicated_compute = false, has_dedicated_transfer = false;
+    for (unsigned int i = 0; i < queue_family_count; i++) {
+        VkQueueFlags flags = queue_families[i].queueFlags;
+        VkBool32 present_support = VK_FALSE;
+        TRACK(vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &present_support));
+        has_graphics |= (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        has_present |= present_support == VK_TRUE;
+        graphics_presents |= (flags & VK_QUEUE_GRAPHICS_BIT) && present_support;
+        has_dedicated_compute |= (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT);
+        has_dedicated_transfer |= (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+    }
+    free(queue_families);
+    if (!has_graphics || !has_present) {
+        snprintf(p_reason, reason_size, "no %s queue", has_graphics ? "present" : "graphics");
+        return -1;
+    }
+
+    // preferences, the device type dominates and the rest breaks ties between similar devices
+    long long score = 0;
+    switch (props.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   score += 100000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 50000;  break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    score += 20000;  break;
+        default:                                     break;
+    }
+
+    VkPhysicalDeviceMemoryProperties memory_props;
+    TRACK(vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_props));
+    VkDeviceSize device_local_size = 0;
+    for (unsigned int i = 0; i < memory_props.memoryHeapCount; i++) {
+        if ((memory_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && memory_props.memoryHeaps[i].size > device_local_size) {
+            device_local_size = memory_props.memoryHeaps[i].size;
+        }
+    }
+    // one point per 64 MiB of the largest device local heap, capped so VRAM cannot outweigh the device type
+    long long vram_mib = (long long)(device_local_size >> 20);
+    score += vram_mib / 64 < 1000 ? vram_mib / 64 : 1000;
+
+    if (graphics_presents)      score += 500;
+    if (has_dedicated_compute)  score += 300;
+    if (has_dedicated_transfer) score += 200;
+    if (features2.features.multiDrawIndirect) score += 100;
+    if (api_version >= VK_API_VERSION_1_3) score += 100;
+
+    snprintf(p_reason, reason_size, "%s, Vulkan %u.%u, %lld MiB VRAM%s%s%s",
+             DeviceTypeName(props.deviceType),
+             VK_VERSION_MAJOR(api_version), VK_VERSION_MINOR(api_version),
+             vram_mib,
+             graphics_presents ? "" : ", separate present queue",
+             has_dedicated_compute ? ", async compute" : "",
+             has_dedicated_transfer ? ", dedicated transfer" : "");
+    return score;
+}
+
+// Zeroed context, the vk_Create_* stages fill it in
+Vk vk_Initialize() {
     Vk vk;
     memset(&vk, 0, sizeof(Vk));
+    vk.frame_index = 1;
+    return vk;
+}
 
+// Nothing to do in builds without shaderc, they only load prebuilt SPIR-V
+void vk_Create_Shaderc(Vk* p_vk) {
+    VERIFY(p_vk, "NULL pointer");
+
+#ifndef VK_NO_SHADERC
+    // the options that change the SPIR-V, each set once and hashed for the cache keys
+    shaderc_optimization_level  optimization_level  = shaderc_optimization_level_zero;
+    shaderc_target_env          target_env          = shaderc_target_env_vulkan;
+    shaderc_env_version         target_env_version  = shaderc_env_version_vulkan_1_3;
+    // shaderc
+    {
+        p_vk->shaderc_compiler = shaderc_compiler_initialize();
+        VERIFY(p_vk->shaderc_compiler, "failed to initialize\n ");
+        debug(p_vk->shaderc_options = shaderc_compile_options_initialize());
+        VERIFY(p_vk->shaderc_options, "failed to initialize\n ");
+        debug(shaderc_compile_options_set_optimization_level(p_vk->shaderc_options, optimization_level));
+        debug(shaderc_compile_options_set_target_env(p_vk->shaderc_options, target_env, target_env_version));
+        debug(shaderc_compile_options_set_include_callbacks(p_vk->shaderc_options, vk_ShaderInclude_Resolve, vk_ShaderInclude_Release, NULL));
+    }
+    // spvCache, keys change with the options above and with the compiler version
+    {
+        unsigned int spv_version, spv_revision;
+        shaderc_get_spv_version(&spv_version, &spv_revision);
+        unsigned int options[] = { optimization_level, target_env, target_env_version, spv_version, spv_revision };
+        p_vk->shaderc_options_hash = vk_Hash_Fnv1a64(VK_FNV1A64_INIT, options, sizeof(options));
+
+        const char* p_env = getenv("LOGOS_SHADER_CACHE");
+        if ((p_env && strcmp(p_env, "0") == 0) || !vk_DiskCache_Directory("spirv", p_vk->spv_cache_dir, sizeof(p_vk->spv_cache_dir))) {
+            p_vk->spv_cache_dir[0] = '\0';
+        }
+    }
+#endif
+}
+
+void vk_Create_Instance(Vk* p_vk, unsigned int width, unsigned int height, const char* title) {
+    VERIFY(p_vk, "NULL pointer");
     VkResult result;
 
     // Query the highest supported Vulkan version by the loader
@@ -106,20 +337,11 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
         desired_version = loader_version;
     }
 
-    // shaderc
-    {
-        vk.shaderc_compiler = shaderc_compiler_initialize();
-        VERIFY(vk.shaderc_compiler, "failed to initialize\n ");
-        debug(vk.shaderc_options = shaderc_compile_options_initialize());
-        VERIFY(vk.shaderc_options, "failed to initialize\n ");
-        debug(shaderc_compile_options_set_optimization_level(vk.shaderc_options, shaderc_optimization_level_zero));
-        debug(shaderc_compile_options_set_target_env(vk.shaderc_options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3));
-    }
     // createWindow
     {
         VERIFY(SDL_Init(SDL_INIT_VIDEO) == 0, "failed to initialize\n ");
-        debug(vk.window_p = SDL_CreateWindow( title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_VULKAN | SDL_WINDOW_SHOWN ));
-        VERIFY(vk.window_p, "failed to create\n ");
+        debug(p_vk->window_p = SDL_CreateWindow( title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_VULKAN | SDL_WINDOW_SHOWN ));
+        VERIFY(p_vk->window_p, "failed to create\n ");
     }
     // createVulkanInstance
     {
@@ -129,12 +351,12 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
         const char* validationLayers[] = { "VK_LAYER_KHRONOS_validation" };
 
         unsigned int sdlExtensionCount = 0;
-        VERIFY(SDL_Vulkan_GetInstanceExtensions((SDL_Window*)vk.window_p, &sdlExtensionCount, NULL), "%s\n ", SDL_GetError());
+        VERIFY(SDL_Vulkan_GetInstanceExtensions((SDL_Window*)p_vk->window_p, &sdlExtensionCount, NULL), "%s\n ", SDL_GetError());
 
         const char** sdlExtensions = (const char**)alloc(NULL, sizeof(const char*) * sdlExtensionCount);
         VERIFY(sdlExtensions, "failed to allocate memory\n ");
 
-        VERIFY(SDL_Vulkan_GetInstanceExtensions((SDL_Window*)vk.window_p, &sdlExtensionCount, sdlExtensions), "%s\n ", SDL_GetError());
+        VERIFY(SDL_Vulkan_GetInstanceExtensions((SDL_Window*)p_vk->window_p, &sdlExtensionCount, sdlExtensions), "%s\n ", SDL_GetError());
         // Add debug utils extension
         totalExtensionCount = sdlExtensionCount + 1;
         allExtensions = (const char**)alloc(NULL, sizeof(const char*) * totalExtensionCount);
@@ -173,7 +395,7 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
             }
         };
 
-        TRACK(result = vkCreateInstance(&instanceCreateInfo, NULL, &vk.instance));
+        TRACK(result = vkCreateInstance(&instanceCreateInfo, NULL, &p_vk->instance));
         free(sdlExtensions);
         free(allExtensions);
         VERIFY(result==VK_SUCCESS, "failed to create VkInstance\n ");
@@ -181,7 +403,7 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
     // setupDebugMessenger
     {
         PFN_vkCreateDebugUtilsMessengerEXT funcCreateDebugUtilsMessengerEXT =
-            (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(vk.instance, "vkCreateDebugUtilsMessengerEXT");
+            (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(p_vk->instance, "vkCreateDebugUtilsMessengerEXT");
         if (funcCreateDebugUtilsMessengerEXT != NULL) {
             VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo = {
                 .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
@@ -195,35 +417,82 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
                 .pUserData = NULL
             };
 
-            vk.debug_messenger = VK_NULL_HANDLE;
-            VERIFY(funcCreateDebugUtilsMessengerEXT(vk.instance, &debugCreateInfo, NULL, &vk.debug_messenger) == VK_SUCCESS, "Failed to set up debug messenger\n ");
+            p_vk->debug_messenger = VK_NULL_HANDLE;
+            VERIFY(funcCreateDebugUtilsMessengerEXT(p_vk->instance, &debugCreateInfo, NULL, &p_vk->debug_messenger) == VK_SUCCESS, "Failed to set up debug messenger\n ");
         } else {
             printf("vkCreateDebugUtilsMessengerEXT not available\n");
-            vk.debug_messenger = VK_NULL_HANDLE;
+            p_vk->debug_messenger = VK_NULL_HANDLE;
         }
     }
     // createSurface
     {
-        vk.surface = VK_NULL_HANDLE;
-        VERIFY(SDL_Vulkan_CreateSurface((SDL_Window*)vk.window_p, vk.instance, &vk.surface), "%s\n", SDL_GetError());
+        p_vk->surface = VK_NULL_HANDLE;
+        VERIFY(SDL_Vulkan_CreateSurface((SDL_Window*)p_vk->window_p, p_vk->instance, &p_vk->surface), "%s\n", SDL_GetError());
     }
+    // lowered to what the device supports in vk_Create_Device
+    p_vk->caps.api_version = desired_version;
+}
+
+// Needs the instance and surface
+void vk_Create_Device(Vk* p_vk) {
+    VERIFY(p_vk, "NULL pointer");
+    VkResult result;
+
     // getPhysicalDevice
     {
         unsigned int device_count = 0;
-        result = vkEnumeratePhysicalDevices(vk.instance, &device_count, NULL);
+        result = vkEnumeratePhysicalDevices(p_vk->instance, &device_count, NULL);
         VERIFY(!(result != VK_SUCCESS || device_count == 0), "Failed to find GPUs with Vulkan support\n");
 
         VkPhysicalDevice* devices = alloc(NULL, sizeof(VkPhysicalDevice) * device_count);
         VERIFY(devices, "Failed to allocate memory for physical devices\n");
-        VERIFY(vkEnumeratePhysicalDevices(vk.instance, &device_count, devices)==VK_SUCCESS, "Failed to enumerate physical devices\n");
+        VERIFY(vkEnumeratePhysicalDevices(p_vk->instance, &device_count, devices)==VK_SUCCESS, "Failed to enumerate physical devices\n");
 
-        // For simplicity, choose the first device
-        vk.physical_device = devices[0];
+        // Score every device and take the best one, LOGOS_DEVICE picks one by name or UUID instead
+        const char* p_override = getenv("LOGOS_DEVICE");
+        if (p_override && p_override[0] == '\0') {
+            p_override = NULL;
+        }
+        long long best_score = -1;
+        bool best_overridden = false;
+        char best_reason[256] = "";
+        for (unsigned int i = 0; i < device_count; i++) {
+            VkPhysicalDeviceProperties props;
+            TRACK(vkGetPhysicalDeviceProperties(devices[i], &props));
+            char uuid[VK_UUID_SIZE * 2 + 5];
+            DeviceUuidString(devices[i], uuid);
+            char reason[256];
+            long long score = ScorePhysicalDevice(devices[i], p_vk->surface, p_vk->caps.api_version, reason, sizeof(reason));
+            bool overridden = p_override && MatchesDeviceOverride(p_override, props.deviceName, uuid);
+            if (score < 0) {
+                printf("  GPU %u: %s [%s] unusable: %s\n", i, props.deviceName, uuid, reason);
+                VERIFY(!overridden, "LOGOS_DEVICE=%s selects %s, which is unusable: %s\n", p_override, props.deviceName, reason);
+                continue;
+            }
+            printf("  GPU %u: %s [%s] score %lld (%s)%s\n", i, props.deviceName, uuid, score, reason, overridden ? " matches LOGOS_DEVICE" : "");
+            // an override match beats any score, among several matches the highest score wins
+            if ((overridden && !best_overridden) || (overridden == best_overridden && score > best_score)) {
+                p_vk->physical_device = devices[i];
+                best_score = score;
+                best_overridden = overridden;
+                memcpy(best_reason, reason, sizeof(best_reason));
+            }
+        }
         free(devices);
+        VERIFY(p_vk->physical_device != VK_NULL_HANDLE, "No GPU can run the renderer\n");
+        if (p_override && !best_overridden) {
+            printf("Warning: LOGOS_DEVICE=%s matches no GPU, falling back to the highest score\n", p_override);
+        }
+        {
+            VkPhysicalDeviceProperties props;
+            TRACK(vkGetPhysicalDeviceProperties(p_vk->physical_device, &props));
+            printf("Selected GPU %s: %s, score %lld (%s)\n", props.deviceName,
+                   best_overridden ? "forced by LOGOS_DEVICE" : "highest score", best_score, best_reason);
+        }
 
         // Check device properties to see if Vulkan 1.3 is supported
         VkPhysicalDeviceProperties deviceProps;
-        vkGetPhysicalDeviceProperties(vk.physical_device, &deviceProps);
+        vkGetPhysicalDeviceProperties(p_vk->physical_device, &deviceProps);
         unsigned int device_api_version = deviceProps.apiVersion;
         printf("Device supports Vulkan version: %u.%u.%u\n",
                VK_VERSION_MAJOR(device_api_version),
@@ -241,9 +510,9 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
         bool dynamicRenderingSupported = false;
         if (wants_dynamic_rendering) {
             unsigned int extensionCount = 0;
-            vkEnumerateDeviceExtensionProperties(vk.physical_device, NULL, &extensionCount, NULL);
+            vkEnumerateDeviceExtensionProperties(p_vk->physical_device, NULL, &extensionCount, NULL);
             VkExtensionProperties* extensions = malloc(sizeof(VkExtensionProperties) * extensionCount);
-            vkEnumerateDeviceExtensionProperties(vk.physical_device, NULL, &extensionCount, extensions);
+            vkEnumerateDeviceExtensionProperties(p_vk->physical_device, NULL, &extensionCount, extensions);
 
             for (unsigned int i = 0; i < extensionCount; i++) {
                 if (strcmp(extensions[i].extensionName, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) == 0) {
@@ -257,52 +526,52 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
     }
     // getQueueFamilyIndices
     {
-        vk.queue_family_indices.graphics = UINT32_MAX;
-        vk.queue_family_indices.present = UINT32_MAX;
-        vk.queue_family_indices.compute = UINT32_MAX;
-        vk.queue_family_indices.transfer = UINT32_MAX;
+        p_vk->queue_family_indices.graphics = UINT32_MAX;
+        p_vk->queue_family_indices.present = UINT32_MAX;
+        p_vk->queue_family_indices.compute = UINT32_MAX;
+        p_vk->queue_family_indices.transfer = UINT32_MAX;
 
         unsigned int queue_family_count = 0;
-        vkGetPhysicalDeviceQueueFamilyProperties(vk.physical_device, &queue_family_count, NULL);
+        vkGetPhysicalDeviceQueueFamilyProperties(p_vk->physical_device, &queue_family_count, NULL);
         VERIFY(queue_family_count != 0, "Failed to find any queue families\n");
 
         VkQueueFamilyProperties* queue_families = alloc(NULL, sizeof(VkQueueFamilyProperties) * queue_family_count);
         VERIFY(queue_families, "Failed to allocate memory for queue family properties\n");
 
-        vkGetPhysicalDeviceQueueFamilyProperties(vk.physical_device, &queue_family_count, queue_families);
+        vkGetPhysicalDeviceQueueFamilyProperties(p_vk->physical_device, &queue_family_count, queue_families);
 
         for (unsigned int i = 0; i < queue_family_count; i++) {
             // Check for graphics support
-            if ((queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && vk.queue_family_indices.graphics == UINT32_MAX) {
-                vk.queue_family_indices.graphics = i;
+            if ((queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && p_vk->queue_family_indices.graphics == UINT32_MAX) {
+                p_vk->queue_family_indices.graphics = i;
             }
 
             // Check for compute support (prefer dedicated compute queues)
             if ((queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && 
                 !(queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && 
-                vk.queue_family_indices.compute == UINT32_MAX) {
-                vk.queue_family_indices.compute = i;
+                p_vk->queue_family_indices.compute == UINT32_MAX) {
+                p_vk->queue_family_indices.compute = i;
             }
 
             // Check for transfer support (prefer dedicated transfer queues)
             if ((queue_families[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && 
                 !(queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && 
-                vk.queue_family_indices.transfer == UINT32_MAX) {
-                vk.queue_family_indices.transfer = i;
+                p_vk->queue_family_indices.transfer == UINT32_MAX) {
+                p_vk->queue_family_indices.transfer = i;
             }
 
             // Check for presentation support
             VkBool32 present_support = VK_FALSE;
-            vkGetPhysicalDeviceSurfaceSupportKHR(vk.physical_device, i, vk.surface, &present_support);
-            if (present_support && vk.queue_family_indices.present == UINT32_MAX) {
-                vk.queue_family_indices.present = i;
+            vkGetPhysicalDeviceSurfaceSupportKHR(p_vk->physical_device, i, p_vk->surface, &present_support);
+            if (present_support && p_vk->queue_family_indices.present == UINT32_MAX) {
+                p_vk->queue_family_indices.present = i;
             }
 
             // Break early if all family_indices are found
-            if (vk.queue_family_indices.graphics != UINT32_MAX &&
-                vk.queue_family_indices.present != UINT32_MAX &&
-                vk.queue_family_indices.compute != UINT32_MAX &&
-                vk.queue_family_indices.transfer != UINT32_MAX) {
+            if (p_vk->queue_family_indices.graphics != UINT32_MAX &&
+                p_vk->queue_family_indices.present != UINT32_MAX &&
+                p_vk->queue_family_indices.compute != UINT32_MAX &&
+                p_vk->queue_family_indices.transfer != UINT32_MAX) {
                 break;
             }
         }
@@ -310,12 +579,21 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
         free(queue_families);
 
         // Validate that essential queue family_indices are found
-        VERIFY(!(vk.queue_family_indices.graphics == UINT32_MAX || vk.queue_family_indices.present == UINT32_MAX), "Failed to find required queue families\n");
+        VERIFY(!(p_vk->queue_family_indices.graphics == UINT32_MAX || p_vk->queue_family_indices.present == UINT32_MAX), "Failed to find required queue families\n");
+
+        // Without a dedicated family compute runs on the graphics queue, and transfer on the compute one,
+        // both support transfers
+        if (p_vk->queue_family_indices.compute == UINT32_MAX) {
+            p_vk->queue_family_indices.compute = p_vk->queue_family_indices.graphics;
+        }
+        if (p_vk->queue_family_indices.transfer == UINT32_MAX) {
+            p_vk->queue_family_indices.transfer = p_vk->queue_family_indices.compute;
+        }
     }
     // check for driver compatibility
     {
         VkPhysicalDeviceFeatures deviceFeatures;
-        vkGetPhysicalDeviceFeatures(vk.physical_device, &deviceFeatures);
+        vkGetPhysicalDeviceFeatures(p_vk->physical_device, &deviceFeatures);
 
         if (!deviceFeatures.samplerAnisotropy) {
             printf("samplerAnisotropy is not supported\n");
@@ -325,10 +603,73 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
     }
     // getDevice
     {
-        // Check again if we need dynamic rendering
         VkPhysicalDeviceProperties deviceProps;
-        vkGetPhysicalDeviceProperties(vk.physical_device, &deviceProps);
-        bool use_dynamic_rendering_extension = (deviceProps.apiVersion < VK_API_VERSION_1_3);
+        vkGetPhysicalDeviceProperties(p_vk->physical_device, &deviceProps);
+        p_vk->caps.api_version = deviceProps.apiVersion < p_vk->caps.api_version ? deviceProps.apiVersion : p_vk->caps.api_version;
+        bool core_1_2 = p_vk->caps.api_version >= VK_API_VERSION_1_2;
+        bool core_1_3 = p_vk->caps.api_version >= VK_API_VERSION_1_3;
+
+        const char* device_extensions[8];
+        unsigned int device_extensions_count = 0;
+        device_extensions[device_extensions_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+
+        // Capability negotiation: a feature struct is only chained when its core version or extension is there,
+        // and then every queried bit is enabled as is
+        void* p_chain = NULL;
+        #define CHAIN_FEATURES(features) do { (features).pNext = p_chain; p_chain = &(features); } while (0)
+        #define USE_EXTENSION(name) (HasDeviceExtension(p_vk->physical_device, name) ? (device_extensions[device_extensions_count++] = name, true) : false)
+
+        VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES };
+        VkPhysicalDeviceSynchronization2Features sync2 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES };
+        VkPhysicalDevicePipelineCreationCacheControlFeatures cache_control = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES };
+        VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extended_dynamic_state = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT };
+        VkPhysicalDeviceTimelineSemaphoreFeatures timeline = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES };
+        VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+        VkPhysicalDeviceBufferDeviceAddressFeatures buffer_device_address = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES };
+
+        // dynamic rendering and synchronization2 are required, the device scoring already rejected devices without them
+        if (core_1_3 || USE_EXTENSION(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) CHAIN_FEATURES(dynamic_rendering);
+        if (core_1_3 || USE_EXTENSION(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) CHAIN_FEATURES(sync2);
+        if (core_1_3 || USE_EXTENSION(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME)) CHAIN_FEATURES(cache_control);
+        // core in 1.3 without a feature bit, the EXT struct is only valid with the extension enabled
+        if (!core_1_3 && USE_EXTENSION(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) CHAIN_FEATURES(extended_dynamic_state);
+        // the 1.2 promotions pull in further extensions of their own when used before 1.2, so they are only taken from core
+        if (core_1_2) {
+            CHAIN_FEATURES(timeline);
+            CHAIN_FEATURES(descriptor_indexing);
+            CHAIN_FEATURES(buffer_device_address);
+        }
+        p_vk->caps.memory_budget = USE_EXTENSION(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+        #undef USE_EXTENSION
+        #undef CHAIN_FEATURES
+
+        VkPhysicalDeviceFeatures2 supported_features = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = p_chain };
+        TRACK(vkGetPhysicalDeviceFeatures2(p_vk->physical_device, &supported_features));
+        VERIFY(dynamic_rendering.dynamicRendering, "Dynamic Rendering not supported on this device.\n");
+        VERIFY(sync2.synchronization2, "synchronization2 is not supported\n");
+
+        // capture replay and multi device addresses are debugging and SLI features we never use
+        buffer_device_address.bufferDeviceAddressCaptureReplay = VK_FALSE;
+        buffer_device_address.bufferDeviceAddressMultiDevice = VK_FALSE;
+
+        p_vk->caps.synchronization2 = true;
+        p_vk->caps.timeline_semaphore = timeline.timelineSemaphore;
+        p_vk->caps.descriptor_indexing = HasTextureTableFeatures(&descriptor_indexing);
+        VERIFY(p_vk->caps.descriptor_indexing, "descriptor indexing is not supported\n");
+        p_vk->caps.buffer_device_address = buffer_device_address.bufferDeviceAddress;
+        p_vk->caps.extended_dynamic_state = core_1_3 || extended_dynamic_state.extendedDynamicState;
+        p_vk->caps.pipeline_creation_cache_control = cache_control.pipelineCreationCacheControl;
+        // several VkDrawIndirectCommand with a non zero firstInstance in one call needs both features
+        p_vk->caps.multi_draw_indirect = supported_features.features.multiDrawIndirect && supported_features.features.drawIndirectFirstInstance;
+        p_vk->caps.max_draw_indirect_count = p_vk->caps.multi_draw_indirect ? deviceProps.limits.maxDrawIndirectCount : 1;
+
+        printf("Device capabilities: Vulkan %u.%u, timeline semaphore %d, synchronization2 %d, descriptor indexing %d, "
+               "buffer device address %d, extended dynamic state %d, memory budget %d, pipeline cache control %d, multi draw indirect %d\n",
+               VK_VERSION_MAJOR(p_vk->caps.api_version), VK_VERSION_MINOR(p_vk->caps.api_version),
+               p_vk->caps.timeline_semaphore, p_vk->caps.synchronization2, p_vk->caps.descriptor_indexing,
+               p_vk->caps.buffer_device_address, p_vk->caps.extended_dynamic_state, p_vk->caps.memory_budget,
+               p_vk->caps.pipeline_creation_cache_control, p_vk->caps.multi_draw_indirect);
 
         // Define queue priorities
         float queue_priority = 1.0f;
@@ -350,10 +691,10 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
                 } \
             } while(0)
 
-        ADD_UNIQUE_FAMILY(vk.queue_family_indices.graphics);
-        ADD_UNIQUE_FAMILY(vk.queue_family_indices.present);
-        ADD_UNIQUE_FAMILY(vk.queue_family_indices.compute);
-        ADD_UNIQUE_FAMILY(vk.queue_family_indices.transfer);
+        ADD_UNIQUE_FAMILY(p_vk->queue_family_indices.graphics);
+        ADD_UNIQUE_FAMILY(p_vk->queue_family_indices.present);
+        ADD_UNIQUE_FAMILY(p_vk->queue_family_indices.compute);
+        ADD_UNIQUE_FAMILY(p_vk->queue_family_indices.transfer);
 
         #undef ADD_UNIQUE_FAMILY
 
@@ -369,25 +710,21 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
 
         VkDeviceCreateInfo device_create_info = {
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            .pNext = &(VkPhysicalDeviceDynamicRenderingFeatures) {
-                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
-                .dynamicRendering = VK_TRUE,
-            },
+            .pNext = p_chain,
             .pQueueCreateInfos = queue_create_infos,
             .queueCreateInfoCount = unique_count,
             .pEnabledFeatures = &(VkPhysicalDeviceFeatures){
                 .samplerAnisotropy = VK_TRUE,
+                .multiDrawIndirect = supported_features.features.multiDrawIndirect,
+                .drawIndirectFirstInstance = supported_features.features.drawIndirectFirstInstance,
             },
-            .enabledExtensionCount = use_dynamic_rendering_extension ? 2 : 1,
-            .ppEnabledExtensionNames = &(const char*) {
-                VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-                VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME
-            },
+            .enabledExtensionCount = device_extensions_count,
+            .ppEnabledExtensionNames = device_extensions,
             .enabledLayerCount = 0,
             .ppEnabledLayerNames = NULL,
         };
 
-        TRACK(result = vkCreateDevice(vk.physical_device, &device_create_info, NULL, &vk.device));
+        TRACK(result = vkCreateDevice(p_vk->physical_device, &device_create_info, NULL, &p_vk->device));
         VERIFY(result == VK_SUCCESS, "Failed to create logical vk.device. Error code: %d\n", result);
         printf("Logical vk.device created successfully.\n");
         free(queue_create_infos);
@@ -395,47 +732,41 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
     // initializeVmaAllocator
     {
         VmaAllocatorCreateInfo allocatorInfo = {};
-        allocatorInfo.physicalDevice = vk.physical_device;
-        allocatorInfo.device = vk.device;
-        allocatorInfo.instance = vk.instance;
+        allocatorInfo.physicalDevice = p_vk->physical_device;
+        allocatorInfo.device = p_vk->device;
+        allocatorInfo.instance = p_vk->instance;
+        allocatorInfo.vulkanApiVersion = p_vk->caps.api_version;
+        if (p_vk->caps.memory_budget) {
+            allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+        }
+        if (p_vk->caps.buffer_device_address) {
+            allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+        }
 
-        TRACK(VkResult result = vmaCreateAllocator(&allocatorInfo, &vk.allocator));
+        TRACK(VkResult result = vmaCreateAllocator(&allocatorInfo, &p_vk->allocator));
         VERIFY(result == VK_SUCCESS, "Failed to create VMA allocator\n");
     }
     // getQueues
     {
-        vk.queues.graphics = VK_NULL_HANDLE;
-        vk.queues.present = VK_NULL_HANDLE;
-        vk.queues.compute = VK_NULL_HANDLE;
-        vk.queues.transfer = VK_NULL_HANDLE;
-
-        vkGetDeviceQueue(vk.device, vk.queue_family_indices.graphics, 0, &vk.queues.graphics);
+        // Every family was created with one queue, so families that coincide get the same handle and each
+        // handle always belongs to the family its index names
+        vkGetDeviceQueue(p_vk->device, p_vk->queue_family_indices.graphics, 0, &p_vk->queues.graphics);
+        vkGetDeviceQueue(p_vk->device, p_vk->queue_family_indices.present, 0, &p_vk->queues.present);
+        vkGetDeviceQueue(p_vk->device, p_vk->queue_family_indices.compute, 0, &p_vk->queues.compute);
+        vkGetDeviceQueue(p_vk->device, p_vk->queue_family_indices.transfer, 0, &p_vk->queues.transfer);
+    }
+    // createPipelineCache
+    TRACK(vk_PipelineCache_Create(p_vk));
+}
 
-        if (vk.queue_family_indices.graphics != vk.queue_family_indices.present) {
-            vkGetDeviceQueue(vk.device, vk.queue_family_indices.present, 0, &vk.queues.present);
-        } else {
-            vk.queues.present = vk.queues.graphics;
-        }
+// Needs the device
+void vk_Create_Swapchain(Vk* p_vk, unsigned int width, unsigned int height) {
+    VERIFY(p_vk, "NULL pointer");
 
-        if (vk.queue_family_indices.compute != vk.queue_family_indices.graphics &&
-            vk.queue_family_indices.compute != vk.queue_family_indices.present) {
-            vkGetDeviceQueue(vk.device, vk.queue_family_indices.compute, 0, &vk.queues.compute);
-        } else {
-            vk.queues.compute = vk.queues.graphics;
-        }
-
-        if (vk.queue_family_indices.transfer != vk.queue_family_indices.graphics && 
-            vk.queue_family_indices.transfer != vk.queue_family_indices.present && 
-            vk.queue_family_indices.transfer != vk.queue_family_indices.compute) {
-            vkGetDeviceQueue(vk.device, vk.queue_family_indices.transfer, 0, &vk.queues.transfer);
-        } else {
-            vk.queues.transfer = vk.queues.graphics;
-        }
-    }
     // createSwapChain
     {
         VkSurfaceCapabilitiesKHR surfaceCapabilities;
-        TRACK(VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vk.physical_device, vk.surface, &surfaceCapabilities));
+        TRACK(VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(p_vk->physical_device, p_vk->surface, &surfaceCapabilities));
         VERIFY(result == VK_SUCCESS, "Failed to get vk.surface capabilities\n");
 
         VkExtent2D extent = surfaceCapabilities.currentExtent.width != UINT32_MAX ?
@@ -443,11 +774,11 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
                                   (VkExtent2D){width, height};
 
         unsigned int format_count;
-        vkGetPhysicalDeviceSurfaceFormatsKHR(vk.physical_device, vk.surface, &format_count, NULL);
+        vkGetPhysicalDeviceSurfaceFormatsKHR(p_vk->physical_device, p_vk->surface, &format_count, NULL);
         VERIFY(format_count > 0, "Failed to find vk.surface formats\n");
         TRACK(VkSurfaceFormatKHR* formats = alloc(NULL, sizeof(VkSurfaceFormatKHR) * format_count));
         VERIFY(formats, "Failed to allocate memory for vk.surface formats\n");
-        TRACK(vkGetPhysicalDeviceSurfaceFormatsKHR(vk.physical_device, vk.surface, &format_count, formats));
+        TRACK(vkGetPhysicalDeviceSurfaceFormatsKHR(p_vk->physical_device, p_vk->surface, &format_count, formats));
 
         // Choose a suitable format (prefer R8G8B8A8_SRGB then R8G8B8A8_UNORM)
         VkSurfaceFormatKHR chosenFormat = formats[0]; // Default to first format if none of the preferred are available
@@ -472,10 +803,10 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
             minImageCount = surfaceCapabilities.maxImageCount;
         }
 
-        VkQueueFamilyIndices i = vk.queue_family_indices;
+        VkQueueFamilyIndices i = p_vk->queue_family_indices;
         VkSwapchainCreateInfoKHR swapchainCreateInfo = {
             .sType           = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-            .surface         = vk.surface,
+            .surface         = p_vk->surface,
             .minImageCount   = minImageCount,
             .imageFormat     = chosenFormat.format,
             .imageColorSpace = chosenFormat.colorSpace,
@@ -492,40 +823,43 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
             .oldSwapchain   = VK_NULL_HANDLE
         };
 
-        TRACK(result = vkCreateSwapchainKHR(vk.device, &swapchainCreateInfo, NULL, &vk.swap_chain));
+        TRACK(result = vkCreateSwapchainKHR(p_vk->device, &swapchainCreateInfo, NULL, &p_vk->swap_chain));
         VERIFY(result == VK_SUCCESS, "Failed to create swapchain\n");
 
-        vk.images_count = 0;
-        TRACK(vkGetSwapchainImagesKHR(vk.device, vk.swap_chain, &vk.images_count, NULL));
-        VERIFY(vk.images_count > 0, "there is 0 images in swapchain");
+        p_vk->images_count = 0;
+        TRACK(vkGetSwapchainImagesKHR(p_vk->device, p_vk->swap_chain, &p_vk->images_count, NULL));
+        VERIFY(p_vk->images_count > 0, "there is 0 images in swapchain");
         if (surfaceCapabilities.maxImageCount > 0) {
-            VERIFY(vk.images_count <= surfaceCapabilities.maxImageCount, "there is more than expected images in swapchain. images_count = %d. maxImageCount = %d", vk.images_count, surfaceCapabilities.maxImageCount);
+            VERIFY(p_vk->images_count <= surfaceCapabilities.maxImageCount, "there is more than expected images in swapchain. images_count = %d. maxImageCount = %d", p_vk->images_count, surfaceCapabilities.maxImageCount);
         } else {
             printf("Note: maxImageCount is 0, indicating no upper limit on image count.\n");
         }
 
-        TRACK(vk.p_images = alloc(vk.p_images, sizeof(Image) * vk.images_count));
-        VERIFY(vk.p_images, "Failed to allocate memory for swapchain images\n");
+        TRACK(p_vk->p_images = alloc(p_vk->p_images, sizeof(Image) * p_vk->images_count));
+        VERIFY(p_vk->p_images, "Failed to allocate memory for swapchain images\n");
 
-        VkImage* p_tmp_images = (VkImage*)alloc(NULL, sizeof(VkImage) * vk.images_count);
+        VkImage* p_tmp_images = (VkImage*)alloc(NULL, sizeof(VkImage) * p_vk->images_count);
         VERIFY(p_tmp_images, "Failed to allocate memory for temporary image array\n");
-        TRACK(vkGetSwapchainImagesKHR(vk.device, vk.swap_chain, &vk.images_count, p_tmp_images));
-
-        for (unsigned int i = 0; i < vk.images_count; i++) {
-            vk.p_images[i].image = p_tmp_images[i];
-            vk.p_images[i].extent = extent;
-            vk.p_images[i].format = format;
-            vk.p_images[i].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        TRACK(vkGetSwapchainImagesKHR(p_vk->device, p_vk->swap_chain, &p_vk->images_count, p_tmp_images));
+
+        for (unsigned int i = 0; i < p_vk->images_count; i++) {
+            p_vk->p_images[i].image = p_tmp_images[i];
+            p_vk->p_images[i].extent = extent;
+            p_vk->p_images[i].format = format;
+            p_vk->p_images[i].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            p_vk->p_images[i].mip_levels = 1;
+            p_vk->p_images[i].array_layers = 1;
+            p_vk->p_images[i].p_states = NULL;
         }
 
         free(p_tmp_images);
 
-        for (unsigned int i = 0; i < vk.images_count; i++) {
+        for (unsigned int i = 0; i < p_vk->images_count; i++) {
             VkImageViewCreateInfo view_info = {
                 .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-                .image = vk.p_images[i].image,
+                .image = p_vk->p_images[i].image,
                 .viewType = VK_IMAGE_VIEW_TYPE_2D,
-                .format = vk.p_images[i].format,
+                .format = p_vk->p_images[i].format,
                 .components = {
                     .r = VK_COMPONENT_SWIZZLE_IDENTITY,
                     .g = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -541,51 +875,41 @@ Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
                 },
             };
 
-            TRACK(result = vkCreateImageView(vk.device, &view_info, NULL, &vk.p_images[i].view));
+            TRACK(result = vkCreateImageView(p_vk->device, &view_info, NULL, &p_vk->p_images[i].view));
             VERIFY(result == VK_SUCCESS, "Failed to create image view %u\n", i);
         }
     }
-    // createDescriptorPool
-    {
-        VkDescriptorPoolCreateInfo pool_info = {
-            .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-            .poolSizeCount = 4,
-            .pPoolSizes    = (VkDescriptorPoolSize[]) {
-                {
-                    .type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                    .descriptorCount = 20,
-                },
-                {
-                    .type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                    .descriptorCount = 100,
-                },
-                {
-                    .type            = VK_DESCRIPTOR_TYPE_SAMPLER,
-                    .descriptorCount = 20,
-                },
-                {
-                    .type            = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-                    .descriptorCount = 20,
-                },
-            },
-            .maxSets       = 40
-        };
+}
 
-        TRACK(result = vkCreateDescriptorPool(vk.device, &pool_info, NULL, &vk.descriptor_pool));
-        VERIFY(result == VK_SUCCESS, "Failed to create descriptor pool\n");
-    }
+// Needs the device
+void vk_Create_Pools(Vk* p_vk) {
+    VERIFY(p_vk, "NULL pointer");
+    VkResult result;
+
+    // descriptor pools are created as sets are allocated, sized from what was allocated before
+    p_vk->descriptor_allocator = vk_DescriptorAllocator_Create(false);
+    TRACK(vk_TextureTable_Create(p_vk));
     // createCommandPool
     {
         VkCommandPoolCreateInfo poolInfo = {
             .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-            .queueFamilyIndex = vk.queue_family_indices.graphics,
+            .queueFamilyIndex = p_vk->queue_family_indices.graphics,
             .flags            = 0
         };
 
-        TRACK(result = vkCreateCommandPool(vk.device, &poolInfo, NULL, &vk.command_pool));
+        TRACK(result = vkCreateCommandPool(p_vk->device, &poolInfo, NULL, &p_vk->command_pool));
         VERIFY(result == VK_SUCCESS, "Failed to create command pool\n");
     }
+}
 
+// All stages one after another, see main.c for running them as a task graph
+Vk vk_Create(unsigned int width, unsigned int height, const char* title) {
+    Vk vk = vk_Initialize();
+    TRACK(vk_Create_Shaderc(&vk));
+    TRACK(vk_Create_Instance(&vk, width, height, title));
+    TRACK(vk_Create_Device(&vk));
+    TRACK(vk_Create_Swapchain(&vk, width, height));
+    TRACK(vk_Create_Pools(&vk));
     return vk;
 }
 
@@ -595,15 +919,33 @@ void vk_StartApp(
     VkSemaphore imageAvailableSemaphore,
     VkSemaphore renderFinishedSemaphore,
     VkFence inFlightFence,
-    VkCommandBuffer* commandBuffers,
-    VkBuffer uniformBuffer,
-    VmaAllocation uniformBufferAllocation,
-    Buffer instance_buffer)
+    Vk_GraphicsPipeline* p_pipeline,
+    VkDescriptorSet* p_desc_sets,
+    const Vk_PushConstants* p_push_constants,
+    Buffer instance_buffer,
+    unsigned int texture_index,
+    Vk_ShaderWatch* p_shader_watch)
 {
     int running = 1;
     SDL_Event event;
 
+    // the image gets whatever slot the texture table had free, the instances cannot assume one
+    InstanceData instances[ALL_INSTANCE_COUNT];
+    memcpy(instances, all_instances, sizeof(instances));
+    for (unsigned int i = 0; i < ALL_INSTANCE_COUNT; ++i) {
+        if (instances[i].tex_index != 0) {
+            instances[i].tex_index = texture_index;
+        }
+    }
+    InstanceDataPacked packed_instances[ALL_INSTANCE_COUNT];
+    TRACK(vk_InstanceData_Pack(instances, packed_instances, ALL_INSTANCE_COUNT));
+
     unsigned int tmp_i = 0;
+
+    // every frame goes to the graphics queue as one vkQueueSubmit2
+    TRACK(Vk_FrameSubmit frame_submit = Vk_FrameSubmit_Create(vk, vk->queues.graphics, vk->queue_family_indices.graphics));
+    // the instances are drawn through a batch rebuilt every frame, the render commands are recorded with it
+    TRACK(Vk_DrawBatch draw_batch = Vk_DrawBatch_Create(vk));
     
     while (running) {
 
@@ -614,11 +956,23 @@ void vk_StartApp(
             }
         }
 
+        TRACK(vkWaitForFences(vk->device, 1, &inFlightFence, VK_TRUE, UINT64_MAX));
+        TRACK(vkResetFences(vk->device, 1, &inFlightFence));
+        TRACK(vk_DeletionQueue_Collect(vk, vk->frame_index - 1));
+        // the previous frame is done, so a reloaded pipeline can replace the one its commands used
+        if (p_shader_watch) {
+            TRACK(Vk_ShaderWatch_Apply(p_shader_watch));
+        }
+        TRACK(Vk_FrameSubmit_Begin(&frame_submit));
+
         // for testing
         {
             //tmp_i=ALL_INSTANCE_COUNT;
-            TRACK(vk_Buffer_Clear(vk, instance_buffer, 0));
-            TRACK(vk_Buffer_Update(vk, instance_buffer, 0, all_instances, sizeof(InstanceData) * tmp_i));
+            TRACK(Vk_FrameSubmit_ClearBuffer(&frame_submit, instance_buffer, 0));
+            TRACK(Vk_FrameSubmit_UploadBuffer(&frame_submit, instance_buffer, 0, packed_instances, sizeof(InstanceDataPacked) * tmp_i));
+            TRACK(Vk_DrawBatch_Clear(&draw_batch));
+            TRACK(Vk_DrawBatch_Add(&draw_batch, (Vk_DrawItem){ .p_pipeline = p_pipeline, .first_instance = 0, .instance_count = tmp_i }));
+            TRACK(Vk_DrawBatch_Build(&draw_batch, &frame_submit));
             if (tmp_i==ALL_INSTANCE_COUNT) {
                 tmp_i = 0;
             }
@@ -627,19 +981,6 @@ void vk_StartApp(
             }
         }
 
-        
-        // Update Uniform Buffer Data
-        UniformBufferObject ubo = {};
-        ubo.targetWidth = (float)vk->p_images[0].extent.width;
-        ubo.targetHeight = (float)vk->p_images[0].extent.height;
-
-        void* data;
-        TRACK(VkResult map_result = vmaMapMemory(vk->allocator, uniformBufferAllocation, &data));
-        VERIFY(map_result == VK_SUCCESS, "Failed to map uniform buffer memory: %d\n", map_result);
-        TRACK(memcpy(data, &ubo, sizeof(ubo)));
-        TRACK(vmaUnmapMemory(vk->allocator, uniformBufferAllocation));
-        TRACK(vkWaitForFences(vk->device, 1, &inFlightFence, VK_TRUE, UINT64_MAX));
-        TRACK(vkResetFences(vk->device, 1, &inFlightFence));
 
         // Acquire the next image from the swap chain
         unsigned int image_index;
@@ -649,19 +990,17 @@ void vk_StartApp(
 
         //vk_Image_TransitionLayoutWithoutCommandBuffer(vk, &vk->p_images[image_index], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-        // Submit the command buffer
-        VkSubmitInfo submit_info = {
-            .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .waitSemaphoreCount   = 1,
-            .pWaitSemaphores      = (VkSemaphore[]){ imageAvailableSemaphore },
-            .pWaitDstStageMask    = (VkPipelineStageFlags[]){ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT },
-            .commandBufferCount   = 1,
-            .pCommandBuffers      = &commandBuffers[image_index],
-            .signalSemaphoreCount = 1,
-            .pSignalSemaphores    = (VkSemaphore[]){ renderFinishedSemaphore }
-        };
-        TRACK(VkResult submit_result = vkQueueSubmit(vk->queues.graphics, 1, &submit_info, inFlightFence));
-        VERIFY(submit_result == VK_SUCCESS, "Failed to submit draw command buffer: %d\n", submit_result);
+        // a reloaded pipeline is picked up by the next recording, nothing recorded earlier refers to it
+        // set 0 holds the per-frame data and comes from the frame's transient allocator, the texture table stays bound
+        VkDescriptorSet frame_desc_sets[2] = { VK_NULL_HANDLE, p_desc_sets[1] };
+        TRACK(frame_desc_sets[0] = Vk_FrameSubmit_AllocateDescriptorSet(&frame_submit, p_pipeline->p_desc_sets_layout[0]));
+        TRACK(VkCommandBuffer render_command_buffer = Vk_FrameSubmit_RenderCommandBuffer(&frame_submit));
+        TRACK(vk_CommandBuffer_RecordDrawBatch(vk, render_command_buffer, &vk->p_images[image_index], p_pipeline, frame_desc_sets, p_push_constants, instance_buffer.buffer, &draw_batch));
+
+        // Submit uploads and the command buffer together
+        TRACK(Vk_FrameSubmit_AddWait(&frame_submit, VK_FRAME_STAGE_RENDER, imageAvailableSemaphore, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, 0));
+        TRACK(Vk_FrameSubmit_AddSignal(&frame_submit, VK_FRAME_STAGE_RENDER, renderFinishedSemaphore, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, 0));
+        TRACK(Vk_FrameSubmit_Flush(&frame_submit, inFlightFence));
 
 
         //vk_Image_TransitionLayoutWithoutCommandBuffer(vk, &vk->p_images[image_index], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
@@ -682,8 +1021,18 @@ void vk_StartApp(
 
         // Optionally wait for the present queue to be idle
         TRACK(vkQueueWaitIdle(vk->queues.present));
+
+        // the state commands recorded during this frame become the last frame's, printed now and then
+        TRACK(vk_RecorderStats_NextFrame(vk));
+        if (vk->frame_index % RECORDER_STATS_INTERVAL == 1) {
+            TRACK(vk_RecorderStats_Print(vk));
+        }
+        vk->frame_index++;
         //usleep(100000);
     }
+
+    TRACK(Vk_FrameSubmit_Destroy(&frame_submit));
+    TRACK(Vk_DrawBatch_Destroy(&draw_batch));
 }
 
 void vk_Destroy(
@@ -701,17 +1050,23 @@ void vk_Destroy(
     VkSemaphore renderFinishedSemaphore,
     VkFence inFlightFence
 ) {
+#ifndef VK_NO_SHADERC
     shaderc_compiler_release(p_vk->shaderc_compiler);
+#endif
     if (p_vk->device != VK_NULL_HANDLE)
         vkDeviceWaitIdle(p_vk->device);
+    vk_DeletionQueue_Collect(p_vk, UINT64_MAX);
+    if (p_vk->p_retired)
+        free(p_vk->p_retired);
     if (graphicsPipeline != VK_NULL_HANDLE) 
         vkDestroyPipeline(p_vk->device, graphicsPipeline, NULL);
     if (pipelineLayout != VK_NULL_HANDLE) 
         vkDestroyPipelineLayout(p_vk->device, pipelineLayout, NULL);
-    if (descriptorSetLayout != VK_NULL_HANDLE)
-        vkDestroyDescriptorSetLayout(p_vk->device, descriptorSetLayout, NULL);
-    if (p_vk->descriptor_pool != VK_NULL_HANDLE) 
-        vkDestroyDescriptorPool(p_vk->device, p_vk->descriptor_pool, NULL);
+    vk_DescriptorSetLayout_Destroy(p_vk, descriptorSetLayout);
+    vk_DescriptorAllocator_Destroy(p_vk, &p_vk->descriptor_allocator);
+    if (p_vk->p_layout_sizes)
+        free(p_vk->p_layout_sizes);
+    vk_TextureTable_Destroy(p_vk);
     if (uniformBuffer != VK_NULL_HANDLE)
         vmaDestroyBuffer(p_vk->allocator, uniformBuffer, uniformBufferAllocation);
     if (instanceBuffer != VK_NULL_HANDLE)
@@ -734,6 +1089,7 @@ void vk_Destroy(
         vkDestroySemaphore(p_vk->device, renderFinishedSemaphore, NULL);
     if (inFlightFence != VK_NULL_HANDLE)
         vkDestroyFence(p_vk->device, inFlightFence, NULL);
+    vk_PipelineCache_Destroy(p_vk);
     if (p_vk->device != VK_NULL_HANDLE)
         vkDestroyDevice(p_vk->device, NULL);
     if (p_vk->debug_messenger != VK_NULL_HANDLE) {
@@ -3,7 +3,7 @@
 #include <stdio.h>
 #include <string.h>
 
-Buffer vk_Buffer_Create(Vk* p_vk, VkDeviceSize size, VkBufferUsageFlags usage) {
+static Buffer CreateBuffer(Vk* p_vk, VkDeviceSize size, VkBufferUsageFlags usage, bool shared) {
     VERIFY(p_vk, "given p_vk context is NULL\n");
 
     Buffer buffer = {0};
@@ -15,6 +15,19 @@ Buffer vk_Buffer_Create(Vk* p_vk, VkDeviceSize size, VkBufferUsageFlags usage) {
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE
     };
 
+    // Concurrent sharing saves the queue family ownership transfers between the graphics and compute queues.
+    // Buffers compute shaders can bind are shared whenever the families differ, the frame's async compute
+    // stage may read them after an upload on the graphics queue or write them for the render stage.
+    const VkBufferUsageFlags compute_usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                             VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT |
+                                             VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    unsigned int queue_families[2] = { p_vk->queue_family_indices.graphics, p_vk->queue_family_indices.compute };
+    if ((shared || (usage & compute_usage)) && queue_families[0] != queue_families[1]) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = queue_families;
+    }
+
     // Add necessary usage flags for transfer operations
     if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT || usage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT) {
         bufferInfo.usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
@@ -58,6 +71,15 @@ Buffer vk_Buffer_Create(Vk* p_vk, VkDeviceSize size, VkBufferUsageFlags usage) {
     return buffer;
 }
 
+Buffer vk_Buffer_Create(Vk* p_vk, VkDeviceSize size, VkBufferUsageFlags usage) {
+    return CreateBuffer(p_vk, size, usage, false);
+}
+
+// For buffers the async compute queue only copies to or from, those compute shaders bind are shared anyway
+Buffer vk_Buffer_CreateShared(Vk* p_vk, VkDeviceSize size, VkBufferUsageFlags usage) {
+    return CreateBuffer(p_vk, size, usage, true);
+}
+
 void vk_Buffer_Clear(Vk* p_vk, Buffer buffer, int clear_value) {
     VERIFY(p_vk, "given p_vk context is NULL\n");
 
@@ -1,5 +1,52 @@
 #include "vk.h"
 
+static const VkImageSubresourceRange color_range = {
+    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .baseMipLevel = 0,
+    .levelCount = 1,
+    .baseArrayLayer = 0,
+    .layerCount = 1,
+};
+
+// the swapchain image is acquired by a semaphore waited at COLOR_ATTACHMENT_OUTPUT, so the transition chains to that stage
+static void BeginTargetRendering(VkCommandBuffer command_buffer, Image* p_target_image) {
+    Vk_BarrierBatch barriers = {0};
+    vk_Barrier_AddImage(&barriers, p_target_image->image, color_range,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+    TRACK(vk_Barrier_Flush(&barriers, command_buffer));
+
+    VkRenderingInfo rendering_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .renderArea = { 
+            .offset = {0, 0}, 
+            .extent = p_target_image->extent 
+        },
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &(VkRenderingAttachmentInfo){
+            .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+            .imageView = p_target_image->view,
+            .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .clearValue = { .color = {0.0f, 0.0f, 0.0f, 1.0f} },
+        },
+    };
+    TRACK( vkCmdBeginRendering(command_buffer, &rendering_info ) );
+}
+
+static void EndTargetRendering(VkCommandBuffer command_buffer, Image* p_target_image) {
+    TRACK( vkCmdEndRendering(command_buffer) );
+    Vk_BarrierBatch barriers = {0};
+    vk_Barrier_AddImage(&barriers, p_target_image->image, color_range,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+    TRACK(vk_Barrier_Flush(&barriers, command_buffer));
+}
+
 VkCommandBuffer vk_CommandBuffer_RecordStaticRendering(
     Vk* p_vk,
     Image* p_target_image,
@@ -7,7 +54,10 @@ VkCommandBuffer vk_CommandBuffer_RecordStaticRendering(
     size_t desc_sets_count,
     VkPipeline graphics_pipeline,
     VkPipelineLayout graphics_pipeline_layout,
+    VkPushConstantRange push_constant_range,
+    const Vk_PushConstants* p_push_constants,
     VkBuffer instance_buffer,
+    unsigned int vertex_count,
     size_t instances_count) 
 {
 
@@ -16,6 +66,8 @@ VkCommandBuffer vk_CommandBuffer_RecordStaticRendering(
     VERIFY(p_desc_sets, "NULL pointer");
     VERIFY(desc_sets_count>0, "desc_sets_count is 0");
     VERIFY(instance_buffer!=VK_NULL_HANDLE, "VK_NULL_HANDLE");
+    VERIFY(push_constant_range.size == 0 || p_push_constants, "NULL pointer");
+    VERIFY(push_constant_range.offset + push_constant_range.size <= sizeof(Vk_PushConstants), "push constants exceed Vk_PushConstants");
 
     VkCommandBufferAllocateInfo alloc_info = {
         .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -34,71 +86,18 @@ VkCommandBuffer vk_CommandBuffer_RecordStaticRendering(
     TRACK(result = vkBeginCommandBuffer(command_buffer, &begin_info));
     VERIFY(result == VK_SUCCESS, "failed to begin command buffer");
 
-    VkImageMemoryBarrier barrier_to_color_attachment = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .srcAccessMask = 0,
-        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = p_target_image->image,
-        .subresourceRange = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
-    };
-
-    TRACK(vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 1, &barrier_to_color_attachment));
-
-    VkRenderingInfo rendering_info = {
-        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
-        .renderArea = { 
-            .offset = {0, 0}, 
-            .extent = p_target_image->extent 
-        },
-        .layerCount = 1,
-        .colorAttachmentCount = 1,
-        .pColorAttachments = &(VkRenderingAttachmentInfo){
-            .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-            .imageView = p_target_image->view,
-            .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-            .clearValue = { .color = {0.0f, 0.0f, 0.0f, 1.0f} },
-        },
-    };
-        
-    TRACK( vkCmdBeginRendering(command_buffer, &rendering_info ) );
-    TRACK( vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline ) );
-    TRACK( vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_layout, 0, desc_sets_count, p_desc_sets, 0, NULL ) );
-    TRACK( vkCmdBindVertexBuffers(command_buffer, 0, 1, (VkBuffer[]){instance_buffer}, (VkDeviceSize[]){0} ) );
-    TRACK( vkCmdDraw(command_buffer, 4, instances_count, 0, 0 ) );
+    TRACK(BeginTargetRendering(command_buffer, p_target_image));
+    Vk_CommandRecorder recorder = Vk_CommandRecorder_Begin(command_buffer);
+    Vk_CommandRecorder_BindPipeline(&recorder, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline, false);
+    Vk_CommandRecorder_BindDescriptorSets(&recorder, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_layout, 0, (unsigned int)desc_sets_count, p_desc_sets);
+    if (push_constant_range.size > 0) {
+        Vk_CommandRecorder_PushConstants(&recorder, graphics_pipeline_layout, push_constant_range, (const unsigned char*)p_push_constants + push_constant_range.offset);
+    }
+    Vk_CommandRecorder_BindVertexBuffers(&recorder, 0, 1, (VkBuffer[]){instance_buffer}, (VkDeviceSize[]){0});
+    TRACK( vkCmdDraw(command_buffer, vertex_count, instances_count, 0, 0 ) );
     // vkCmdDrawIndirect
-    TRACK( vkCmdEndRendering(command_buffer) );
-
-    VkImageMemoryBarrier barrier_to_present = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-        .dstAccessMask = 0,
-        .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = p_target_image->image,
-        .subresourceRange = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
-    };
-
-    TRACK(vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier_to_present));
+    Vk_CommandRecorder_End(&recorder, p_vk);
+    TRACK(EndTargetRendering(command_buffer, p_target_image));
     VERIFY(vkEndCommandBuffer(command_buffer) == VK_SUCCESS, "failed to end command buffer");
 
     return command_buffer;
@@ -110,7 +109,10 @@ VkCommandBuffer* vk_CommandBuffer_CreateForSwapchain(
     size_t desc_sets_count,
     VkPipeline graphics_pipeline,
     VkPipelineLayout graphics_pipeline_layout,
+    VkPushConstantRange push_constant_range,
+    const Vk_PushConstants* p_push_constants,
     VkBuffer instance_buffer,
+    unsigned int vertex_count,
     Image* p_image
 ) {
 
@@ -141,13 +143,51 @@ VkCommandBuffer* vk_CommandBuffer_CreateForSwapchain(
             desc_sets_count, 
             graphics_pipeline, 
             graphics_pipeline_layout, 
+            push_constant_range,
+            p_push_constants,
             instance_buffer, 
+            vertex_count,
             5);
     }
 
     return command_buffers;
 }
 
+// Records into a command buffer that is recording, such as the frame's render command buffer. The batch was
+// built in the same frame, so its runs and the indirect commands uploaded with the frame agree.
+void vk_CommandBuffer_RecordDrawBatch(
+    Vk* p_vk,
+    VkCommandBuffer command_buffer,
+    Image* p_target_image,
+    Vk_GraphicsPipeline* p_pipeline,
+    VkDescriptorSet* p_desc_sets,
+    const Vk_PushConstants* p_push_constants,
+    VkBuffer instance_buffer,
+    Vk_DrawBatch* p_draw_batch)
+{
+    VERIFY(p_vk, "NULL pointer");
+    VERIFY(p_target_image, "NULL pointer");
+    VERIFY(p_pipeline, "NULL pointer");
+    VERIFY(p_desc_sets, "NULL pointer");
+    VERIFY(p_draw_batch, "NULL pointer");
+    VERIFY(command_buffer != VK_NULL_HANDLE, "command_buffer is VK_NULL_HANDLE");
+    VkPushConstantRange push_constant_range = p_pipeline->push_constant_range;
+    VERIFY(push_constant_range.size == 0 || p_push_constants, "NULL pointer");
+    VERIFY(push_constant_range.offset + push_constant_range.size <= sizeof(Vk_PushConstants), "push constants exceed Vk_PushConstants");
+
+    TRACK(BeginTargetRendering(command_buffer, p_target_image));
+    Vk_CommandRecorder recorder = Vk_CommandRecorder_Begin(command_buffer);
+    // the runs bind the same pipeline and sets again, the recorder elides those
+    Vk_CommandRecorder_BindPipeline(&recorder, VK_PIPELINE_BIND_POINT_GRAPHICS, p_pipeline->graphics_pipeline, p_pipeline->dynamic_scissor);
+    Vk_CommandRecorder_BindDescriptorSets(&recorder, VK_PIPELINE_BIND_POINT_GRAPHICS, p_pipeline->pipeline_layout, 0, (unsigned int)p_pipeline->desc_sets_count, p_desc_sets);
+    if (push_constant_range.size > 0) {
+        Vk_CommandRecorder_PushConstants(&recorder, p_pipeline->pipeline_layout, push_constant_range, (const unsigned char*)p_push_constants + push_constant_range.offset);
+    }
+    TRACK(Vk_DrawBatch_Record(p_draw_batch, &recorder, p_pipeline, p_desc_sets, p_pipeline->desc_sets_count, instance_buffer, p_target_image->extent));
+    Vk_CommandRecorder_End(&recorder, p_vk);
+    TRACK(EndTargetRendering(command_buffer, p_target_image));
+}
+
 VkCommandBuffer vk_CommandBuffer_CreateAndBeginSingleTimeUsage(Vk* p_vk) {
     VkCommandBufferAllocateInfo alloc_info = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -0,0 +1,181 @@
+#include "vk.h"
+
+static unsigned int BindPointIndex(VkPipelineBindPoint bind_point) {
+    VERIFY(bind_point == VK_PIPELINE_BIND_POINT_GRAPHICS || bind_point == VK_PIPELINE_BIND_POINT_COMPUTE, "unsupported bind point %d", (int)bind_point);
+    return bind_point == VK_PIPELINE_BIND_POINT_GRAPHICS ? 0 : 1;
+}
+
+static void AddCounters(Vk_RecorderCounters* p_dst, const Vk_RecorderCounters* p_src) {
+    p_dst->pipeline_binds       += p_src->pipeline_binds;
+    p_dst->desc_set_binds       += p_src->desc_set_binds;
+    p_dst->vertex_buffer_binds  += p_src->vertex_buffer_binds;
+    p_dst->viewport_sets        += p_src->viewport_sets;
+    p_dst->scissor_sets         += p_src->scissor_sets;
+    p_dst->push_constant_sets   += p_src->push_constant_sets;
+}
+
+Vk_CommandRecorder Vk_CommandRecorder_Begin(VkCommandBuffer command_buffer) {
+    VERIFY(command_buffer != VK_NULL_HANDLE, "command_buffer is VK_NULL_HANDLE");
+    Vk_CommandRecorder recorder = {0};
+    recorder.command_buffer = command_buffer;
+    return recorder;
+}
+
+void Vk_CommandRecorder_BindPipeline(Vk_CommandRecorder* p_recorder, VkPipelineBindPoint bind_point, VkPipeline pipeline, bool dynamic_viewport_scissor) {
+    VERIFY(p_recorder, "NULL pointer");
+    VERIFY(pipeline != VK_NULL_HANDLE, "pipeline is VK_NULL_HANDLE");
+    Vk_RecorderBindPoint* p_bind_point = &p_recorder->bind_points[BindPointIndex(bind_point)];
+
+    if (p_bind_point->pipeline == pipeline) {
+        p_recorder->stats.elided.pipeline_binds++;
+        return;
+    }
+    TRACK(vkCmdBindPipeline(p_recorder->command_buffer, bind_point, pipeline));
+    p_bind_point->pipeline = pipeline;
+    p_recorder->stats.issued.pipeline_binds++;
+
+    // a pipeline with static viewport and scissor leaves the dynamic state undefined for the next one
+    if (bind_point == VK_PIPELINE_BIND_POINT_GRAPHICS && !dynamic_viewport_scissor) {
+        p_recorder->viewport_valid = false;
+        p_recorder->scissor_valid = false;
+    }
+}
+
+void Vk_CommandRecorder_BindDescriptorSets(Vk_CommandRecorder* p_recorder, VkPipelineBindPoint bind_point, VkPipelineLayout layout, unsigned int first_set, unsigned int sets_count, const VkDescriptorSet* p_sets) {
+    VERIFY(p_recorder, "NULL pointer");
+    VERIFY(layout != VK_NULL_HANDLE, "layout is VK_NULL_HANDLE");
+    VERIFY(first_set + sets_count <= VK_RECORDER_MAX_DESC_SETS, "more than %d descriptor sets", VK_RECORDER_MAX_DESC_SETS);
+    if (sets_count == 0) {
+        return;
+    }
+    VERIFY(p_sets, "NULL pointer");
+    Vk_RecorderBindPoint* p_bind_point = &p_recorder->bind_points[BindPointIndex(bind_point)];
+
+    // a different layout may disturb every set, so nothing is elided
+    if (p_bind_point->pipeline_layout != layout) {
+        TRACK(vkCmdBindDescriptorSets(p_recorder->command_buffer, bind_point, layout, first_set, sets_count, p_sets, 0, NULL));
+        memset(p_bind_point->desc_sets, 0, sizeof(p_bind_point->desc_sets));
+        memcpy(&p_bind_point->desc_sets[first_set], p_sets, sets_count * sizeof(VkDescriptorSet));
+        p_bind_point->pipeline_layout = layout;
+        p_recorder->stats.issued.desc_set_binds++;
+        return;
+    }
+
+    // only rebind the subrange between the first and the last set that differ
+    unsigned int begin = 0;
+    while (begin < sets_count && p_bind_point->desc_sets[first_set + begin] == p_sets[begin]) {
+        begin++;
+    }
+    if (begin == sets_count) {
+        p_recorder->stats.elided.desc_set_binds++;
+        return;
+    }
+    unsigned int end = sets_count;
+    while (end > begin && p_bind_point->desc_sets[first_set + end - 1] == p_sets[end - 1]) {
+        end--;
+    }
+    TRACK(vkCmdBindDescriptorSets(p_recorder->command_buffer, bind_point, layout, first_set + begin, end - begin, &p_sets[begin], 0, NULL));
+    memcpy(&p_bind_point->desc_sets[first_set + begin], &p_sets[begin], (end - begin) * sizeof(VkDescriptorSet));
+    p_recorder->stats.issued.desc_set_binds++;
+}
+
+void Vk_CommandRecorder_BindVertexBuffers(Vk_CommandRecorder* p_recorder, unsigned int first_binding, unsigned int bindings_count, const VkBuffer* p_buffers, const VkDeviceSize* p_offsets) {
+    VERIFY(p_recorder, "NULL pointer");
+    VERIFY(first_binding + bindings_count <= VK_RECORDER_MAX_VERTEX_BUFFERS, "more than %d vertex buffers", VK_RECORDER_MAX_VERTEX_BUFFERS);
+    if (bindings_count == 0) {
+        return;
+    }
+    VERIFY(p_buffers && p_offsets, "NULL pointer");
+
+    bool changed = false;
+    for (unsigned int i = 0; i < bindings_count; ++i) {
+        if (p_recorder->vertex_buffers[first_binding + i] != p_buffers[i] || p_recorder->vertex_offsets[first_binding + i] != p_offsets[i]) {
+            changed = true;
+            break;
+        }
+    }
+    if (!changed) {
+        p_recorder->stats.elided.vertex_buffer_binds++;
+        return;
+    }
+    TRACK(vkCmdBindVertexBuffers(p_recorder->command_buffer, first_binding, bindings_count, p_buffers, p_offsets));
+    memcpy(&p_recorder->vertex_buffers[first_binding], p_buffers, bindings_count * sizeof(VkBuffer));
+    memcpy(&p_recorder->vertex_offsets[first_binding], p_offsets, bindings_count * sizeof(VkDeviceSize));
+    p_recorder->stats.issued.vertex_buffer_binds++;
+}
+
+void Vk_CommandRecorder_SetViewport(Vk_CommandRecorder* p_recorder, VkViewport viewport) {
+    VERIFY(p_recorder, "NULL pointer");
+    if (p_recorder->viewport_valid && memcmp(&p_recorder->viewport, &viewport, sizeof(VkViewport)) == 0) {
+        p_recorder->stats.elided.viewport_sets++;
+        return;
+    }
+    TRACK(vkCmdSetViewport(p_recorder->command_buffer, 0, 1, &viewport));
+    p_recorder->viewport = viewport;
+    p_recorder->viewport_valid = true;
+    p_recorder->stats.issued.viewport_sets++;
+}
+
+void Vk_CommandRecorder_SetScissor(Vk_CommandRecorder* p_recorder, VkRect2D scissor) {
+    VERIFY(p_recorder, "NULL pointer");
+    if (p_recorder->scissor_valid && memcmp(&p_recorder->scissor, &scissor, sizeof(VkRect2D)) == 0) {
+        p_recorder->stats.elided.scissor_sets++;
+        return;
+    }
+    TRACK(vkCmdSetScissor(p_recorder->command_buffer, 0, 1, &scissor));
+    p_recorder->scissor = scissor;
+    p_recorder->scissor_valid = true;
+    p_recorder->stats.issued.scissor_sets++;
+}
+
+// p_data holds range.size bytes for the range of the layout. Pushing the same bytes to the same range
+// again is elided.
+void Vk_CommandRecorder_PushConstants(Vk_CommandRecorder* p_recorder, VkPipelineLayout layout, VkPushConstantRange range, const void* p_data) {
+    VERIFY(p_recorder && p_data, "NULL pointer");
+    VERIFY(layout != VK_NULL_HANDLE, "layout is VK_NULL_HANDLE");
+    VERIFY(range.offset + range.size <= VK_RECORDER_MAX_PUSH_CONSTANTS, "push constants [%u, %u) exceed %d bytes", range.offset, range.offset + range.size, VK_RECORDER_MAX_PUSH_CONSTANTS);
+    if (range.size == 0) {
+        return;
+    }
+    if (p_recorder->push_constants_layout == layout &&
+        memcmp(&p_recorder->push_constants_range, &range, sizeof(VkPushConstantRange)) == 0 &&
+        memcmp(&p_recorder->push_constants[range.offset], p_data, range.size) == 0) {
+        p_recorder->stats.elided.push_constant_sets++;
+        return;
+    }
+    TRACK(vkCmdPushConstants(p_recorder->command_buffer, layout, range.stageFlags, range.offset, range.size, p_data));
+    memcpy(&p_recorder->push_constants[range.offset], p_data, range.size);
+    p_recorder->push_constants_layout = layout;
+    p_recorder->push_constants_range = range;
+    p_recorder->stats.issued.push_constant_sets++;
+}
+
+void Vk_CommandRecorder_End(Vk_CommandRecorder* p_recorder, Vk* p_vk) {
+    VERIFY(p_recorder, "NULL pointer");
+    if (p_vk) {
+        AddCounters(&p_vk->recorder_stats_this_frame.issued, &p_recorder->stats.issued);
+        AddCounters(&p_vk->recorder_stats_this_frame.elided, &p_recorder->stats.elided);
+    }
+    memset(p_recorder, 0, sizeof(Vk_CommandRecorder));
+}
+
+void vk_RecorderStats_NextFrame(Vk* p_vk) {
+    VERIFY(p_vk, "NULL pointer");
+    p_vk->recorder_stats_last_frame = p_vk->recorder_stats_this_frame;
+    memset(&p_vk->recorder_stats_this_frame, 0, sizeof(Vk_RecorderStats));
+}
+
+// Issued and elided counts of the previous frame, frame_index is still the one that was recorded
+void vk_RecorderStats_Print(const Vk* p_vk) {
+    VERIFY(p_vk, "NULL pointer");
+    const Vk_RecorderStats* p_stats = &p_vk->recorder_stats_last_frame;
+    printf("Frame %llu state commands issued/elided: pipeline binds %u/%u, descriptor set binds %u/%u, vertex buffer binds %u/%u, "
+           "viewports %u/%u, scissors %u/%u, push constants %u/%u\n",
+        (unsigned long long)p_vk->frame_index,
+        p_stats->issued.pipeline_binds,      p_stats->elided.pipeline_binds,
+        p_stats->issued.desc_set_binds,      p_stats->elided.desc_set_binds,
+        p_stats->issued.vertex_buffer_binds, p_stats->elided.vertex_buffer_binds,
+        p_stats->issued.viewport_sets,       p_stats->elided.viewport_sets,
+        p_stats->issued.scissor_sets,        p_stats->elided.scissor_sets,
+        p_stats->issued.push_constant_sets,  p_stats->elided.push_constant_sets);
+}
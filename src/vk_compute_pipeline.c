@@ -0,0 +1,149 @@
+#include "vk.h"
+
+static unsigned int DivRoundUp(unsigned int value, unsigned int divisor) {
+    return (value + divisor - 1) / divisor;
+}
+
+Vk_ComputePipeline Vk_ComputePipeline_Create(Vk* p_vk, SpvShader spv_shader) {
+    VERIFY(p_vk, "NULL pointer passed to Vk_ComputePipeline_Create");
+    VERIFY(spv_shader.code, "NULL pointer passed as SPV code");
+    VERIFY(spv_shader.size > 0, "SPIR-V code size is zero");
+
+    Vk_ComputePipeline pipeline;
+    memset(&pipeline, 0, sizeof(Vk_ComputePipeline));
+    pipeline.p_vk = p_vk;
+
+    Gui_Shader* p_shader = &pipeline.shader;
+    TRACK(p_shader->p_spv_code = alloc(NULL, spv_shader.size));
+    memcpy((void*)p_shader->p_spv_code, spv_shader.code, spv_shader.size);
+    p_shader->spv_code_size = spv_shader.size;
+    p_shader->shader_kind   = shaderc_compute_shader;
+
+    TRACK(p_shader->reflection = vk_ShaderReflection_Create(spv_shader));
+    const Vk_ShaderReflection* p_reflection = &p_shader->reflection;
+    VERIFY(p_reflection->stage == VK_SHADER_STAGE_COMPUTE_BIT, "Shader is not a compute shader");
+
+    VkShaderModuleCreateInfo module_info = {
+        .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = p_shader->spv_code_size,
+        .pCode    = p_shader->p_spv_code
+    };
+    TRACK(VkResult result = vkCreateShaderModule(p_vk->device, &module_info, NULL, &p_shader->shader_module));
+    VERIFY(result == VK_SUCCESS, "Failed to create Vulkan shader module");
+
+    // Descriptor set layouts from reflection, the same way graphics pipelines build theirs.
+    // A shader that only takes push constants has none.
+    if (p_reflection->bindings_count > 0) {
+        TRACK(pipeline.p_desc_sets_layout_create_info = vk_DescriptorSetLayoutCreateInfo_Create(
+            p_vk,
+            p_reflection,
+            1,
+            &pipeline.desc_sets_count));
+        TRACK(pipeline.p_desc_sets_layout = vk_DescriptorSetLayout_Create(
+            p_vk,
+            pipeline.p_desc_sets_layout_create_info,
+            pipeline.desc_sets_count));
+    }
+
+    // One range covering every push constant the entry point declares
+    pipeline.push_constant_range = vk_PushConstantRange_CreateFromReflections(p_reflection, 1);
+
+    pipeline.local_size[0] = p_reflection->local_size[0];
+    pipeline.local_size[1] = p_reflection->local_size[1];
+    pipeline.local_size[2] = p_reflection->local_size[2];
+    VERIFY(pipeline.local_size[0] > 0, "Compute shader has no entry point");
+
+    VkPipelineLayoutCreateInfo layout_info = {
+        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount         = (uint32_t)pipeline.desc_sets_count,
+        .pSetLayouts            = pipeline.p_desc_sets_layout,
+        .pushConstantRangeCount = pipeline.push_constant_range.size > 0 ? 1 : 0,
+        .pPushConstantRanges    = &pipeline.push_constant_range
+    };
+    TRACK(result = vkCreatePipelineLayout(p_vk->device, &layout_info, NULL, &pipeline.pipeline_layout));
+    VERIFY(result == VK_SUCCESS, "Failed to create pipeline layout");
+
+    VkComputePipelineCreateInfo pipeline_info = {
+        .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage  = {
+            .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = p_shader->shader_module,
+            .pName  = "main",
+        },
+        .layout             = pipeline.pipeline_layout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex  = -1
+    };
+    TRACK(result = vkCreateComputePipelines(p_vk->device, p_vk->pipeline_cache, 1, &pipeline_info, NULL, &pipeline.compute_pipeline));
+    VERIFY(result == VK_SUCCESS, "Failed to create compute pipeline");
+
+    return pipeline;
+}
+
+void Vk_ComputePipeline_Bind(Vk_ComputePipeline* p_pipeline, Vk_CommandRecorder* p_recorder, const VkDescriptorSet* p_desc_sets, size_t desc_sets_count) {
+    VERIFY(p_pipeline, "NULL pointer");
+    VERIFY(p_pipeline->compute_pipeline != VK_NULL_HANDLE, "pipeline was not created");
+    VERIFY(desc_sets_count <= p_pipeline->desc_sets_count, "more descriptor sets than the pipeline layout has");
+
+    TRACK(Vk_CommandRecorder_BindPipeline(p_recorder, VK_PIPELINE_BIND_POINT_COMPUTE, p_pipeline->compute_pipeline, true));
+    TRACK(Vk_CommandRecorder_BindDescriptorSets(p_recorder, VK_PIPELINE_BIND_POINT_COMPUTE, p_pipeline->pipeline_layout, 0, (unsigned int)desc_sets_count, p_desc_sets));
+}
+
+void Vk_ComputePipeline_PushConstants(Vk_ComputePipeline* p_pipeline, Vk_CommandRecorder* p_recorder, unsigned int offset, unsigned int size, const void* p_data) {
+    VERIFY(p_pipeline && p_recorder, "NULL pointer");
+    VERIFY(p_data, "NULL pointer");
+    VERIFY(offset >= p_pipeline->push_constant_range.offset &&
+           offset + size <= p_pipeline->push_constant_range.offset + p_pipeline->push_constant_range.size,
+           "push constants [%u, %u) are outside the reflected range", offset, offset + size);
+    TRACK(vkCmdPushConstants(p_recorder->command_buffer, p_pipeline->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, offset, size, p_data));
+}
+
+void Vk_ComputePipeline_Dispatch(Vk_ComputePipeline* p_pipeline, Vk_CommandRecorder* p_recorder, unsigned int group_count_x, unsigned int group_count_y, unsigned int group_count_z) {
+    VERIFY(p_pipeline && p_recorder, "NULL pointer");
+    VERIFY(p_recorder->bind_points[1].pipeline == p_pipeline->compute_pipeline, "pipeline is not bound");
+    if (group_count_x == 0 || group_count_y == 0 || group_count_z == 0) {
+        return;
+    }
+    TRACK(vkCmdDispatch(p_recorder->command_buffer, group_count_x, group_count_y, group_count_z));
+}
+
+// Enough workgroups of the reflected local size to cover the given number of invocations
+void Vk_ComputePipeline_DispatchThreads(Vk_ComputePipeline* p_pipeline, Vk_CommandRecorder* p_recorder, unsigned int threads_x, unsigned int threads_y, unsigned int threads_z) {
+    VERIFY(p_pipeline, "NULL pointer");
+    TRACK(Vk_ComputePipeline_Dispatch(p_pipeline, p_recorder,
+        DivRoundUp(threads_x, p_pipeline->local_size[0]),
+        DivRoundUp(threads_y, p_pipeline->local_size[1]),
+        DivRoundUp(threads_z, p_pipeline->local_size[2])));
+}
+
+// The group counts are read from a VkDispatchIndirectCommand that an earlier pass wrote into the buffer
+void Vk_ComputePipeline_DispatchIndirect(Vk_ComputePipeline* p_pipeline, Vk_CommandRecorder* p_recorder, VkBuffer buffer, VkDeviceSize offset) {
+    VERIFY(p_pipeline && p_recorder, "NULL pointer");
+    VERIFY(buffer != VK_NULL_HANDLE, "buffer is VK_NULL_HANDLE");
+    VERIFY(offset % 4 == 0, "indirect dispatch offset must be a multiple of 4");
+    VERIFY(p_recorder->bind_points[1].pipeline == p_pipeline->compute_pipeline, "pipeline is not bound");
+    TRACK(vkCmdDispatchIndirect(p_recorder->command_buffer, buffer, offset));
+}
+
+// The pipeline and its layout may still be used by frames in flight, so they go through the deletion queue
+void Vk_ComputePipeline_Destroy(Vk_ComputePipeline* p_pipeline) {
+    VERIFY(p_pipeline, "NULL pointer");
+    Vk* p_vk = p_pipeline->p_vk;
+    if (!p_vk) {
+        return;
+    }
+
+    TRACK(vk_DeletionQueue_RetirePipeline(p_vk, p_pipeline->compute_pipeline));
+    TRACK(vk_DeletionQueue_RetirePipelineLayout(p_vk, p_pipeline->pipeline_layout));
+    for (size_t i = 0; i < p_pipeline->desc_sets_count; ++i) {
+        TRACK(vk_DescriptorSetLayout_Destroy(p_vk, p_pipeline->p_desc_sets_layout[i]));
+        if (p_pipeline->p_desc_sets_layout_create_info[i].pBindings) free((void*)p_pipeline->p_desc_sets_layout_create_info[i].pBindings);
+    }
+    if (p_pipeline->p_desc_sets_layout) free(p_pipeline->p_desc_sets_layout);
+    if (p_pipeline->p_desc_sets_layout_create_info) free(p_pipeline->p_desc_sets_layout_create_info);
+
+    TRACK(vkDestroyShaderModule(p_vk->device, p_pipeline->shader.shader_module, NULL));
+    if (p_pipeline->shader.p_spv_code) free((void*)p_pipeline->shader.p_spv_code);
+    memset(p_pipeline, 0, sizeof(Vk_ComputePipeline));
+}
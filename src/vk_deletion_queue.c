@@ -0,0 +1,145 @@
+#include "vk.h"
+
+// Everything retired while recording frame_index may still be used by that frame or an earlier one. Later
+// frames must not use it, prerecorded command buffers that do are recorded again before the frame is submitted.
+static Vk_RetiredResource* Retire(Vk* p_vk, Vk_RetiredKind kind) {
+    VERIFY(p_vk, "NULL pointer");
+    if (p_vk->retired_count == p_vk->retired_capacity) {
+        p_vk->retired_capacity = p_vk->retired_capacity ? p_vk->retired_capacity * 2 : 32;
+        p_vk->p_retired = alloc(p_vk->p_retired, sizeof(Vk_RetiredResource) * p_vk->retired_capacity);
+    }
+    Vk_RetiredResource* p_retired = &p_vk->p_retired[p_vk->retired_count++];
+    memset(p_retired, 0, sizeof(Vk_RetiredResource));
+    p_retired->kind = kind;
+    p_retired->retire_point = p_vk->frame_index;
+    return p_retired;
+}
+
+void vk_DeletionQueue_RetireBuffer(Vk* p_vk, Buffer buffer) {
+    if (buffer.buffer == VK_NULL_HANDLE) {
+        return;
+    }
+    Vk_RetiredResource* p_retired = Retire(p_vk, VK_RETIRED_BUFFER);
+    p_retired->buffer.buffer = buffer.buffer;
+    p_retired->buffer.allocation = buffer.allocation;
+}
+
+// The host side state of the image is released right away, the handles once the GPU is done with them
+void vk_DeletionQueue_RetireImage(Vk* p_vk, Image* p_image) {
+    VERIFY(p_image, "NULL pointer");
+    vk_DeletionQueue_RetireTextureSlot(p_vk, p_image->texture_index);
+    vk_DeletionQueue_RetireSampler(p_vk, p_image->sampler);
+    vk_DeletionQueue_RetireImageView(p_vk, p_image->view);
+    if (p_image->image != VK_NULL_HANDLE) {
+        Vk_RetiredResource* p_retired = Retire(p_vk, VK_RETIRED_IMAGE);
+        p_retired->image.image = p_image->image;
+        p_retired->image.allocation = p_image->allocation;
+    }
+    if (p_image->p_states) free(p_image->p_states);
+    memset(p_image, 0, sizeof(Image));
+}
+
+void vk_DeletionQueue_RetireImageView(Vk* p_vk, VkImageView view) {
+    if (view == VK_NULL_HANDLE) {
+        return;
+    }
+    Retire(p_vk, VK_RETIRED_IMAGE_VIEW)->view = view;
+}
+
+void vk_DeletionQueue_RetireSampler(Vk* p_vk, VkSampler sampler) {
+    if (sampler == VK_NULL_HANDLE) {
+        return;
+    }
+    Retire(p_vk, VK_RETIRED_SAMPLER)->sampler = sampler;
+}
+
+// pool is the descriptor allocator pool the sets came from
+void vk_DeletionQueue_RetireDescriptorSets(Vk* p_vk, VkDescriptorPool pool, const VkDescriptorSet* p_sets, size_t sets_count) {
+    VERIFY(p_sets || sets_count == 0, "NULL pointer");
+    for (size_t i = 0; i < sets_count; ++i) {
+        // the texture table's set lives as long as the device
+        if (p_sets[i] == VK_NULL_HANDLE || p_sets[i] == p_vk->texture_table.set) {
+            continue;
+        }
+        VERIFY(pool != VK_NULL_HANDLE, "pool is VK_NULL_HANDLE");
+        Vk_RetiredResource* p_retired = Retire(p_vk, VK_RETIRED_DESCRIPTOR_SET);
+        p_retired->desc_set.pool = pool;
+        p_retired->desc_set.set = p_sets[i];
+    }
+}
+
+void vk_DeletionQueue_RetirePipeline(Vk* p_vk, VkPipeline pipeline) {
+    if (pipeline == VK_NULL_HANDLE) {
+        return;
+    }
+    Retire(p_vk, VK_RETIRED_PIPELINE)->pipeline = pipeline;
+}
+
+void vk_DeletionQueue_RetirePipelineLayout(Vk* p_vk, VkPipelineLayout pipeline_layout) {
+    if (pipeline_layout == VK_NULL_HANDLE) {
+        return;
+    }
+    Retire(p_vk, VK_RETIRED_PIPELINE_LAYOUT)->pipeline_layout = pipeline_layout;
+}
+
+void vk_DeletionQueue_RetireCommandBuffer(Vk* p_vk, VkCommandPool pool, VkCommandBuffer command_buffer) {
+    if (command_buffer == VK_NULL_HANDLE) {
+        return;
+    }
+    VERIFY(pool != VK_NULL_HANDLE, "pool is VK_NULL_HANDLE");
+    Vk_RetiredResource* p_retired = Retire(p_vk, VK_RETIRED_COMMAND_BUFFER);
+    p_retired->command_buffer.pool = pool;
+    p_retired->command_buffer.command_buffer = command_buffer;
+}
+
+// Frames in flight may still sample the slot, it is only handed to another image after them
+void vk_DeletionQueue_RetireTextureSlot(Vk* p_vk, unsigned int texture_index) {
+    if (texture_index == 0) {
+        return;
+    }
+    Retire(p_vk, VK_RETIRED_TEXTURE_SLOT)->texture_slot = texture_index;
+}
+
+// Destroys everything retired at or before completed_point, UINT64_MAX drains the queue
+void vk_DeletionQueue_Collect(Vk* p_vk, uint64_t completed_point) {
+    VERIFY(p_vk, "NULL pointer");
+
+    size_t kept = 0;
+    for (size_t i = 0; i < p_vk->retired_count; ++i) {
+        Vk_RetiredResource* p_retired = &p_vk->p_retired[i];
+        if (p_retired->retire_point > completed_point) {
+            p_vk->p_retired[kept++] = *p_retired;
+            continue;
+        }
+        switch (p_retired->kind) {
+            case VK_RETIRED_BUFFER:
+                TRACK(vmaDestroyBuffer(p_vk->allocator, p_retired->buffer.buffer, p_retired->buffer.allocation));
+                break;
+            case VK_RETIRED_IMAGE:
+                TRACK(vmaDestroyImage(p_vk->allocator, p_retired->image.image, p_retired->image.allocation));
+                break;
+            case VK_RETIRED_IMAGE_VIEW:
+                TRACK(vkDestroyImageView(p_vk->device, p_retired->view, NULL));
+                break;
+            case VK_RETIRED_SAMPLER:
+                TRACK(vkDestroySampler(p_vk->device, p_retired->sampler, NULL));
+                break;
+            case VK_RETIRED_DESCRIPTOR_SET:
+                TRACK(vk_DescriptorAllocator_Free(p_vk, &p_vk->descriptor_allocator, p_retired->desc_set.pool, &p_retired->desc_set.set, 1));
+                break;
+            case VK_RETIRED_PIPELINE:
+                TRACK(vkDestroyPipeline(p_vk->device, p_retired->pipeline, NULL));
+                break;
+            case VK_RETIRED_PIPELINE_LAYOUT:
+                TRACK(vkDestroyPipelineLayout(p_vk->device, p_retired->pipeline_layout, NULL));
+                break;
+            case VK_RETIRED_COMMAND_BUFFER:
+                TRACK(vkFreeCommandBuffers(p_vk->device, p_retired->command_buffer.pool, 1, &p_retired->command_buffer.command_buffer));
+                break;
+            case VK_RETIRED_TEXTURE_SLOT:
+                TRACK(vk_TextureTable_Unregister(p_vk, p_retired->texture_slot));
+                break;
+        }
+    }
+    p_vk->retired_count = kept;
+}
@@ -2,23 +2,24 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-VkDescriptorSetLayoutCreateInfo* vk_DescriptorSetLayoutCreateInfo_Create(Vk* p_vk, const SpvReflectShaderModule* p_shader_modules, unsigned int shader_modules_count, size_t* p_create_info_count) {
+VkDescriptorSetLayoutCreateInfo* vk_DescriptorSetLayoutCreateInfo_Create(Vk* p_vk, const Vk_ShaderReflection* p_reflections, unsigned int reflections_count, size_t* p_create_info_count) {
     VERIFY(p_vk, "NULL pointer");
-    VERIFY(p_shader_modules, "NULL pointer");
+    VERIFY(p_reflections, "NULL pointer");
     VERIFY(p_create_info_count, "NULL pointer");
 
     VkDescriptorSetLayoutCreateInfo*    p_create_info = NULL;
     size_t                              create_info_count = 0;
 
-    for (unsigned int module = 0; module < shader_modules_count; module++) {
+    for (unsigned int module = 0; module < reflections_count; module++) {
         printf("module %d\n", module);
 
         // for each binding there is a binding and set number
-        for (unsigned int binding_i = 0; binding_i < p_shader_modules[module].descriptor_binding_count; binding_i++) {
+        for (unsigned int binding_i = 0; binding_i < p_reflections[module].bindings_count; binding_i++) {
             printf("binding_i %d\n", binding_i);
 
-            unsigned int set_number = p_shader_modules[module].descriptor_bindings[binding_i].set ;
-            unsigned int binding_number = p_shader_modules[module].descriptor_bindings[binding_i].binding;
+            const Vk_ReflectedBinding* p_binding = &p_reflections[module].bindings[binding_i];
+            unsigned int set_number = p_binding->set;
+            unsigned int binding_number = p_binding->binding;
 
             printf("set_number %d\n", set_number);
             printf("binding_number %d\n", binding_number);
@@ -50,10 +51,27 @@ VkDescriptorSetLayoutCreateInfo* vk_DescriptorSetLayoutCreateInfo_Create(Vk* p_v
                 p_create_info[set_number].sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
             }
 
-            if (p_create_info[set_number].pBindings) {
-                for (unsigned int i = 0; i < p_create_info[set_number].bindingCount; i++) {
-                    VERIFY(p_create_info[set_number].pBindings[i].binding != binding_number, "binding-set pair already exists");
+            // a runtime array is the texture table, sized like the table so the shared layout replaces it
+            unsigned int descriptor_count = p_binding->count;
+            if (descriptor_count == 0) {
+                VERIFY(set_number == VK_TEXTURE_TABLE_SET && binding_number == VK_TEXTURE_TABLE_BINDING && p_binding->type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                       "set %u binding %u is a runtime array, only the texture table at set %d binding %d may be one", set_number, binding_number, VK_TEXTURE_TABLE_SET, VK_TEXTURE_TABLE_BINDING);
+                descriptor_count = p_vk->texture_table.capacity;
+            }
+
+            // a binding used by several stages is one binding visible to all of them
+            bool merged = false;
+            for (unsigned int i = 0; i < p_create_info[set_number].bindingCount; i++) {
+                VkDescriptorSetLayoutBinding* p_existing = (VkDescriptorSetLayoutBinding*)&p_create_info[set_number].pBindings[i];
+                if (p_existing->binding != binding_number) {
+                    continue;
                 }
+                VERIFY(p_existing->descriptorType == p_binding->type && p_existing->descriptorCount == descriptor_count, "set %u binding %u differs between stages", set_number, binding_number);
+                p_existing->stageFlags |= p_reflections[module].stage;
+                merged = true;
+            }
+            if (merged) {
+                continue;
             }
 
             // allocating space for new binding
@@ -67,16 +85,20 @@ VkDescriptorSetLayoutCreateInfo* vk_DescriptorSetLayoutCreateInfo_Create(Vk* p_v
             // writing binding data
             VkDescriptorSetLayoutBinding* p_new_binding = &p_create_info[set_number].pBindings[p_create_info[set_number].bindingCount-1];
             p_new_binding->binding = binding_number;
-            p_new_binding->descriptorType = p_shader_modules[module].descriptor_bindings[binding_i].descriptor_type;
-            p_new_binding->descriptorCount = p_shader_modules[module].descriptor_bindings[binding_i].count;
-            p_new_binding->stageFlags = (VkShaderStageFlags)p_shader_modules[module].shader_stage;
+            p_new_binding->descriptorType = p_binding->type;
+            p_new_binding->descriptorCount = descriptor_count;
+            p_new_binding->stageFlags = p_reflections[module].stage;
             p_new_binding->pImmutableSamplers = NULL; // Update if using immutable samplers
 
         }
     }
 
+    // a set no stage uses, like set 0 once its uniform buffer became push constants, gets an empty layout
     for (unsigned int i = 0; i < create_info_count; i++) {
-        VERIFY(p_create_info[i].sType == VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, "set numbers is not continuous");
+        if (p_create_info[i].sType != VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO) {
+            memset(&p_create_info[i], 0, sizeof(VkDescriptorSetLayoutCreateInfo));
+            p_create_info[i].sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        }
     }
 
     TRACK(vk_DescriptorSetLayoutCreateInfo_Print(p_create_info, create_info_count));
@@ -111,7 +133,13 @@ VkDescriptorSetLayout* vk_DescriptorSetLayout_Create(Vk* p_vk, const VkDescripto
     memset(p_set_layout, 0, create_info_count*sizeof(VkDescriptorSetLayout));
 
     for (unsigned int i = 0; i < create_info_count; ++i) {
+        // every pipeline shares the texture table's layout, so they all bind its one set
+        if (vk_TextureTable_IsLayout(p_vk, i, &p_create_info[i])) {
+            p_set_layout[i] = p_vk->texture_table.set_layout;
+            continue;
+        }
         VERIFY(vkCreateDescriptorSetLayout(p_vk->device, &p_create_info[i], NULL, &p_set_layout[i]) == VK_SUCCESS, "failed to create");
+        TRACK(vk_DescriptorAllocator_AddLayout(p_vk, p_set_layout[i], &p_create_info[i]));
     }
 
     return p_set_layout;
@@ -131,10 +159,43 @@ VkDescriptorSetLayout vk_DescriptorSetLayout_Create_0(Vk* p_vk) {
 
     VkDescriptorSetLayout descriptorSetLayout;
     VERIFY(vkCreateDescriptorSetLayout(p_vk->device, &layout_info, NULL, &descriptorSetLayout) == VK_SUCCESS, "Failed to create descriptor set layout\n");
+    TRACK(vk_DescriptorAllocator_AddLayout(p_vk, descriptorSetLayout, &layout_info));
 
     return descriptorSetLayout;
 }
-VkDescriptorSet* vk_DescriptorSet_Create(Vk* p_vk, const VkDescriptorSetLayout* p_desc_set_layout, size_t desc_set_layouts_count) {
+// The texture table's layout is shared and outlives every pipeline
+void vk_DescriptorSetLayout_Destroy(Vk* p_vk, VkDescriptorSetLayout layout) {
+    VERIFY(p_vk, "NULL pointer");
+    if (layout == VK_NULL_HANDLE || layout == p_vk->texture_table.set_layout) {
+        return;
+    }
+    TRACK(vk_DescriptorAllocator_RemoveLayout(p_vk, layout));
+    TRACK(vkDestroyDescriptorSetLayout(p_vk->device, layout, NULL));
+}
+// The texture table's set is shared, the others come from the persistent descriptor allocator in one
+// batch, so they share the pool this returns. VK_NULL_HANDLE when all of them are the table's.
+static VkDescriptorPool AllocateSets(Vk* p_vk, const VkDescriptorSetLayout* p_desc_set_layout, size_t desc_set_layouts_count, VkDescriptorSet* p_desc_sets) {
+    TRACK(VkDescriptorSetLayout* p_layouts = alloc(NULL, desc_set_layouts_count * sizeof(VkDescriptorSetLayout)));
+    TRACK(VkDescriptorSet* p_sets = alloc(NULL, desc_set_layouts_count * sizeof(VkDescriptorSet)));
+    unsigned int sets_count = 0;
+    for (size_t set = 0; set < desc_set_layouts_count; ++set) {
+        if (p_desc_set_layout[set] != p_vk->texture_table.set_layout) {
+            p_layouts[sets_count++] = p_desc_set_layout[set];
+        }
+    }
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    if (sets_count > 0) {
+        TRACK(pool = vk_DescriptorAllocator_Allocate(p_vk, &p_vk->descriptor_allocator, p_layouts, sets_count, p_sets));
+    }
+    for (size_t set = 0, next = 0; set < desc_set_layouts_count; ++set) {
+        p_desc_sets[set] = p_desc_set_layout[set] == p_vk->texture_table.set_layout ? p_vk->texture_table.set : p_sets[next++];
+    }
+    free(p_layouts);
+    free(p_sets);
+    return pool;
+}
+VkDescriptorSet* vk_DescriptorSet_Create(Vk* p_vk, const VkDescriptorSetLayout* p_desc_set_layout, size_t desc_set_layouts_count, VkDescriptorPool* p_pool) {
     
     VERIFY(p_vk, "NULL pointer");
     if (!p_desc_set_layout && desc_set_layouts_count == 0) {
@@ -147,25 +208,12 @@ VkDescriptorSet* vk_DescriptorSet_Create(Vk* p_vk, const VkDescriptorSetLayout*
     TRACK(VkDescriptorSet* p_desc_sets = alloc(NULL, desc_set_layouts_count * sizeof(VkDescriptorSet)));
     VERIFY(p_desc_sets, "Descriptor sets allocation failed");
 
-    for (size_t set = 0; set < desc_set_layouts_count; ++set) {
-        printf("set %zu\n", set);  // Note: Use %zu for size_t
-        VkDescriptorSetAllocateInfo alloc_info = {
-            .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-            .descriptorPool     = p_vk->descriptor_pool,
-            .descriptorSetCount = 1,
-            .pSetLayouts        = &p_desc_set_layout[set]
-        };
-        
-        // Check if the layout is valid before allocation
-        VERIFY(p_desc_set_layout[set] != VK_NULL_HANDLE, "Invalid VkDescriptorSetLayout handle for set %zu", set);
-        
-        TRACK(VkResult result = vkAllocateDescriptorSets(p_vk->device, &alloc_info, &p_desc_sets[set]));
-        VERIFY(result == VK_SUCCESS, "Failed to allocate descriptor set. result = %d", result);
-    }
+    TRACK(VkDescriptorPool pool = AllocateSets(p_vk, p_desc_set_layout, desc_set_layouts_count, p_desc_sets));
+    if (p_pool) *p_pool = pool;
 
     return p_desc_sets;
 }
-VkDescriptorSet* vk_DescriptorSet_Create_0(Vk* p_vk, const VkDescriptorSetLayout* p_desc_set_layout, size_t desc_set_layouts_count, VkBuffer buffer, Image* p_image) {
+VkDescriptorSet* vk_DescriptorSet_Create_0(Vk* p_vk, const VkDescriptorSetLayout* p_desc_set_layout, size_t desc_set_layouts_count, VkBuffer buffer, Image* p_image, VkDescriptorPool* p_pool) {
     
     VERIFY(p_vk, "NULL pointer");
     VERIFY(p_desc_set_layout, "NULL pointer");
@@ -176,21 +224,14 @@ VkDescriptorSet* vk_DescriptorSet_Create_0(Vk* p_vk, const VkDescriptorSetLayout
     TRACK(VkDescriptorSet* p_desc_sets = alloc(NULL, desc_set_layouts_count * sizeof(VkDescriptorSet)));
     VERIFY(p_desc_sets, "Descriptor sets allocation failed");
 
-    for (size_t set = 0; set < desc_set_layouts_count; ++set) {
-        printf("set %d\n", set);
-        VkDescriptorSetAllocateInfo alloc_info = {
-            .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-            .descriptorPool     = p_vk->descriptor_pool,
-            .descriptorSetCount = 1,
-            .pSetLayouts        = &p_desc_set_layout[set]
-        };
-        TRACK(VkResult result = vkAllocateDescriptorSets(p_vk->device, &alloc_info, &p_desc_sets[set]));
-        VERIFY(result == VK_SUCCESS, "Failed to allocate descriptor set. result = %d", result);
-    }
+    TRACK(VkDescriptorPool pool = AllocateSets(p_vk, p_desc_set_layout, desc_set_layouts_count, p_desc_sets));
+    if (p_pool) *p_pool = pool;
 
     TRACK(VkWriteDescriptorSet* desc_writes = alloc(NULL, desc_set_layouts_count * sizeof(VkWriteDescriptorSet)));
     VERIFY(desc_writes, "Descriptor writes allocation failed");
 
+    // without a buffer set 0 stays empty, the shaders take their per-draw data from push constants
+    unsigned int first_write = buffer == VK_NULL_HANDLE ? 1 : 0;
     desc_writes[0] = (VkWriteDescriptorSet){
         .sType              = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
         .dstSet             = p_desc_sets[0],
@@ -218,8 +259,11 @@ VkDescriptorSet* vk_DescriptorSet_Create_0(Vk* p_vk, const VkDescriptorSetLayout
         },
     };
 
-    for (size_t set = 0; set < desc_set_layouts_count; ++set) {
+    // the texture table already holds the image, registered when it was created
+    size_t writes_count = desc_set_layouts_count > 1 && p_desc_sets[1] == p_vk->texture_table.set ? 1 : desc_set_layouts_count;
+    for (size_t set = first_write; set < writes_count; ++set) {
         TRACK(vkUpdateDescriptorSets(p_vk->device, 1, &desc_writes[set], 0, NULL));
     }
+    free(desc_writes);
     return p_desc_sets;
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "vk.h"
+
+// Descriptors per set of a layout vk_DescriptorAllocator_AddLayout has seen, NULL for any other
+static const Vk_DescriptorLayoutSizes* FindLayout(Vk* p_vk, VkDescriptorSetLayout layout) {
+    for (size_t i = 0; i < p_vk->layout_sizes_count; ++i) {
+        if (p_vk->p_layout_sizes[i].layout == layout) {
+            return &p_vk->p_layout_sizes[i];
+        }
+    }
+    return NULL;
+}
+
+// Averages the descriptors per set allocated so far over the pool's sets, and never gives less than the
+// allocation the pool is created for. Transient pools cannot free single sets.
+static VkDescriptorPool CreatePool(Vk* p_vk, Vk_DescriptorAllocator* p_allocator, unsigned int request_sets, const uint64_t* p_request_counts) {
+    unsigned int sets = p_allocator->next_pool_sets < request_sets ? request_sets : p_allocator->next_pool_sets;
+    VkDescriptorPoolSize sizes[VK_DESCRIPTOR_TYPES];
+    unsigned int sizes_count = 0;
+    for (unsigned int type = 0; type < VK_DESCRIPTOR_TYPES; ++type) {
+        uint64_t count = (p_allocator->descriptors_allocated[type] * sets + p_allocator->sets_allocated - 1) / p_allocator->sets_allocated;
+        count = count < p_request_counts[type] ? p_request_counts[type] : count;
+        if (count > 0) {
+            sizes[sizes_count++] = (VkDescriptorPoolSize){ .type = (VkDescriptorType)type, .descriptorCount = (uint32_t)count };
+        }
+    }
+    // sets of empty layouts take no descriptors, but a pool needs one size
+    if (sizes_count == 0) {
+        sizes[sizes_count++] = (VkDescriptorPoolSize){ .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1 };
+    }
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags         = p_allocator->transient ? 0 : VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+        .maxSets       = sets,
+        .poolSizeCount = sizes_count,
+        .pPoolSizes    = sizes,
+    };
+    VkDescriptorPool pool;
+    TRACK(VkResult result = vkCreateDescriptorPool(p_vk->device, &pool_info, NULL, &pool));
+    VERIFY(result == VK_SUCCESS, "Failed to create descriptor pool\n");
+
+    if (p_allocator->pools_count == p_allocator->pools_capacity) {
+        p_allocator->pools_capacity = p_allocator->pools_capacity ? p_allocator->pools_capacity * 2 : 4;
+        p_allocator->p_pools = alloc(p_allocator->p_pools, p_allocator->pools_capacity * sizeof(VkDescriptorPool));
+    }
+    // the first pool that ran out moves to the end, the new one joins the pools with room
+    p_allocator->p_pools[p_allocator->pools_count++] = p_allocator->p_pools[p_allocator->ready_count];
+    p_allocator->p_pools[p_allocator->ready_count++] = pool;
+    p_allocator->next_pool_sets = sets * 2 < VK_DESCRIPTOR_POOL_MAX_SETS ? sets * 2 : VK_DESCRIPTOR_POOL_MAX_SETS;
+    printf("Descriptor pool %u of %u sets created, %s\n", p_allocator->pools_count, sets, p_allocator->transient ? "transient" : "persistent");
+    return pool;
+}
+
+// Pools are only created once sets are allocated from them
+Vk_DescriptorAllocator vk_DescriptorAllocator_Create(bool transient) {
+    Vk_DescriptorAllocator allocator;
+    memset(&allocator, 0, sizeof(Vk_DescriptorAllocator));
+    allocator.transient = transient;
+    allocator.next_pool_sets = VK_DESCRIPTOR_POOL_MIN_SETS;
+    return allocator;
+}
+
+// One set per layout, all from the pool that is returned, which frees them again. The pools that run out
+// are set aside and a new one is created when none has room left.
+VkDescriptorPool vk_DescriptorAllocator_Allocate(Vk* p_vk, Vk_DescriptorAllocator* p_allocator, const VkDescriptorSetLayout* p_layouts, unsigned int layouts_count, VkDescriptorSet* p_sets) {
+    VERIFY(p_vk && p_allocator && p_layouts && p_sets, "NULL pointer");
+    VERIFY(layouts_count > 0 && layouts_count <= VK_DESCRIPTOR_POOL_MAX_SETS, "allocating %u descriptor sets at once", layouts_count);
+
+    uint64_t request_counts[VK_DESCRIPTOR_TYPES] = {0};
+    for (unsigned int i = 0; i < layouts_count; ++i) {
+        VERIFY(p_layouts[i] != VK_NULL_HANDLE, "Invalid VkDescriptorSetLayout handle for set %u", i);
+        const Vk_DescriptorLayoutSizes* p_sizes = FindLayout(p_vk, p_layouts[i]);
+        for (unsigned int type = 0; p_sizes && type < VK_DESCRIPTOR_TYPES; ++type) {
+            request_counts[type] += p_sizes->counts[type];
+        }
+    }
+    p_allocator->sets_allocated += layouts_count;
+    p_allocator->sets_since_reset += layouts_count;
+    for (unsigned int type = 0; type < VK_DESCRIPTOR_TYPES; ++type) {
+        p_allocator->descriptors_allocated[type] += request_counts[type];
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorSetCount = layouts_count,
+        .pSetLayouts        = p_layouts,
+    };
+    VkResult result;
+    while (p_allocator->ready_count > 0) {
+        alloc_info.descriptorPool = p_allocator->p_pools[p_allocator->ready_count - 1];
+        TRACK(result = vkAllocateDescriptorSets(p_vk->device, &alloc_info, p_sets));
+        if (result == VK_SUCCESS) {
+            return alloc_info.descriptorPool;
+        }
+        VERIFY(result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL, "Failed to allocate descriptor sets. result = %d", result);
+        p_allocator->ready_count--;
+    }
+
+    TRACK(alloc_info.descriptorPool = CreatePool(p_vk, p_allocator, layouts_count, request_counts));
+    TRACK(result = vkAllocateDescriptorSets(p_vk->device, &alloc_info, p_sets));
+    VERIFY(result == VK_SUCCESS, "Failed to allocate descriptor sets from a new pool. result = %d", result);
+    return alloc_info.descriptorPool;
+}
+
+// Persistent sets only, their pool has room again afterwards
+void vk_DescriptorAllocator_Free(Vk* p_vk, Vk_DescriptorAllocator* p_allocator, VkDescriptorPool pool, const VkDescriptorSet* p_sets, unsigned int sets_count) {
+    VERIFY(p_vk && p_allocator && p_sets, "NULL pointer");
+    VERIFY(!p_allocator->transient, "transient descriptor sets are only freed by vk_DescriptorAllocator_Reset");
+    TRACK(VkResult result = vkFreeDescriptorSets(p_vk->device, pool, sets_count, p_sets));
+    VERIFY(result == VK_SUCCESS, "Failed to free descriptor set");
+    for (unsigned int i = p_allocator->ready_count; i < p_allocator->pools_count; ++i) {
+        if (p_allocator->p_pools[i] == pool) {
+            p_allocator->p_pools[i] = p_allocator->p_pools[p_allocator->ready_count];
+            p_allocator->p_pools[p_allocator->ready_count++] = pool;
+            break;
+        }
+    }
+}
+
+// Frees every set allocated since the last reset, each pool in one call. When that took several pools
+// and one pool can hold it, they are replaced by a single pool sized for it.
+void vk_DescriptorAllocator_Reset(Vk* p_vk, Vk_DescriptorAllocator* p_allocator) {
+    VERIFY(p_vk && p_allocator, "NULL pointer");
+    VERIFY(p_allocator->transient, "persistent descriptor sets are freed one at a time");
+    unsigned int sets = p_allocator->sets_since_reset + p_allocator->sets_since_reset / 4;
+    if (p_allocator->pools_count > 1 && sets <= VK_DESCRIPTOR_POOL_MAX_SETS) {
+        for (unsigned int i = 0; i < p_allocator->pools_count; ++i) {
+            TRACK(vkDestroyDescriptorPool(p_vk->device, p_allocator->p_pools[i], NULL));
+        }
+        p_allocator->pools_count = 0;
+        p_allocator->next_pool_sets = sets < VK_DESCRIPTOR_POOL_MIN_SETS ? VK_DESCRIPTOR_POOL_MIN_SETS : sets;
+    }
+    for (unsigned int i = 0; i < p_allocator->pools_count; ++i) {
+        TRACK(VkResult result = vkResetDescriptorPool(p_vk->device, p_allocator->p_pools[i], 0));
+        VERIFY(result == VK_SUCCESS, "Failed to reset descriptor pool\n");
+    }
+    p_allocator->ready_count = p_allocator->pools_count;
+    p_allocator->sets_since_reset = 0;
+}
+
+// Destroying the pools frees every set allocated from them, call once the GPU is done with them
+void vk_DescriptorAllocator_Destroy(Vk* p_vk, Vk_DescriptorAllocator* p_allocator) {
+    VERIFY(p_vk && p_allocator, "NULL pointer");
+    for (unsigned int i = 0; i < p_allocator->pools_count; ++i) {
+        TRACK(vkDestroyDescriptorPool(p_vk->device, p_allocator->p_pools[i], NULL));
+    }
+    if (p_allocator->p_pools) free(p_allocator->p_pools);
+    memset(p_allocator, 0, sizeof(Vk_DescriptorAllocator));
+}
+
+void vk_DescriptorAllocator_AddLayout(Vk* p_vk, VkDescriptorSetLayout layout, const VkDescriptorSetLayoutCreateInfo* p_create_info) {
+    VERIFY(p_vk && p_create_info, "NULL pointer");
+    if (p_vk->layout_sizes_count == p_vk->layout_sizes_capacity) {
+        p_vk->layout_sizes_capacity = p_vk->layout_sizes_capacity ? p_vk->layout_sizes_capacity * 2 : 16;
+        p_vk->p_layout_sizes = alloc(p_vk->p_layout_sizes, p_vk->layout_sizes_capacity * sizeof(Vk_DescriptorLayoutSizes));
+    }
+    Vk_DescriptorLayoutSizes* p_sizes = &p_vk->p_layout_sizes[p_vk->layout_sizes_count++];
+    memset(p_sizes, 0, sizeof(Vk_DescriptorLayoutSizes));
+    p_sizes->layout = layout;
+    for (unsigned int i = 0; i < p_create_info->bindingCount; ++i) {
+        VkDescriptorType type = p_create_info->pBindings[i].descriptorType;
+        VERIFY((unsigned int)type < VK_DESCRIPTOR_TYPES, "descriptor type %d is not counted by the descriptor allocator", (int)type);
+        p_sizes->counts[type] += p_create_info->pBindings[i].descriptorCount;
+    }
+}
+
+// The handle may be reused for another layout once it is destroyed
+void vk_DescriptorAllocator_RemoveLayout(Vk* p_vk, VkDescriptorSetLayout layout) {
+    VERIFY(p_vk, "NULL pointer");
+    for (size_t i = 0; i < p_vk->layout_sizes_count; ++i) {
+        if (p_vk->p_layout_sizes[i].layout == layout) {
+            p_vk->p_layout_sizes[i] = p_vk->p_layout_sizes[--p_vk->layout_sizes_count];
+            return;
+        }
+    }
+}
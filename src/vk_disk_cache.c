@@ -0,0 +1,108 @@
+#include "vk.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// mkdir -p, an existing directory is fine
+static bool MakeDirectories(const char* p_dir) {
+    char path[VK_CACHE_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s", p_dir);
+    for (char* p = path + 1; ; ++p) {
+        if (*p != '/' && *p != '\0') {
+            continue;
+        }
+        char c = *p;
+        *p = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if (c == '\0') {
+            return true;
+        }
+        *p = c;
+    }
+}
+
+// LOGOS_CACHE_DIR, else $XDG_CACHE_HOME/logos, else ~/.cache/logos, else the working directory.
+// p_subdir may be NULL, the directory is created when missing.
+bool vk_DiskCache_Directory(const char* p_subdir, char* p_dir, size_t size) {
+    VERIFY(p_dir, "NULL pointer");
+    const char* p_env = getenv("LOGOS_CACHE_DIR");
+    if (p_env && p_env[0]) {
+        snprintf(p_dir, size, "%s", p_env);
+    } else if ((p_env = getenv("XDG_CACHE_HOME")) && p_env[0]) {
+        snprintf(p_dir, size, "%s/logos", p_env);
+    } else if ((p_env = getenv("HOME")) && p_env[0]) {
+        snprintf(p_dir, size, "%s/.cache/logos", p_env);
+    } else {
+        snprintf(p_dir, size, ".");
+    }
+    if (p_subdir) {
+        size_t length = strlen(p_dir);
+        snprintf(&p_dir[length], size - length, "/%s", p_subdir);
+    }
+    if (!MakeDirectories(p_dir)) {
+        printf("Warning: cannot create cache directory %s\n", p_dir);
+        return false;
+    }
+    return true;
+}
+
+// The whole file or NULL, the caller frees it
+void* vk_DiskCache_Read(const char* p_path, size_t* p_size) {
+    VERIFY(p_path && p_size, "NULL pointer");
+    *p_size = 0;
+    FILE* p_file = fopen(p_path, "rb");
+    if (!p_file) {
+        return NULL;
+    }
+    fseek(p_file, 0, SEEK_END);
+    long file_size = ftell(p_file);
+    fseek(p_file, 0, SEEK_SET);
+    void* p_data = NULL;
+    if (file_size > 0) {
+        p_data = alloc(NULL, (size_t)file_size);
+        if (fread(p_data, 1, (size_t)file_size, p_file) == (size_t)file_size) {
+            *p_size = (size_t)file_size;
+        } else {
+            free(p_data);
+            p_data = NULL;
+        }
+    }
+    fclose(p_file);
+    return p_data;
+}
+
+// Readers never see a partial file: the data goes to a temporary file in the same directory first and
+// rename() replaces the old one atomically. Processes and threads writing the same path each use their
+// own temporary file, the last rename wins and every version is complete.
+bool vk_DiskCache_WriteAtomic(const char* p_path, const void* p_data, size_t size) {
+    VERIFY(p_path && (p_data || size == 0), "NULL pointer");
+    static unsigned int tmp_counter = 0;
+
+    char tmp_path[VK_CACHE_PATH_SIZE + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.%u.tmp", p_path, (int)getpid(), __atomic_fetch_add(&tmp_counter, 1, __ATOMIC_RELAXED));
+    FILE* p_file = fopen(tmp_path, "wb");
+    bool written = p_file && fwrite(p_data, 1, size, p_file) == size;
+    if (p_file) {
+        written = fflush(p_file) == 0 && fsync(fileno(p_file)) == 0 && written;
+        written = fclose(p_file) == 0 && written;
+    }
+    if (!written || rename(tmp_path, p_path) != 0) {
+        printf("Warning: failed to write %s\n", p_path);
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+// 64 bit FNV-1a, chain calls by passing the previous result, start with VK_FNV1A64_INIT
+uint64_t vk_Hash_Fnv1a64(uint64_t hash, const void* p_data, size_t size) {
+    const unsigned char* p_bytes = p_data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p_bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,504 @@
+#include "vk.h"
+
+#define STAGING_ALIGNMENT    16
+#define STAGING_MIN_CAPACITY (64 * 1024)
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void BeginCommandBuffer(VkCommandBuffer command_buffer) {
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    TRACK(VkResult result = vkBeginCommandBuffer(command_buffer, &begin_info));
+    VERIFY(result == VK_SUCCESS, "Failed to begin frame command buffer\n");
+}
+
+static void GlobalBarrier(VkCommandBuffer command_buffer, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access) {
+    Vk_BarrierBatch barriers = {0};
+    vk_Barrier_AddMemory(&barriers, src_stage, src_access, dst_stage, dst_access);
+    TRACK(vk_Barrier_Flush(&barriers, command_buffer));
+}
+
+// Returns the upload command buffer, ordered after earlier transfer writes that overlap the given range
+static VkCommandBuffer UploadCommandBuffer(Vk_FrameSubmit* p_frame, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+    if (!p_frame->upload_recording) {
+        BeginCommandBuffer(p_frame->upload_command_buffer);
+        p_frame->upload_recording = true;
+    }
+
+    for (size_t i = 0; i < p_frame->written_count; ++i) {
+        const Vk_BufferRange* p_range = &p_frame->p_written[i];
+        if (p_range->buffer == buffer && offset < p_range->offset + p_range->size && p_range->offset < offset + size) {
+            GlobalBarrier(p_frame->upload_command_buffer,
+                VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+            p_frame->written_count = 0;
+            break;
+        }
+    }
+
+    if (p_frame->written_count == p_frame->written_capacity) {
+        p_frame->written_capacity = p_frame->written_capacity ? p_frame->written_capacity * 2 : 16;
+        p_frame->p_written = alloc(p_frame->p_written, sizeof(Vk_BufferRange) * p_frame->written_capacity);
+    }
+    p_frame->p_written[p_frame->written_count++] = (Vk_BufferRange){ .buffer = buffer, .offset = offset, .size = size };
+
+    return p_frame->upload_command_buffer;
+}
+
+static bool BatchIsEmpty(const Vk_SubmitBatch* p_batch) {
+    return p_batch->command_buffers_count == 0 && p_batch->waits_count == 0 && p_batch->signals_count == 0;
+}
+
+static VkSubmitInfo2 BatchSubmitInfo(const Vk_SubmitBatch* p_batch) {
+    return (VkSubmitInfo2){
+        .sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .waitSemaphoreInfoCount   = p_batch->waits_count,
+        .pWaitSemaphoreInfos      = p_batch->waits,
+        .commandBufferInfoCount   = p_batch->command_buffers_count,
+        .pCommandBufferInfos      = p_batch->command_buffers,
+        .signalSemaphoreInfoCount = p_batch->signals_count,
+        .pSignalSemaphoreInfos    = p_batch->signals,
+    };
+}
+
+static void AddToBatch(Vk_FrameSubmit* p_frame, Vk_FrameStage stage, VkCommandBuffer command_buffer) {
+    Vk_SubmitBatch* p_batch = &p_frame->batches[stage];
+    VERIFY(p_batch->command_buffers_count < VK_FRAME_SUBMIT_MAX_COMMAND_BUFFERS, "too many command buffers in frame stage %d", (int)stage);
+    p_batch->command_buffers[p_batch->command_buffers_count++] = (VkCommandBufferSubmitInfo){
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .commandBuffer = command_buffer,
+    };
+}
+
+Vk_FrameSubmit Vk_FrameSubmit_Create(Vk* p_vk, VkQueue queue, unsigned int queue_family) {
+    VERIFY(p_vk, "NULL pointer");
+    VERIFY(queue != VK_NULL_HANDLE, "queue is VK_NULL_HANDLE");
+
+    Vk_FrameSubmit frame = {0};
+    frame.p_vk = p_vk;
+    frame.queue = queue;
+
+    VkCommandPoolCreateInfo pool_info = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = queue_family,
+        .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+    };
+    TRACK(VkResult result = vkCreateCommandPool(p_vk->device, &pool_info, NULL, &frame.command_pool));
+    VERIFY(result == VK_SUCCESS, "Failed to create frame command pool\n");
+
+    // all are reused every frame, resetting the pool returns them to the initial state
+    VkCommandBuffer command_buffers[3];
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool        = frame.command_pool,
+        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 3,
+    };
+    TRACK(result = vkAllocateCommandBuffers(p_vk->device, &alloc_info, command_buffers));
+    VERIFY(result == VK_SUCCESS, "Failed to allocate frame command buffers\n");
+    frame.upload_command_buffer = command_buffers[0];
+    frame.readback_command_buffer = command_buffers[1];
+    frame.render_command_buffer = command_buffers[2];
+    frame.descriptors = vk_DescriptorAllocator_Create(true);
+
+    // compute only overlaps graphics on a queue of its own, and ordering across queues takes a timeline semaphore
+    frame.async_compute = p_vk->caps.timeline_semaphore &&
+                          p_vk->queue_family_indices.compute != queue_family &&
+                          p_vk->queues.compute != VK_NULL_HANDLE && p_vk->queues.compute != queue;
+    frame.compute_queue = frame.async_compute ? p_vk->queues.compute : queue;
+    frame.compute_queue_family = frame.async_compute ? p_vk->queue_family_indices.compute : queue_family;
+
+    pool_info.queueFamilyIndex = frame.compute_queue_family;
+    TRACK(result = vkCreateCommandPool(p_vk->device, &pool_info, NULL, &frame.compute_command_pool));
+    VERIFY(result == VK_SUCCESS, "Failed to create frame compute command pool\n");
+    alloc_info.commandPool = frame.compute_command_pool;
+    alloc_info.commandBufferCount = 1;
+    TRACK(result = vkAllocateCommandBuffers(p_vk->device, &alloc_info, &frame.compute_command_buffer));
+    VERIFY(result == VK_SUCCESS, "Failed to allocate frame compute command buffer\n");
+
+    if (frame.async_compute) {
+        VkSemaphoreTypeCreateInfo type_info = {
+            .sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue  = 0,
+        };
+        VkSemaphoreCreateInfo semaphore_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &type_info,
+        };
+        TRACK(result = vkCreateSemaphore(p_vk->device, &semaphore_info, NULL, &frame.timeline));
+        VERIFY(result == VK_SUCCESS, "Failed to create frame timeline semaphore\n");
+    }
+    printf("Frame compute stage runs on the %s queue\n", frame.async_compute ? "async compute" : "graphics");
+
+    return frame;
+}
+
+// Call once the previous flush has completed, i.e. after waiting on its fence
+void Vk_FrameSubmit_Begin(Vk_FrameSubmit* p_frame) {
+    VERIFY(p_frame, "NULL pointer");
+    VERIFY(!p_frame->upload_recording && !p_frame->readback_recording && !p_frame->compute_recording && !p_frame->render_recording, "frame was not flushed");
+    Vk* p_vk = p_frame->p_vk;
+
+    for (size_t i = 0; i < p_frame->readbacks_count; ++i) {
+        Vk_Readback* p_readback = &p_frame->p_readbacks[i];
+        void* p_data = NULL;
+        TRACK(VkResult result = vmaInvalidateAllocation(p_vk->allocator, p_readback->staging.allocation, 0, VK_WHOLE_SIZE));
+        VERIFY(result == VK_SUCCESS, "Failed to invalidate readback memory\n");
+        TRACK(result = vmaMapMemory(p_vk->allocator, p_readback->staging.allocation, &p_data));
+        VERIFY(result == VK_SUCCESS && p_data, "Failed to map readback memory\n");
+        memcpy(p_readback->p_dst, p_data, p_readback->size);
+        vmaUnmapMemory(p_vk->allocator, p_readback->staging.allocation);
+        TRACK(vmaDestroyBuffer(p_vk->allocator, p_readback->staging.buffer, p_readback->staging.allocation));
+    }
+    p_frame->readbacks_count = 0;
+
+    for (size_t i = 0; i < p_frame->retired_staging_count; ++i) {
+        TRACK(vmaDestroyBuffer(p_vk->allocator, p_frame->p_retired_staging[i].buffer, p_frame->p_retired_staging[i].allocation));
+    }
+    p_frame->retired_staging_count = 0;
+    p_frame->staging_offset = 0;
+    p_frame->written_count = 0;
+
+    // the fence only covers the graphics queue, the previous compute submission may still be running
+    if (p_frame->async_compute && p_frame->compute_value > 0) {
+        VkSemaphoreWaitInfo wait_info = {
+            .sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores    = &p_frame->timeline,
+            .pValues        = &p_frame->compute_value,
+        };
+        TRACK(VkResult result = vkWaitSemaphores(p_vk->device, &wait_info, UINT64_MAX));
+        VERIFY(result == VK_SUCCESS, "Failed to wait for the frame compute work: %d\n", result);
+    }
+
+    TRACK(VkResult result = vkResetCommandPool(p_vk->device, p_frame->command_pool, 0));
+    VERIFY(result == VK_SUCCESS, "Failed to reset frame command pool\n");
+    TRACK(result = vkResetCommandPool(p_vk->device, p_frame->compute_command_pool, 0));
+    VERIFY(result == VK_SUCCESS, "Failed to reset frame compute command pool\n");
+    // both queues are done with the previous frame, so are its descriptor sets
+    TRACK(vk_DescriptorAllocator_Reset(p_vk, &p_frame->descriptors));
+    memset(p_frame->batches, 0, sizeof(p_frame->batches));
+}
+
+void Vk_FrameSubmit_UploadBuffer(Vk_FrameSubmit* p_frame, Buffer dst_buffer, VkDeviceSize dst_offset, const void* p_src_data, VkDeviceSize size) {
+    if (size == 0) {
+        return;
+    }
+    VERIFY(p_frame, "NULL pointer");
+    VERIFY(p_src_data, "given p_src_data is NULL\n");
+    VERIFY(dst_buffer.size >= dst_offset + size, "Writing to buffer will go out of bounds\n");
+    Vk* p_vk = p_frame->p_vk;
+    void* p_data = NULL;
+
+    // Host-preferred buffers are written in place, which is only safe while no other frame can be reading them.
+    // With more frames in flight they go through the staging arena like device-local ones.
+    if (dst_buffer.usage == VMA_MEMORY_USAGE_AUTO_PREFER_HOST && VK_FRAMES_IN_FLIGHT == 1) {
+        TRACK(VkResult result = vmaMapMemory(p_vk->allocator, dst_buffer.allocation, &p_data));
+        VERIFY(result == VK_SUCCESS && p_data, "Failed to map buffer memory!\n");
+        memcpy((uint8_t*)p_data + dst_offset, p_src_data, size);
+        vmaUnmapMemory(p_vk->allocator, dst_buffer.allocation);
+        TRACK(vmaFlushAllocation(p_vk->allocator, dst_buffer.allocation, dst_offset, size));
+        return;
+    }
+
+    VkDeviceSize staging_offset = AlignUp(p_frame->staging_offset, STAGING_ALIGNMENT);
+    if (p_frame->staging.buffer == VK_NULL_HANDLE || staging_offset + size > p_frame->staging.size) {
+        if (p_frame->staging.buffer != VK_NULL_HANDLE) {
+            if (p_frame->retired_staging_count == p_frame->retired_staging_capacity) {
+                p_frame->retired_staging_capacity = p_frame->retired_staging_capacity ? p_frame->retired_staging_capacity * 2 : 4;
+                p_frame->p_retired_staging = alloc(p_frame->p_retired_staging, sizeof(Buffer) * p_frame->retired_staging_capacity);
+            }
+            p_frame->p_retired_staging[p_frame->retired_staging_count++] = p_frame->staging;
+        }
+        VkDeviceSize capacity = p_frame->staging.size ? p_frame->staging.size * 2 : STAGING_MIN_CAPACITY;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+        p_frame->staging = vk_Buffer_Create(p_vk, capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+        staging_offset = 0;
+    }
+
+    TRACK(VkResult result = vmaMapMemory(p_vk->allocator, p_frame->staging.allocation, &p_data));
+    VERIFY(result == VK_SUCCESS && p_data, "Failed to map staging buffer memory!\n");
+    memcpy((uint8_t*)p_data + staging_offset, p_src_data, size);
+    vmaUnmapMemory(p_vk->allocator, p_frame->staging.allocation);
+    TRACK(vmaFlushAllocation(p_vk->allocator, p_frame->staging.allocation, staging_offset, size));
+    p_frame->staging_offset = staging_offset + size;
+
+    VkCommandBuffer command_buffer = UploadCommandBuffer(p_frame, dst_buffer.buffer, dst_offset, size);
+    VkBufferCopy copy_region = {
+        .srcOffset = staging_offset,
+        .dstOffset = dst_offset,
+        .size = size,
+    };
+    TRACK(vkCmdCopyBuffer(command_buffer, p_frame->staging.buffer, dst_buffer.buffer, 1, &copy_region));
+}
+
+void Vk_FrameSubmit_ClearBuffer(Vk_FrameSubmit* p_frame, Buffer dst_buffer, int clear_value) {
+    VERIFY(p_frame, "NULL pointer");
+    Vk* p_vk = p_frame->p_vk;
+
+    // in place for the same reason as in Vk_FrameSubmit_UploadBuffer
+    if (dst_buffer.usage == VMA_MEMORY_USAGE_AUTO_PREFER_HOST && VK_FRAMES_IN_FLIGHT == 1) {
+        void* p_data = NULL;
+        TRACK(VkResult result = vmaMapMemory(p_vk->allocator, dst_buffer.allocation, &p_data));
+        VERIFY(result == VK_SUCCESS && p_data, "Failed to map buffer memory!\n");
+        memset(p_data, clear_value, dst_buffer.size);
+        vmaUnmapMemory(p_vk->allocator, dst_buffer.allocation);
+        TRACK(vmaFlushAllocation(p_vk->allocator, dst_buffer.allocation, 0, dst_buffer.size));
+        return;
+    }
+
+    // vkCmdFillBuffer writes words, so the byte is repeated like memset would
+    VERIFY(dst_buffer.size % 4 == 0, "buffer size must be a multiple of 4 to be cleared on the device\n");
+    uint32_t word = (uint32_t)(unsigned char)clear_value * 0x01010101u;
+    VkCommandBuffer command_buffer = UploadCommandBuffer(p_frame, dst_buffer.buffer, 0, dst_buffer.size);
+    TRACK(vkCmdFillBuffer(command_buffer, dst_buffer.buffer, 0, dst_buffer.size, word));
+}
+
+// p_dst_data is written in the Vk_FrameSubmit_Begin that follows the flush of this frame
+void Vk_FrameSubmit_ReadbackBuffer(Vk_FrameSubmit* p_frame, Buffer src_buffer, VkDeviceSize src_offset, void* p_dst_data, VkDeviceSize size) {
+    if (size == 0) {
+        return;
+    }
+    VERIFY(p_frame, "NULL pointer");
+    VERIFY(p_dst_data, "given p_dst_data is NULL\n");
+    VERIFY(src_buffer.size >= src_offset + size, "Reading from buffer will go out of bounds\n");
+    Vk* p_vk = p_frame->p_vk;
+
+    Vk_Readback readback = { .p_dst = p_dst_data, .size = size };
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+    VmaAllocationCreateInfo alloc_info = {
+        .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+        .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+    };
+    TRACK(VkResult result = vmaCreateBuffer(p_vk->allocator, &buffer_info, &alloc_info, &readback.staging.buffer, &readback.staging.allocation, NULL));
+    VERIFY(result == VK_SUCCESS, "Failed to create readback buffer\n");
+    readback.staging.size = size;
+    readback.staging.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+
+    if (!p_frame->readback_recording) {
+        BeginCommandBuffer(p_frame->readback_command_buffer);
+        p_frame->readback_recording = true;
+        // everything submitted before this batch may have written what is read back
+        GlobalBarrier(p_frame->readback_command_buffer,
+            VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+    }
+    VkBufferCopy copy_region = {
+        .srcOffset = src_offset,
+        .dstOffset = 0,
+        .size = size,
+    };
+    TRACK(vkCmdCopyBuffer(p_frame->readback_command_buffer, src_buffer.buffer, readback.staging.buffer, 1, &copy_region));
+
+    if (p_frame->readbacks_count == p_frame->readbacks_capacity) {
+        p_frame->readbacks_capacity = p_frame->readbacks_capacity ? p_frame->readbacks_capacity * 2 : 4;
+        p_frame->p_readbacks = alloc(p_frame->p_readbacks, sizeof(Vk_Readback) * p_frame->readbacks_capacity);
+    }
+    p_frame->p_readbacks[p_frame->readbacks_count++] = readback;
+}
+
+// Returns the frame's compute command buffer, recording. It belongs to compute_queue_family and is
+// submitted in the compute stage, on the async compute queue when there is one. The render stage of the
+// same frame waits for it either way, so its results need no second buffer.
+VkCommandBuffer Vk_FrameSubmit_ComputeCommandBuffer(Vk_FrameSubmit* p_frame) {
+    VERIFY(p_frame, "NULL pointer");
+    if (!p_frame->compute_recording) {
+        BeginCommandBuffer(p_frame->compute_command_buffer);
+        p_frame->compute_recording = true;
+    }
+    return p_frame->compute_command_buffer;
+}
+
+// Returns the frame's render command buffer, recording. It is submitted in the render stage after the
+// command buffers added to that stage, so it suits commands recorded anew every frame.
+VkCommandBuffer Vk_FrameSubmit_RenderCommandBuffer(Vk_FrameSubmit* p_frame) {
+    VERIFY(p_frame, "NULL pointer");
+    if (!p_frame->render_recording) {
+        BeginCommandBuffer(p_frame->render_command_buffer);
+        p_frame->render_recording = true;
+    }
+    return p_frame->render_command_buffer;
+}
+
+// The set is valid until the next Vk_FrameSubmit_Begin, for data that changes every frame
+VkDescriptorSet Vk_FrameSubmit_AllocateDescriptorSet(Vk_FrameSubmit* p_frame, VkDescriptorSetLayout layout) {
+    VERIFY(p_frame, "NULL pointer");
+    VkDescriptorSet set;
+    TRACK(vk_DescriptorAllocator_Allocate(p_frame->p_vk, &p_frame->descriptors, &layout, 1, &set));
+    return set;
+}
+
+void Vk_FrameSubmit_AddCommandBuffer(Vk_FrameSubmit* p_frame, Vk_FrameStage stage, VkCommandBuffer command_buffer) {
+    VERIFY(p_frame, "NULL pointer");
+    VERIFY(stage < VK_FRAME_STAGE_COUNT, "invalid frame stage %d", (int)stage);
+    VERIFY(command_buffer != VK_NULL_HANDLE, "command_buffer is VK_NULL_HANDLE");
+    AddToBatch(p_frame, stage, command_buffer);
+}
+
+void Vk_FrameSubmit_AddWait(Vk_FrameSubmit* p_frame, Vk_FrameStage stage, VkSemaphore semaphore, VkPipelineStageFlags2 stage_mask, uint64_t value) {
+    VERIFY(p_frame, "NULL pointer");
+    VERIFY(stage < VK_FRAME_STAGE_COUNT, "invalid frame stage %d", (int)stage);
+    Vk_SubmitBatch* p_batch = &p_frame->batches[stage];
+    VERIFY(p_batch->waits_count < VK_FRAME_SUBMIT_MAX_SEMAPHORES, "too many wait semaphores in frame stage %d", (int)stage);
+    p_batch->waits[p_batch->waits_count++] = (VkSemaphoreSubmitInfo){
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = semaphore,
+        .value = value,
+        .stageMask = stage_mask,
+    };
+}
+
+void Vk_FrameSubmit_AddSignal(Vk_FrameSubmit* p_frame, Vk_FrameStage stage, VkSemaphore semaphore, VkPipelineStageFlags2 stage_mask, uint64_t value) {
+    VERIFY(p_frame, "NULL pointer");
+    VERIFY(stage < VK_FRAME_STAGE_COUNT, "invalid frame stage %d", (int)stage);
+    Vk_SubmitBatch* p_batch = &p_frame->batches[stage];
+    VERIFY(p_batch->signals_count < VK_FRAME_SUBMIT_MAX_SEMAPHORES, "too many signal semaphores in frame stage %d", (int)stage);
+    p_batch->signals[p_batch->signals_count++] = (VkSemaphoreSubmitInfo){
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = semaphore,
+        .value = value,
+        .stageMask = stage_mask,
+    };
+}
+
+// Submits every stage of the frame with a single vkQueueSubmit2, in Vk_FrameStage order. With async compute
+// the upload, compute and remaining stages are three submissions on the timeline semaphore, one value per
+// stage: compute waits on the uploads, render and readbacks on the compute. Render consumes this frame's
+// compute results on either path, the compute queue only overlaps the uploads and other queues' work.
+void Vk_FrameSubmit_Flush(Vk_FrameSubmit* p_frame, VkFence fence) {
+    VERIFY(p_frame, "NULL pointer");
+
+    if (p_frame->upload_recording) {
+        // uploads feed anything that runs later in the frame
+        GlobalBarrier(p_frame->upload_command_buffer,
+            VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+            VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT |
+            VK_ACCESS_2_UNIFORM_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
+        TRACK(VkResult result = vkEndCommandBuffer(p_frame->upload_command_buffer));
+        VERIFY(result == VK_SUCCESS, "Failed to end upload command buffer\n");
+        AddToBatch(p_frame, VK_FRAME_STAGE_UPLOAD, p_frame->upload_command_buffer);
+        p_frame->upload_recording = false;
+    }
+    if (p_frame->readback_recording) {
+        GlobalBarrier(p_frame->readback_command_buffer,
+            VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+        TRACK(VkResult result = vkEndCommandBuffer(p_frame->readback_command_buffer));
+        VERIFY(result == VK_SUCCESS, "Failed to end readback command buffer\n");
+        AddToBatch(p_frame, VK_FRAME_STAGE_READBACK, p_frame->readback_command_buffer);
+        p_frame->readback_recording = false;
+    }
+    if (p_frame->render_recording) {
+        TRACK(VkResult result = vkEndCommandBuffer(p_frame->render_command_buffer));
+        VERIFY(result == VK_SUCCESS, "Failed to end render command buffer\n");
+        AddToBatch(p_frame, VK_FRAME_STAGE_RENDER, p_frame->render_command_buffer);
+        p_frame->render_recording = false;
+    }
+    // what compute writes is consumed by indirect draws, vertex fetch, shaders and copies
+    const VkPipelineStageFlags2 compute_consumer_stages =
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    if (p_frame->compute_recording) {
+        if (!p_frame->async_compute) {
+            // on the same queue a barrier is enough, across queues the timeline semaphore covers it
+            GlobalBarrier(p_frame->compute_command_buffer,
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                compute_consumer_stages,
+                VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT |
+                VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
+        }
+        TRACK(VkResult result = vkEndCommandBuffer(p_frame->compute_command_buffer));
+        VERIFY(result == VK_SUCCESS, "Failed to end compute command buffer\n");
+        AddToBatch(p_frame, VK_FRAME_STAGE_COMPUTE, p_frame->compute_command_buffer);
+        p_frame->compute_recording = false;
+    }
+
+    unsigned int first_stage = 0;
+    if (p_frame->async_compute && !BatchIsEmpty(&p_frame->batches[VK_FRAME_STAGE_COMPUTE])) {
+        if (!BatchIsEmpty(&p_frame->batches[VK_FRAME_STAGE_UPLOAD])) {
+            uint64_t uploaded = ++p_frame->timeline_value;
+            Vk_FrameSubmit_AddSignal(p_frame, VK_FRAME_STAGE_UPLOAD, p_frame->timeline, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, uploaded);
+            Vk_FrameSubmit_AddWait(p_frame, VK_FRAME_STAGE_COMPUTE, p_frame->timeline,
+                VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, uploaded);
+            VkSubmitInfo2 upload_info = BatchSubmitInfo(&p_frame->batches[VK_FRAME_STAGE_UPLOAD]);
+            TRACK(VkResult result = vkQueueSubmit2(p_frame->queue, 1, &upload_info, VK_NULL_HANDLE));
+            VERIFY(result == VK_SUCCESS, "Failed to submit frame uploads: %d\n", result);
+        }
+
+        uint64_t computed = ++p_frame->timeline_value;
+        Vk_FrameSubmit_AddSignal(p_frame, VK_FRAME_STAGE_COMPUTE, p_frame->timeline, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, computed);
+        VkSubmitInfo2 compute_info = BatchSubmitInfo(&p_frame->batches[VK_FRAME_STAGE_COMPUTE]);
+        TRACK(VkResult result = vkQueueSubmit2(p_frame->compute_queue, 1, &compute_info, VK_NULL_HANDLE));
+        VERIFY(result == VK_SUCCESS, "Failed to submit frame compute work: %d\n", result);
+        p_frame->compute_value = computed;
+
+        // only the stages that consume compute results wait, so render keeps the same frame's data as without async compute
+        Vk_FrameSubmit_AddWait(p_frame, VK_FRAME_STAGE_RENDER, p_frame->timeline, compute_consumer_stages, computed);
+        if (!BatchIsEmpty(&p_frame->batches[VK_FRAME_STAGE_READBACK])) {
+            Vk_FrameSubmit_AddWait(p_frame, VK_FRAME_STAGE_READBACK, p_frame->timeline, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, computed);
+        }
+        first_stage = VK_FRAME_STAGE_COMPUTE + 1;
+    }
+
+    VkSubmitInfo2 submit_infos[VK_FRAME_STAGE_COUNT];
+    unsigned int submit_infos_count = 0;
+    for (unsigned int stage = first_stage; stage < VK_FRAME_STAGE_COUNT; ++stage) {
+        const Vk_SubmitBatch* p_batch = &p_frame->batches[stage];
+        if (BatchIsEmpty(p_batch)) {
+            continue;
+        }
+        submit_infos[submit_infos_count++] = BatchSubmitInfo(p_batch);
+    }
+    if (submit_infos_count == 0 && fence == VK_NULL_HANDLE) {
+        return;
+    }
+
+    TRACK(VkResult result = vkQueueSubmit2(p_frame->queue, submit_infos_count, submit_infos, fence));
+    VERIFY(result == VK_SUCCESS, "Failed to submit frame: %d\n", result);
+}
+
+void Vk_FrameSubmit_Destroy(Vk_FrameSubmit* p_frame) {
+    VERIFY(p_frame, "NULL pointer");
+    Vk* p_vk = p_frame->p_vk;
+    if (!p_vk) {
+        return;
+    }
+
+    TRACK(vkQueueWaitIdle(p_frame->queue));
+    if (p_frame->async_compute) {
+        TRACK(vkQueueWaitIdle(p_frame->compute_queue));
+    }
+    p_frame->upload_recording = false;
+    p_frame->readback_recording = false;
+    p_frame->compute_recording = false;
+    p_frame->render_recording = false;
+    TRACK(Vk_FrameSubmit_Begin(p_frame));
+
+    if (p_frame->staging.buffer != VK_NULL_HANDLE) {
+        TRACK(vmaDestroyBuffer(p_vk->allocator, p_frame->staging.buffer, p_frame->staging.allocation));
+    }
+    TRACK(vkDestroyCommandPool(p_vk->device, p_frame->command_pool, NULL));
+    TRACK(vkDestroyCommandPool(p_vk->device, p_frame->compute_command_pool, NULL));
+    TRACK(vk_DescriptorAllocator_Destroy(p_vk, &p_frame->descriptors));
+    if (p_frame->timeline != VK_NULL_HANDLE) {
+        TRACK(vkDestroySemaphore(p_vk->device, p_frame->timeline, NULL));
+    }
+    if (p_frame->p_retired_staging) free(p_frame->p_retired_staging);
+    if (p_frame->p_written)         free(p_frame->p_written);
+    if (p_frame->p_readbacks)       free(p_frame->p_readbacks);
+    memset(p_frame, 0, sizeof(Vk_FrameSubmit));
+}
@@ -4,8 +4,10 @@
 #include <libgen.h>
 
 Image vk_Image_Create_ReadWrite(Vk* p_vk, VkExtent2D extent, VkFormat format) {
-	Image image;
+	Image image = {0};
 	image.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	image.mip_levels = 1;
+	image.array_layers = 1;
 	image.extent = extent;
 	image.format = format; //VK_FORMAT_R8G8B8A8_SRGB
 
@@ -73,273 +75,288 @@ Image vk_Image_Create_ReadWrite(Vk* p_vk, VkExtent2D extent, VkFormat format) {
 	VERIFY(result == VK_SUCCESS, "failed to create\n ");
 	VERIFY(image.sampler != VK_NULL_HANDLE, "failed to create");
 
+	// instances sample it through the texture table at this tex_index
+	TRACK(image.texture_index = vk_TextureTable_Register(p_vk, &image));
 	return image;
 }
-void vk_Image_TransitionLayout(VkCommandBuffer command_buffer, Image* p_image, VkImageLayout new_layout) {
-
+VkImageAspectFlags vk_Image_AspectMask(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+VkImageSubresourceRange vk_Image_FullRange(const Image* p_image) {
     VERIFY(p_image, "NULL pointer");
+    return (VkImageSubresourceRange){
+        .aspectMask = vk_Image_AspectMask(p_image->format),
+        .baseMipLevel = 0,
+        .levelCount = p_image->mip_levels ? p_image->mip_levels : 1,
+        .baseArrayLayer = 0,
+        .layerCount = p_image->array_layers ? p_image->array_layers : 1,
+    };
+}
+
+static const struct {
+    VkImageLayout           layout;
+    VkPipelineStageFlags2   stage;
+    VkAccessFlags2          access;
+} IMAGE_USES[VK_IMAGE_USE_COUNT] = {
+    [VK_IMAGE_USE_COPY_SRC]         = { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT },
+    [VK_IMAGE_USE_COPY_DST]         = { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT },
+    [VK_IMAGE_USE_SAMPLED]          = { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT },
+    [VK_IMAGE_USE_SAMPLED_COMPUTE]  = { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT },
+    [VK_IMAGE_USE_STORAGE]          = { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT },
+    [VK_IMAGE_USE_COLOR_ATTACHMENT] = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT },
+    [VK_IMAGE_USE_DEPTH_ATTACHMENT] = { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT },
+    // the next use waits on the acquire semaphore at COLOR_ATTACHMENT_OUTPUT, its barrier starts there
+    [VK_IMAGE_USE_PRESENT]          = { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE },
+};
+
+static VkAccessFlags2 WriteAccesses(VkAccessFlags2 access) {
+    return access & (VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+                     VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                     VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
+}
+
+static bool SameImageState(const Vk_ImageState* p_a, const Vk_ImageState* p_b) {
+    return p_a->layout == p_b->layout && p_a->stage == p_b->stage && p_a->access == p_b->access && p_a->queue_family == p_b->queue_family;
+}
 
-    VkImageLayout old_layout = p_image->layout;
-    if (old_layout == new_layout) {
-        printf("WARNING: image layout is already in the prefered image layout\n");
-        return;
+static Vk_ImageState* ImageStates(Image* p_image) {
+    if (!p_image->p_states) {
+        size_t count = (size_t)(p_image->mip_levels ? p_image->mip_levels : 1) * (p_image->array_layers ? p_image->array_layers : 1);
+        p_image->p_states = alloc(NULL, sizeof(Vk_ImageState) * count);
+        for (size_t i = 0; i < count; ++i) {
+            // whatever happened before tracking started has been waited for
+            p_image->p_states[i] = (Vk_ImageState){
+                .layout = p_image->layout,
+                .stage = VK_PIPELINE_STAGE_2_NONE,
+                .access = VK_ACCESS_2_NONE,
+                .queue_family = VK_QUEUE_FAMILY_IGNORED,
+            };
+        }
     }
+    return p_image->p_states;
+}
 
-    VkImageAspectFlags aspect_mask = 0;
-    if (p_image->format == VK_FORMAT_D32_SFLOAT ||
-        p_image->format == VK_FORMAT_D24_UNORM_S8_UINT ||
-        p_image->format == VK_FORMAT_D32_SFLOAT_S8_UINT) {
-        aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT;
-        // Add stencil aspect if present
-        if (p_image->format == VK_FORMAT_D24_UNORM_S8_UINT || p_image->format == VK_FORMAT_D32_SFLOAT_S8_UINT) {
-            aspect_mask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+// Moves every subresource of the range into the new state. Subresources sharing the same previous state
+// are transitioned by one barrier: consecutive mips within a layer first, then identical mip runs of
+// consecutive layers. Read after read in the same layout needs no barrier at all.
+static void UseImageState(Vk_BarrierBatch* p_batch, Image* p_image, VkImageSubresourceRange range, Vk_ImageState new_state, bool release) {
+    VERIFY(p_batch, "NULL pointer");
+    VERIFY(p_image, "NULL pointer");
+    VERIFY(p_image->image != VK_NULL_HANDLE, "image is VK_NULL_HANDLE");
+
+    unsigned int mip_levels = p_image->mip_levels ? p_image->mip_levels : 1;
+    unsigned int array_layers = p_image->array_layers ? p_image->array_layers : 1;
+    unsigned int mip_end = range.levelCount == VK_REMAINING_MIP_LEVELS ? mip_levels : range.baseMipLevel + range.levelCount;
+    unsigned int layer_end = range.layerCount == VK_REMAINING_ARRAY_LAYERS ? array_layers : range.baseArrayLayer + range.layerCount;
+    VERIFY(range.baseMipLevel < mip_end && mip_end <= mip_levels, "mip range out of bounds");
+    VERIFY(range.baseArrayLayer < layer_end && layer_end <= array_layers, "layer range out of bounds");
+
+    Vk_ImageState* p_states = ImageStates(p_image);
+    unsigned int first_barrier = p_batch->image_barriers_count;
+
+    for (unsigned int layer = range.baseArrayLayer; layer < layer_end; ++layer) {
+        Vk_ImageState* p_layer_states = &p_states[layer * mip_levels];
+        unsigned int mip = range.baseMipLevel;
+        while (mip < mip_end) {
+            Vk_ImageState old_state = p_layer_states[mip];
+            bool transfer = new_state.queue_family != VK_QUEUE_FAMILY_IGNORED && old_state.queue_family != VK_QUEUE_FAMILY_IGNORED && new_state.queue_family != old_state.queue_family;
+            bool needs_barrier = transfer ||
+                                 old_state.layout != new_state.layout ||
+                                 WriteAccesses(old_state.access) != 0 ||
+                                 (WriteAccesses(new_state.access) != 0 && old_state.stage != VK_PIPELINE_STAGE_2_NONE);
+            if (!needs_barrier) {
+                if (!release) {
+                    p_layer_states[mip].stage |= new_state.stage;
+                    p_layer_states[mip].access |= new_state.access;
+                    // the first use that names a queue family owns the image from then on
+                    if (old_state.queue_family == VK_QUEUE_FAMILY_IGNORED) {
+                        p_layer_states[mip].queue_family = new_state.queue_family;
+                    }
+                }
+                mip++;
+                continue;
+            }
+
+            unsigned int run_end = mip + 1;
+            while (run_end < mip_end && SameImageState(&p_layer_states[run_end], &old_state)) {
+                run_end++;
+            }
+
+            VkImageMemoryBarrier2 barrier = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                .srcStageMask = old_state.stage,
+                .srcAccessMask = WriteAccesses(old_state.access),
+                .dstStageMask = new_state.stage,
+                .dstAccessMask = new_state.access,
+                .oldLayout = old_state.layout,
+                .newLayout = new_state.layout,
+                .srcQueueFamilyIndex = transfer ? old_state.queue_family : VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = transfer ? new_state.queue_family : VK_QUEUE_FAMILY_IGNORED,
+                .image = p_image->image,
+                .subresourceRange = {
+                    .aspectMask = range.aspectMask,
+                    .baseMipLevel = mip,
+                    .levelCount = run_end - mip,
+                    .baseArrayLayer = layer,
+                    .layerCount = 1,
+                },
+            };
+            if (transfer) {
+                // the release half on the old queue waits for the writes, the acquire half is ordered by a semaphore
+                if (release) {
+                    barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+                    barrier.dstAccessMask = VK_ACCESS_2_NONE;
+                } else {
+                    barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+                    barrier.srcAccessMask = VK_ACCESS_2_NONE;
+                }
+            }
+
+            bool merged = false;
+            for (unsigned int i = first_barrier; i < p_batch->image_barriers_count; ++i) {
+                VkImageMemoryBarrier2* p_other = &p_batch->image_barriers[i];
+                if (p_other->subresourceRange.baseMipLevel == barrier.subresourceRange.baseMipLevel &&
+                    p_other->subresourceRange.levelCount == barrier.subresourceRange.levelCount &&
+                    p_other->subresourceRange.baseArrayLayer + p_other->subresourceRange.layerCount == layer &&
+                    p_other->oldLayout == barrier.oldLayout &&
+                    p_other->srcStageMask == barrier.srcStageMask &&
+                    p_other->srcAccessMask == barrier.srcAccessMask &&
+                    p_other->srcQueueFamilyIndex == barrier.srcQueueFamilyIndex) {
+                    p_other->subresourceRange.layerCount++;
+                    merged = true;
+                    break;
+                }
+            }
+            if (!merged) {
+                VERIFY(p_batch->image_barriers_count < VK_BARRIER_BATCH_MAX_IMAGE_BARRIERS, "too many image barriers in one batch");
+                p_batch->image_barriers[p_batch->image_barriers_count++] = barrier;
+            }
+
+            if (!release) {
+                for (unsigned int m = mip; m < run_end; ++m) {
+                    p_layer_states[m] = (Vk_ImageState){
+                        .layout = new_state.layout,
+                        .stage = new_state.stage,
+                        .access = new_state.access,
+                        .queue_family = new_state.queue_family != VK_QUEUE_FAMILY_IGNORED ? new_state.queue_family : old_state.queue_family,
+                    };
+                }
+            }
+            mip = run_end;
         }
-    } else {
-        aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
     }
 
-    VkImageSubresourceRange subresource_range = {
-        .aspectMask = aspect_mask,
-        .baseMipLevel = 0,
-        .levelCount = 1,
-        .baseArrayLayer = 0,
-        .layerCount = 1,
+    p_image->layout = p_states[0].layout;
+}
+
+// On the queue family that owns the image. Its first use names the family through vk_Image_UseOnQueue, or
+// a later use on another family cannot tell that it needs an ownership transfer.
+void vk_Image_Use(Vk_BarrierBatch* p_batch, Image* p_image, VkImageSubresourceRange range, Vk_ImageUse use) {
+    vk_Image_UseOnQueue(p_batch, p_image, range, use, VK_QUEUE_FAMILY_IGNORED);
+}
+
+// With a queue family different from the owning one this is the acquire half of an ownership transfer
+void vk_Image_UseOnQueue(Vk_BarrierBatch* p_batch, Image* p_image, VkImageSubresourceRange range, Vk_ImageUse use, unsigned int queue_family) {
+    VERIFY(use < VK_IMAGE_USE_COUNT, "invalid image use %d", (int)use);
+    Vk_ImageState new_state = {
+        .layout = IMAGE_USES[use].layout,
+        .stage = IMAGE_USES[use].stage,
+        .access = IMAGE_USES[use].access,
+        .queue_family = queue_family,
     };
+    UseImageState(p_batch, p_image, range, new_state, false);
+}
 
-    VkImageMemoryBarrier barrier = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .oldLayout = old_layout,
-        .newLayout = new_layout,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = p_image->image,
-        .subresourceRange = subresource_range,
+// Records the release half of an ownership transfer on the owning queue, the state changes on the acquire
+void vk_Image_Release(Vk_BarrierBatch* p_batch, Image* p_image, VkImageSubresourceRange range, Vk_ImageUse use, unsigned int dst_queue_family) {
+    VERIFY(use < VK_IMAGE_USE_COUNT, "invalid image use %d", (int)use);
+    VERIFY(dst_queue_family != VK_QUEUE_FAMILY_IGNORED, "release needs a destination queue family");
+    Vk_ImageState new_state = {
+        .layout = IMAGE_USES[use].layout,
+        .stage = IMAGE_USES[use].stage,
+        .access = IMAGE_USES[use].access,
+        .queue_family = dst_queue_family,
     };
+    UseImageState(p_batch, p_image, range, new_state, true);
+}
 
-    VkPipelineStageFlags src_stage;
-    VkPipelineStageFlags dst_stage;
-
-    // Define source access mask and pipeline stage based on old_layout
-    switch (old_layout) {
-        case VK_IMAGE_LAYOUT_UNDEFINED:
-            barrier.srcAccessMask = 0;
-            src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_PREINITIALIZED:
-            barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-            src_stage = VK_PIPELINE_STAGE_HOST_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-            barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-            src_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-            barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-            src_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            src_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
-            barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-            src_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            break;
-        default:
-            VERIFY(false, "unsupported old layout\n");
-    }
+static void TransitionLayoutOnQueue(Vk_BarrierBatch* p_batch, Image* p_image, VkImageSubresourceRange range, VkImageLayout new_layout, unsigned int queue_family) {
 
-    // Define destination access mask and pipeline stage based on new_layout
-    switch (new_layout) {
-        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-            dst_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-            dst_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_GENERAL:
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-            dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
-            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-            dst_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_UNDEFINED:
-            barrier.dstAccessMask = 0;
-            dst_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_PREINITIALIZED:
-            barrier.dstAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-            dst_stage = VK_PIPELINE_STAGE_HOST_BIT;
-            break;
-        default:
-            VERIFY(false, "unsupported old layout\n");
-    }
-    
-    TRACK(vkCmdPipelineBarrier( command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier ));
+    VERIFY(p_image, "NULL pointer");
 
-    p_image->layout = new_layout;
+    Vk_ImageState new_state = { .layout = new_layout, .queue_family = queue_family };
+    TRACK(vk_Barrier_LayoutStageAccess(new_layout, false, &new_state.stage, &new_state.access));
+    TRACK(UseImageState(p_batch, p_image, range, new_state, false));
+}
+// Adds the transition of the range to the batch, on the queue family that owns the image like vk_Image_Use
+void vk_Image_TransitionLayout(Vk_BarrierBatch* p_batch, Image* p_image, VkImageSubresourceRange range, VkImageLayout new_layout) {
+    TRACK(TransitionLayoutOnQueue(p_batch, p_image, range, new_layout, VK_QUEUE_FAMILY_IGNORED));
 }
+// Every mip level and array layer
 void vk_Image_TransitionLayoutWithoutCommandBuffer(Vk* p_vk, Image* p_image, VkImageLayout new_layout) {
     VERIFY(p_vk, "NULL pointer");
     VERIFY(p_image, "NULL pointer");
+    Vk_BarrierBatch barriers = {0};
     TRACK(VkCommandBuffer command_buffer = vk_CommandBuffer_CreateAndBeginSingleTimeUsage(p_vk));
-    TRACK(vk_Image_TransitionLayout(command_buffer, p_image, new_layout));
+    TRACK(TransitionLayoutOnQueue(&barriers, p_image, vk_Image_FullRange(p_image), new_layout, p_vk->queue_family_indices.graphics));
+    TRACK(vk_Barrier_Flush(&barriers, command_buffer));
     TRACK(vk_CommandBuffer_EndAndDestroySingleTimeUsage(p_vk, command_buffer));
 }
-void vk_Image_TransitionLayout_0(
-    VkCommandBuffer command_buffer, 
-    VkImage* p_image, 
-    VkFormat format, 
-    VkImageLayout old_layout, 
-    VkImageLayout new_layout) 
-{
-
-    VERIFY(p_image, "NULL pointer");
-
-    if (old_layout == new_layout) {
-        printf("WARNING: image layout is already in the prefered image layout\n");
-        return;
-    }
-
-    VkImageAspectFlags aspect_mask = 0;
-    if (format == VK_FORMAT_D32_SFLOAT ||
-        format == VK_FORMAT_D24_UNORM_S8_UINT ||
-        format == VK_FORMAT_D32_SFLOAT_S8_UINT) {
-        aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT;
-        // Add stencil aspect if present
-        if (format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT) {
-            aspect_mask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-        }
-    } else {
-        aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
-    }
-
-    VkImageSubresourceRange subresource_range = {
-        .aspectMask = aspect_mask,
-        .baseMipLevel = 0,
-        .levelCount = 1,
-        .baseArrayLayer = 0,
-        .layerCount = 1,
+// A one time command buffer from a pool of its own, for queues other than the graphics one
+static VkCommandPool BeginOnQueueFamily(Vk* p_vk, unsigned int queue_family, VkCommandBuffer* p_command_buffer) {
+    VkCommandPoolCreateInfo pool_info = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = queue_family,
+        .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
     };
-
-    VkImageMemoryBarrier barrier = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .oldLayout = old_layout,
-        .newLayout = new_layout,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = p_image,
-        .subresourceRange = subresource_range,
+    VkCommandPool pool;
+    TRACK(VkResult result = vkCreateCommandPool(p_vk->device, &pool_info, NULL, &pool));
+    VERIFY(result == VK_SUCCESS, "Failed to create upload command pool\n");
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool        = pool,
+        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
     };
-
-    VkPipelineStageFlags src_stage;
-    VkPipelineStageFlags dst_stage;
-
-    // Define source access mask and pipeline stage based on old_layout
-    switch (old_layout) {
-        case VK_IMAGE_LAYOUT_UNDEFINED:
-            barrier.srcAccessMask = 0;
-            src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_PREINITIALIZED:
-            barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-            src_stage = VK_PIPELINE_STAGE_HOST_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-            barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-            src_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-            barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-            src_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            src_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
-            barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-            src_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            break;
-        default:
-            VERIFY(false, "unsupported old layout\n");
-    }
-
-    // Define destination access mask and pipeline stage based on new_layout
-    switch (new_layout) {
-        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-            dst_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-            dst_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_GENERAL:
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-            dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
-            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-            dst_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_UNDEFINED:
-            barrier.dstAccessMask = 0;
-            dst_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_PREINITIALIZED:
-            barrier.dstAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-            dst_stage = VK_PIPELINE_STAGE_HOST_BIT;
-            break;
-        default:
-            VERIFY(false, "unsupported old layout\n");
-    }
-    
-    TRACK(vkCmdPipelineBarrier( command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier ));
+    TRACK(result = vkAllocateCommandBuffers(p_vk->device, &alloc_info, p_command_buffer));
+    VERIFY(result == VK_SUCCESS, "Failed to allocate upload command buffer\n");
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    TRACK(result = vkBeginCommandBuffer(*p_command_buffer, &begin_info));
+    VERIFY(result == VK_SUCCESS, "Failed to begin upload command buffer\n");
+    return pool;
+}
+// Waits for the queue, so work submitted after this is ordered after it without a semaphore
+static void SubmitOnQueueFamily(Vk* p_vk, VkQueue queue, VkCommandPool pool, VkCommandBuffer command_buffer) {
+    TRACK(VkResult result = vkEndCommandBuffer(command_buffer));
+    VERIFY(result == VK_SUCCESS, "Failed to end upload command buffer\n");
+    VkSubmitInfo submit_info = {
+        .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers    = &command_buffer,
+    };
+    TRACK(result = vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    VERIFY(result == VK_SUCCESS, "Failed to submit upload command buffer\n");
+    TRACK(vkQueueWaitIdle(queue));
+    TRACK(vkDestroyCommandPool(p_vk->device, pool, NULL));
+}
+// A frame in flight may still sample the image, so its handles and texture slot go through the deletion queue
+void vk_Image_Destroy(Vk* p_vk, Image* p_image) {
+    VERIFY(p_vk, "NULL pointer");
+    VERIFY(p_image, "NULL pointer");
+    TRACK(vk_DeletionQueue_RetireImage(p_vk, p_image));
 }
 void vk_Image_CopyData( Vk* p_vk, Image* p_image, VkImageLayout final_layout, const void* p_data, const VkRect2D rect, const size_t pixel_size ) {
 
@@ -377,10 +394,44 @@ void vk_Image_CopyData( Vk* p_vk, Image* p_image, VkImageLayout final_layout, co
         },
     };
 
-    TRACK(VkCommandBuffer command_buffer = vk_CommandBuffer_CreateAndBeginSingleTimeUsage(p_vk));
-    TRACK(vk_Image_TransitionLayout(command_buffer, p_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+    VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = 0,
+        .layerCount = 1,
+    };
+    Vk_BarrierBatch barriers = {0};
+
+    // a transfer queue of another family, dedicated or the compute one, copies and releases the image to the
+    // graphics family, which acquires it
+    unsigned int graphics_family = p_vk->queue_family_indices.graphics;
+    unsigned int transfer_family = p_vk->queue_family_indices.transfer;
+    bool transfer_queue = p_vk->queues.transfer != VK_NULL_HANDLE && p_vk->queues.transfer != p_vk->queues.graphics && transfer_family != graphics_family;
+
+    VkCommandBuffer command_buffer;
+    VkCommandPool transfer_pool = VK_NULL_HANDLE;
+    if (transfer_queue) {
+        TRACK(transfer_pool = BeginOnQueueFamily(p_vk, transfer_family, &command_buffer));
+    } else {
+        TRACK(command_buffer = vk_CommandBuffer_CreateAndBeginSingleTimeUsage(p_vk));
+        transfer_family = graphics_family;
+    }
+    TRACK(vk_Image_UseOnQueue(&barriers, p_image, range, VK_IMAGE_USE_COPY_DST, transfer_family));
+    TRACK(vk_Barrier_Flush(&barriers, command_buffer));
     TRACK(vkCmdCopyBufferToImage( command_buffer, staging_buffer.buffer, p_image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region ));
-    TRACK(vk_Image_TransitionLayout(command_buffer, p_image, final_layout));
+    if (transfer_queue) {
+        TRACK(vk_Image_Release(&barriers, p_image, range, VK_IMAGE_USE_COPY_DST, graphics_family));
+        TRACK(vk_Barrier_Flush(&barriers, command_buffer));
+        TRACK(SubmitOnQueueFamily(p_vk, p_vk->queues.transfer, transfer_pool, command_buffer));
+
+        // barriers of one batch are unordered, so the acquire is flushed before the layout changes again
+        TRACK(command_buffer = vk_CommandBuffer_CreateAndBeginSingleTimeUsage(p_vk));
+        TRACK(vk_Image_UseOnQueue(&barriers, p_image, range, VK_IMAGE_USE_COPY_DST, graphics_family));
+        TRACK(vk_Barrier_Flush(&barriers, command_buffer));
+    }
+    TRACK(vk_Image_TransitionLayout(&barriers, p_image, range, final_layout));
+    TRACK(vk_Barrier_Flush(&barriers, command_buffer));
     TRACK(vk_CommandBuffer_EndAndDestroySingleTimeUsage(p_vk, command_buffer));
 	TRACK(vmaDestroyBuffer(p_vk->allocator, staging_buffer.buffer, staging_buffer.allocation));
 }
@@ -405,11 +456,11 @@ void vk_Image_CopyImageFile( Vk* p_vk, Image* p_image, VkImageLayout final_layou
     TRACK(stbi_image_free(p_data));
 }
 
-Image vk_Image_CreateFromImageFile( Vk* p_vk, const char* filename, VkFormat format, VkImageLayout layout ) {
+// Only touches the file and the CPU, so it can run before the device exists. RGBA8 pixels, release with vk_Image_FreeDecoded.
+unsigned char* vk_Image_DecodeFile( const char* filename, VkExtent2D* p_extent ) {
 
-    VERIFY(p_vk, "Vk pointer is NULL.");
-    VERIFY(p_vk->allocator, "VmaAllocator is NULL.");
     VERIFY(filename, "Filename is NULL.");
+    VERIFY(p_extent, "NULL pointer");
 
     char absolute_path[PATH_MAX];
 	VERIFY(realpath(filename, absolute_path), "realpath");
@@ -423,17 +474,42 @@ Image vk_Image_CreateFromImageFile( Vk* p_vk, const char* filename, VkFormat for
     TRACK(unsigned char* p_data = stbi_load(filename, &width, &height, &channels, STBI_rgb_alpha));
     VERIFY(p_data, "Failed to load image file: %s\n", filename);
 
+    *p_extent = (VkExtent2D){ (unsigned int)width, (unsigned int)height };
+    return p_data;
+}
+
+void vk_Image_FreeDecoded( unsigned char* p_pixels ) {
+    if (p_pixels) {
+        TRACK(stbi_image_free(p_pixels));
+    }
+}
+
+Image vk_Image_CreateFromPixels( Vk* p_vk, const unsigned char* p_pixels, VkExtent2D extent, VkFormat format, VkImageLayout layout ) {
+
+    VERIFY(p_vk, "Vk pointer is NULL.");
+    VERIFY(p_vk->allocator, "VmaAllocator is NULL.");
+    VERIFY(p_pixels, "NULL pointer");
+
     size_t pixel_size = 4;
     VkRect2D rect = {
         .offset = {0, 0},
-        .extent = {width, height}
+        .extent = extent
     };
 
     TRACK(Image image = vk_Image_Create_ReadWrite(p_vk, rect.extent, format));
-
-    TRACK(vk_Image_CopyData( p_vk, &image, layout, p_data, rect, pixel_size ));
-    TRACK(stbi_image_free(p_data));
+    TRACK(vk_Image_CopyData( p_vk, &image, layout, p_pixels, rect, pixel_size ));
 
     return image;
+}
+
+Image vk_Image_CreateFromImageFile( Vk* p_vk, const char* filename, VkFormat format, VkImageLayout layout ) {
 
-}
\ No newline at end of file
+    VERIFY(p_vk, "Vk pointer is NULL.");
+
+    VkExtent2D extent;
+    TRACK(unsigned char* p_data = vk_Image_DecodeFile(filename, &extent));
+    TRACK(Image image = vk_Image_CreateFromPixels(p_vk, p_data, extent, format, layout));
+    TRACK(vk_Image_FreeDecoded(p_data));
+
+    return image;
+}
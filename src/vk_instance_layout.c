@@ -0,0 +1,109 @@
+#include "vk.h"
+
+// Everything here is generated from instance_layout.inl, so the struct, the attribute offsets and the
+// shader inputs cannot drift apart. The asserts catch edits to the schema that break its own rules.
+
+#define DATA_INDEX(loc, c_declaration, c_name, vk_format, glsl_declaration)   DATA_INDEX_##c_name,
+#define PACKED_INDEX(loc, c_declaration, c_name, vk_format, glsl_declaration) PACKED_INDEX_##c_name,
+enum { INSTANCE_DATA_FIELDS(DATA_INDEX) };
+enum { INSTANCE_DATA_PACKED_FIELDS(PACKED_INDEX) };
+
+// locations count up from 0 in the order the fields are listed
+#define DATA_LOCATION_ASSERT(loc, c_declaration, c_name, vk_format, glsl_declaration) \
+    _Static_assert(loc == DATA_INDEX_##c_name, "InstanceData." #c_name " is not at location " #loc);
+#define PACKED_LOCATION_ASSERT(loc, c_declaration, c_name, vk_format, glsl_declaration) \
+    _Static_assert(loc == PACKED_INDEX_##c_name, "InstanceDataPacked." #c_name " is not at location " #loc);
+INSTANCE_DATA_FIELDS(DATA_LOCATION_ASSERT)
+INSTANCE_DATA_PACKED_FIELDS(PACKED_LOCATION_ASSERT)
+
+// no padding, the size is the sum of the fields and matches the number the schema states
+#define DATA_FIELD_SIZE(loc, c_declaration, c_name, vk_format, glsl_declaration)   + sizeof(((InstanceData*)0)->c_name)
+#define PACKED_FIELD_SIZE(loc, c_declaration, c_name, vk_format, glsl_declaration) + sizeof(((InstanceDataPacked*)0)->c_name)
+_Static_assert(sizeof(InstanceData) == 0 INSTANCE_DATA_FIELDS(DATA_FIELD_SIZE), "InstanceData has padding");
+_Static_assert(sizeof(InstanceDataPacked) == 0 INSTANCE_DATA_PACKED_FIELDS(PACKED_FIELD_SIZE), "InstanceDataPacked has padding");
+_Static_assert(sizeof(InstanceData) == INSTANCE_DATA_SIZE, "InstanceData is not INSTANCE_DATA_SIZE bytes");
+_Static_assert(sizeof(InstanceDataPacked) == INSTANCE_DATA_PACKED_SIZE, "InstanceDataPacked is not INSTANCE_DATA_PACKED_SIZE bytes");
+// vertex pulling reads the same bytes as a std430 struct, its vec4 and the array stride are 16 byte aligned
+_Static_assert(offsetof(InstanceData, tex_rect) % 16 == 0 && sizeof(InstanceData) % 16 == 0, "InstanceData no longer matches its std430 layout");
+
+#define DATA_ATTRIBUTE(loc, c_declaration, c_name, vk_format, glsl_declaration) \
+    { .location = loc, .binding = 0, .format = vk_format, .offset = offsetof(InstanceData, c_name) },
+#define PACKED_ATTRIBUTE(loc, c_declaration, c_name, vk_format, glsl_declaration) \
+    { .location = loc, .binding = 0, .format = vk_format, .offset = offsetof(InstanceDataPacked, c_name) },
+static const VkVertexInputAttributeDescription data_attributes[]   = { INSTANCE_DATA_FIELDS(DATA_ATTRIBUTE) };
+static const VkVertexInputAttributeDescription packed_attributes[] = { INSTANCE_DATA_PACKED_FIELDS(PACKED_ATTRIBUTE) };
+
+Vk_VertexLayout vk_VertexLayout_InstanceData(void) {
+    Vk_VertexLayout layout = {
+        .p_attributes     = data_attributes,
+        .attributes_count = sizeof(data_attributes) / sizeof(data_attributes[0]),
+        .stride           = sizeof(InstanceData),
+    };
+    return layout;
+}
+
+// Only formats every device supports for vertex buffers, the shader decodes the rest
+Vk_VertexLayout vk_VertexLayout_InstanceDataPacked(void) {
+    Vk_VertexLayout layout = {
+        .p_attributes     = packed_attributes,
+        .attributes_count = sizeof(packed_attributes) / sizeof(packed_attributes[0]),
+        .stride           = sizeof(InstanceDataPacked),
+    };
+    return layout;
+}
+
+// A vertex shader without inputs pulls its instances from storage buffers and gets no vertex buffer,
+// every other one reads InstanceData
+Vk_VertexLayout vk_VertexLayout_ForShader(const Vk_ShaderReflection* p_reflection) {
+    VERIFY(p_reflection, "NULL pointer");
+    if (p_reflection->inputs_count == 0) {
+        Vk_VertexLayout pulled = {0};
+        return pulled;
+    }
+    return vk_VertexLayout_InstanceData();
+}
+
+// Every input the vertex shader reads needs an attribute, a shader built from another schema than the
+// buffer it is drawn with fails here instead of reading garbage
+void vk_VertexLayout_Verify(const Vk_VertexLayout* p_layout, const Vk_ShaderReflection* p_reflection) {
+    VERIFY(p_layout && p_reflection, "NULL pointer");
+    VERIFY(p_reflection->stage == VK_SHADER_STAGE_VERTEX_BIT, "Provided shader is not a vertex shader");
+    for (unsigned int i = 0; i < p_reflection->inputs_count; ++i) {
+        unsigned int j = 0;
+        while (j < p_layout->attributes_count && p_layout->p_attributes[j].location != p_reflection->inputs[i].location) {
+            ++j;
+        }
+        VERIFY(j < p_layout->attributes_count, "the vertex shader reads location %u, the vertex layout has no attribute for it", p_reflection->inputs[i].location);
+    }
+}
+
+// Vertices per instance of each INSTANCE_MESH, drawn as one triangle strip
+static const unsigned int mesh_vertex_counts[] = {
+    [INSTANCE_MESH_QUAD]     = 4,
+    [INSTANCE_MESH_OCTAGON]  = 8,
+    [INSTANCE_MESH_RING]     = 18,
+    [INSTANCE_MESH_INTERIOR] = 4,
+};
+
+unsigned int vk_InstanceMesh_VertexCount(unsigned int mesh) {
+    VERIFY(mesh < sizeof(mesh_vertex_counts) / sizeof(mesh_vertex_counts[0]), "unknown instance mesh %u", mesh);
+    return mesh_vertex_counts[mesh];
+}
+
+// The interior only covers opaque fill, every other mesh has edges to blend
+bool vk_InstanceMesh_Blends(unsigned int mesh) {
+    return mesh != INSTANCE_MESH_INTERIOR;
+}
+
+// Specialises INSTANCE_MESH with one unsigned int at offset 0. False when the vertex shader does not
+// declare it, it then only draws quads.
+bool vk_InstanceMesh_MapEntry(const Vk_ShaderReflection* p_reflection, VkSpecializationMapEntry* p_entry) {
+    VERIFY(p_reflection && p_entry, "NULL pointer");
+    for (unsigned int i = 0; i < p_reflection->spec_constants_count; ++i) {
+        if (strcmp(p_reflection->spec_constants[i].name, "INSTANCE_MESH") == 0) {
+            *p_entry = (VkSpecializationMapEntry){ .constantID = p_reflection->spec_constants[i].constant_id, .offset = 0, .size = sizeof(unsigned int) };
+            return true;
+        }
+    }
+    return false;
+}
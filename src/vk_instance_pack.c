@@ -0,0 +1,112 @@
+#include "vk.h"
+
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Degrees to 1/65536 turns, any angle wraps into one turn
+static uint32_t PackRotation(float degrees) {
+    float turns = degrees / 360.0f;
+    turns -= floorf(turns);
+    return (uint32_t)lrintf(turns * 65536.0f) & 0xffffu;
+}
+
+static uint32_t PackRotationRadius(const InstanceData* p_src) {
+    float radius = p_src->corner_radius < 0.0f ? 0.0f : p_src->corner_radius > 255.0f ? 255.0f : p_src->corner_radius;
+    unsigned int tex_index = p_src->tex_index > 255 ? 255 : p_src->tex_index;
+    return PackRotation(p_src->rotation) | (uint32_t)lrintf(radius) << 16 | (uint32_t)tex_index << 24;
+}
+
+#ifdef __SSE2__
+
+// Round to nearest, values below the smallest normal half flush to zero and values above the largest
+// clamp to 65504. Each lane holds its half in the low 16 bits.
+static inline __m128i FloatToHalf4(__m128 value) {
+    __m128i bits = _mm_castps_si128(value);
+    __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+    __m128i abs  = _mm_and_si128(bits, _mm_set1_epi32(0x7fffffff));
+    // rebias the exponent from 127 to 15 after rounding away the 13 mantissa bits halves do not have
+    __m128i half = _mm_sub_epi32(_mm_srli_epi32(_mm_add_epi32(abs, _mm_set1_epi32(0x1000)), 13), _mm_set1_epi32(0x1c000));
+    __m128i too_small = _mm_cmplt_epi32(abs, _mm_set1_epi32(0x38800000));
+    __m128i too_large = _mm_cmpgt_epi32(abs, _mm_set1_epi32(0x477fefff));
+    half = _mm_andnot_si128(too_small, half);
+    half = _mm_or_si128(_mm_andnot_si128(too_large, half), _mm_and_si128(too_large, _mm_set1_epi32(0x7bff)));
+    return _mm_or_si128(half, sign);
+}
+
+// Saturates 32 bit lanes to unsigned 16 bit, SSE2 only has the signed pack
+static inline __m128i PackUnsigned16(__m128i low, __m128i high) {
+    __m128i bias = _mm_set1_epi32(0x8000);
+    __m128i packed = _mm_packs_epi32(_mm_sub_epi32(low, bias), _mm_sub_epi32(high, bias));
+    return _mm_xor_si128(packed, _mm_set1_epi16((short)0x8000));
+}
+
+// Position, size and texture rectangle of one instance each fill a register. The remaining fields are
+// scalar bit packing.
+void vk_InstanceData_Pack(const InstanceData* p_src, InstanceDataPacked* p_dst, size_t count) {
+    VERIFY((p_src && p_dst) || count == 0, "NULL pointer");
+    const __m128 pos_scale = _mm_set_ps(1.0f, 1.0f, VK_INSTANCE_PACKED_POS_SCALE, VK_INSTANCE_PACKED_POS_SCALE);
+    const __m128 pos_bias  = _mm_set_ps(0.0f, 0.0f, VK_INSTANCE_PACKED_POS_BIAS * VK_INSTANCE_PACKED_POS_SCALE, VK_INSTANCE_PACKED_POS_BIAS * VK_INSTANCE_PACKED_POS_SCALE);
+    const __m128 pos_max   = _mm_set1_ps(65535.0f);
+    const __m128 zero      = _mm_setzero_ps();
+    const __m128 one       = _mm_set1_ps(1.0f);
+    const __m128 unorm16   = _mm_set1_ps(65535.0f);
+
+    for (size_t i = 0; i < count; ++i) {
+        // pos.x, pos.y, size.x, size.y
+        __m128 pos_size = _mm_loadu_ps(p_src[i].pos);
+        __m128 pos = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(pos_size, pos_scale), pos_bias), zero), pos_max);
+        __m128i pos_fixed = _mm_cvtps_epi32(pos);
+        __m128i size_half = FloatToHalf4(pos_size);
+        // lanes 0 and 1 of each, then the unsigned saturating pack keeps the low 16 bits
+        __m128i pos_size_packed = PackUnsigned16(_mm_unpacklo_epi64(pos_fixed, _mm_srli_si128(size_half, 8)), _mm_setzero_si128());
+        _mm_storel_epi64((__m128i*)p_dst[i].pos, pos_size_packed);
+
+        __m128 tex_rect = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(p_src[i].tex_rect), zero), one);
+        __m128i tex_rect_unorm = _mm_cvtps_epi32(_mm_mul_ps(tex_rect, unorm16));
+        _mm_storel_epi64((__m128i*)p_dst[i].tex_rect, PackUnsigned16(tex_rect_unorm, _mm_setzero_si128()));
+
+        p_dst[i].rotation_radius = PackRotationRadius(&p_src[i]);
+        p_dst[i].color = p_src[i].color;
+    }
+}
+
+#else
+
+// The same rounding and clamping as the SSE2 version
+static uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t abs = bits & 0x7fffffffu;
+    if (abs < 0x38800000u) {
+        return (uint16_t)sign;
+    }
+    if (abs > 0x477fefffu) {
+        return (uint16_t)(sign | 0x7bffu);
+    }
+    return (uint16_t)(sign | (((abs + 0x1000u) >> 13) - 0x1c000u));
+}
+
+static uint16_t Clamp16(float value, float max) {
+    value = value < 0.0f ? 0.0f : value > max ? max : value;
+    return (uint16_t)lrintf(value);
+}
+
+void vk_InstanceData_Pack(const InstanceData* p_src, InstanceDataPacked* p_dst, size_t count) {
+    VERIFY((p_src && p_dst) || count == 0, "NULL pointer");
+    for (size_t i = 0; i < count; ++i) {
+        for (unsigned int j = 0; j < 2; ++j) {
+            p_dst[i].pos[j]  = Clamp16((p_src[i].pos[j] + VK_INSTANCE_PACKED_POS_BIAS) * VK_INSTANCE_PACKED_POS_SCALE, 65535.0f);
+            p_dst[i].size[j] = FloatToHalf(p_src[i].size[j]);
+        }
+        for (unsigned int j = 0; j < 4; ++j) {
+            p_dst[i].tex_rect[j] = Clamp16(p_src[i].tex_rect[j] * 65535.0f, 65535.0f);
+        }
+        p_dst[i].rotation_radius = PackRotationRadius(&p_src[i]);
+        p_dst[i].color = p_src[i].color;
+    }
+}
+
+#endif
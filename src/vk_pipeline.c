@@ -1,12 +1,37 @@
 #include "vk.h"
 
-VkPipelineLayout vk_PipelineLayout_Create(VkDevice device, VkDescriptorSetLayout* p_set_layouts, size_t set_layout_count) {
+// One range spanning what every stage declares, visible to all of them. vkCmdPushConstants then always
+// takes the same stage flags, whichever part of the block is updated.
+VkPushConstantRange vk_PushConstantRange_CreateFromReflections(const Vk_ShaderReflection* p_reflections, unsigned int reflections_count) {
+    VERIFY(p_reflections || reflections_count == 0, "NULL pointer");
+    VkPushConstantRange range = {0};
+    for (unsigned int i = 0; i < reflections_count; ++i) {
+        const Vk_ShaderReflection* p_reflection = &p_reflections[i];
+        if (p_reflection->push_constant_size == 0) {
+            continue;
+        }
+        unsigned int begin = p_reflection->push_constant_offset;
+        unsigned int end   = p_reflection->push_constant_offset + p_reflection->push_constant_size;
+        if (range.size == 0) {
+            range.offset = begin;
+            range.size   = end - begin;
+        } else {
+            unsigned int range_end = range.offset + range.size;
+            range.offset = begin < range.offset ? begin : range.offset;
+            range.size   = (end > range_end ? end : range_end) - range.offset;
+        }
+        range.stageFlags |= p_reflection->stage;
+    }
+    return range;
+}
+// A push_constant_range of size 0 creates a layout without push constants
+VkPipelineLayout vk_PipelineLayout_Create(VkDevice device, VkDescriptorSetLayout* p_set_layouts, size_t set_layout_count, VkPushConstantRange push_constant_range) {
     VkPipelineLayoutCreateInfo vk_pipeline_layoutInfo = {
         .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .setLayoutCount         = set_layout_count,
         .pSetLayouts            = p_set_layouts,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges    = NULL
+        .pushConstantRangeCount = push_constant_range.size > 0 ? 1 : 0,
+        .pPushConstantRanges    = push_constant_range.size > 0 ? &push_constant_range : NULL
     };
     VkPipelineLayout pipelineLayout;
     if (vkCreatePipelineLayout(device, &vk_pipeline_layoutInfo, NULL, &pipelineLayout) != VK_SUCCESS) {
@@ -19,14 +44,99 @@ VkPipeline vk_Pipeline_Graphics_Create(
     Vk* p_vk,
     VkPipelineLayout pipelineLayout
 ) {
-    uint32_t vertex_attrib_count;
-    uint32_t vertex_binding_stride;
-    SpvShader spv_vertex_shader = vk_SpvShader_CreateFromGlslFile(p_vk, "shaders/shader.vert.glsl", shaderc_glsl_vertex_shader);
-    VkVertexInputAttributeDescription* vertex_input_attrib_desc = vk_VertexInputAttributeDescriptions_CreateFromVertexShader(
-        spv_vertex_shader, 
-        &vertex_attrib_count,
-        &vertex_binding_stride
-    );
+    SpvShader spv_vertex_shader = vk_SpvShader_Load(p_vk, "shaders/shader.vert.glsl", shaderc_glsl_vertex_shader);
+    SpvShader spv_fragment_shader = vk_SpvShader_Load(p_vk, "shaders/shader.frag.glsl", shaderc_glsl_fragment_shader);
+    VkPipeline graphicsPipeline = vk_Pipeline_Graphics_CreateFromSpv(p_vk, pipelineLayout, spv_vertex_shader, spv_fragment_shader);
+    free((void*)spv_vertex_shader.code);
+    free((void*)spv_fragment_shader.code);
+    return graphicsPipeline;
+}
+// Also used off the render thread by shader reloading, the shaders stay owned by the caller
+VkPipeline vk_Pipeline_Graphics_CreateFromSpv(
+    Vk* p_vk,
+    VkPipelineLayout pipelineLayout,
+    SpvShader spv_vertex_shader,
+    SpvShader spv_fragment_shader
+) {
+    return vk_Pipeline_Graphics_CreateSpecialized(p_vk, pipelineLayout, spv_vertex_shader, spv_fragment_shader, NULL, 0, NULL);
+}
+// Fills the map entries of the constants this stage declares, the values are packed in matching order
+static unsigned int SpecializationEntries(
+    SpvShader spv_shader,
+    const Vk_SpecConstant* p_constants,
+    size_t constants_count,
+    VkSpecializationMapEntry* p_entries,
+    unsigned int* p_data,
+    bool* p_matched
+) {
+    Vk_ShaderReflection reflection = vk_ShaderReflection_Create(spv_shader);
+    unsigned int entries_count = 0;
+    for (size_t i = 0; i < constants_count; ++i) {
+        for (unsigned int j = 0; j < reflection.spec_constants_count; ++j) {
+            if (strcmp(reflection.spec_constants[j].name, p_constants[i].name) != 0) {
+                continue;
+            }
+            VERIFY(entries_count < VK_REFLECT_MAX_SPEC_CONSTANTS, "more than %d specialization constants", VK_REFLECT_MAX_SPEC_CONSTANTS);
+            p_entries[entries_count] = (VkSpecializationMapEntry){
+                .constantID = reflection.spec_constants[j].constant_id,
+                .offset     = entries_count * sizeof(unsigned int),
+                .size       = sizeof(unsigned int),
+            };
+            p_data[entries_count++] = p_constants[i].value;
+            p_matched[i] = true;
+        }
+    }
+    return entries_count;
+}
+// Constants are matched by name against the reflection of each stage, a name no stage declares is an error.
+// Without p_vertex_layout the instance buffer holds InstanceData, or the vertex shader pulls its instances.
+// An INSTANCE_MESH constant draws vk_InstanceMesh_VertexCount vertices per instance instead of 4.
+VkPipeline vk_Pipeline_Graphics_CreateSpecialized(
+    Vk* p_vk,
+    VkPipelineLayout pipelineLayout,
+    SpvShader spv_vertex_shader,
+    SpvShader spv_fragment_shader,
+    const Vk_SpecConstant* p_constants,
+    size_t constants_count,
+    const Vk_VertexLayout* p_vertex_layout
+) {
+    VERIFY(p_constants || constants_count == 0, "NULL pointer");
+    VERIFY(constants_count <= VK_REFLECT_MAX_SPEC_CONSTANTS, "more than %d specialization constants", VK_REFLECT_MAX_SPEC_CONSTANTS);
+    bool                        matched[VK_REFLECT_MAX_SPEC_CONSTANTS] = {0};
+    VkSpecializationMapEntry    vertex_entries[VK_REFLECT_MAX_SPEC_CONSTANTS];
+    VkSpecializationMapEntry    fragment_entries[VK_REFLECT_MAX_SPEC_CONSTANTS];
+    unsigned int                vertex_data[VK_REFLECT_MAX_SPEC_CONSTANTS];
+    unsigned int                fragment_data[VK_REFLECT_MAX_SPEC_CONSTANTS];
+    unsigned int vertex_entries_count   = SpecializationEntries(spv_vertex_shader, p_constants, constants_count, vertex_entries, vertex_data, matched);
+    unsigned int fragment_entries_count = SpecializationEntries(spv_fragment_shader, p_constants, constants_count, fragment_entries, fragment_data, matched);
+    for (size_t i = 0; i < constants_count; ++i) {
+        VERIFY(matched[i], "no shader stage declares the specialization constant %s", p_constants[i].name);
+    }
+    VkSpecializationInfo vertex_specialization = {
+        .mapEntryCount = vertex_entries_count,
+        .pMapEntries   = vertex_entries,
+        .dataSize      = vertex_entries_count * sizeof(unsigned int),
+        .pData         = vertex_data,
+    };
+    VkSpecializationInfo fragment_specialization = {
+        .mapEntryCount = fragment_entries_count,
+        .pMapEntries   = fragment_entries,
+        .dataSize      = fragment_entries_count * sizeof(unsigned int),
+        .pData         = fragment_data,
+    };
+
+    // Attributes from the instance schema, the reflection only checks that the shader reads nothing else
+    VERIFY(spv_vertex_shader.p_reflection, "vertex shader is not reflected");
+    Vk_VertexLayout vertex_layout = p_vertex_layout ? *p_vertex_layout : vk_VertexLayout_ForShader(spv_vertex_shader.p_reflection);
+    TRACK(vk_VertexLayout_Verify(&vertex_layout, spv_vertex_shader.p_reflection));
+
+    // The opaque interior mesh draws without blending
+    bool blend = true;
+    for (size_t i = 0; i < constants_count; ++i) {
+        if (strcmp(p_constants[i].name, "INSTANCE_MESH") == 0) {
+            blend = vk_InstanceMesh_Blends(p_constants[i].value);
+        }
+    }
     
     VkGraphicsPipelineCreateInfo pipelineInfo = {
         .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
@@ -41,23 +151,25 @@ VkPipeline vk_Pipeline_Graphics_Create(
             .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .stage  = VK_SHADER_STAGE_VERTEX_BIT,
             .module = vk_ShaderModule_Create(p_vk, spv_vertex_shader),
-            .pName  = "main"
+            .pName  = "main",
+            .pSpecializationInfo = vertex_entries_count ? &vertex_specialization : NULL
         },{
             .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .stage  = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .module = vk_ShaderModule_CreateFromGlslFile(p_vk, "shaders/shader.frag.glsl", shaderc_glsl_fragment_shader),
-            .pName  = "main"
+            .module = vk_ShaderModule_Create(p_vk, spv_fragment_shader),
+            .pName  = "main",
+            .pSpecializationInfo = fragment_entries_count ? &fragment_specialization : NULL
         }},
         .pVertexInputState = &(VkPipelineVertexInputStateCreateInfo) {
             .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            .vertexBindingDescriptionCount   = 1,
+            .vertexBindingDescriptionCount   = vertex_layout.stride ? 1 : 0,
             .pVertexBindingDescriptions      = (VkVertexInputBindingDescription[1]) {{
                 .binding   = 0,
-                .stride    = vertex_binding_stride,
+                .stride    = vertex_layout.stride,
                 .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
             }},
-            .vertexAttributeDescriptionCount = vertex_attrib_count,
-            .pVertexAttributeDescriptions    = vertex_input_attrib_desc,
+            .vertexAttributeDescriptionCount = vertex_layout.attributes_count,
+            .pVertexAttributeDescriptions    = vertex_layout.p_attributes,
         }, 
         .pInputAssemblyState = &(VkPipelineInputAssemblyStateCreateInfo) {
             .sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -114,7 +226,7 @@ VkPipeline vk_Pipeline_Graphics_Create(
                                        VK_COLOR_COMPONENT_G_BIT | 
                                        VK_COLOR_COMPONENT_B_BIT | 
                                        VK_COLOR_COMPONENT_A_BIT,
-                .blendEnable         = VK_TRUE,
+                .blendEnable         = blend ? VK_TRUE : VK_FALSE,
                 .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
                 .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
                 .colorBlendOp        = VK_BLEND_OP_ADD,
@@ -135,7 +247,7 @@ VkPipeline vk_Pipeline_Graphics_Create(
     };
 
     VkPipeline graphicsPipeline;
-    if (vkCreateGraphicsPipelines(p_vk->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &graphicsPipeline) != VK_SUCCESS) {
+    if (vkCreateGraphicsPipelines(p_vk->device, p_vk->pipeline_cache, 1, &pipelineInfo, NULL, &graphicsPipeline) != VK_SUCCESS) {
         printf("Failed to create graphics pipeline\n");
         exit(EXIT_FAILURE);
     }
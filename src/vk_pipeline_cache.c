@@ -0,0 +1,103 @@
+#include "vk.h"
+
+// Saves come from the render thread, the shader watcher and startup tasks. Static since Vk is copied by value.
+static pthread_mutex_t save_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// The driver rejects foreign data too, checking first keeps a stale file from another GPU out of the log
+static bool HeaderMatches(const void* p_data, size_t size, const VkPhysicalDeviceProperties* p_props) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, p_data, sizeof(header));
+    return header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == p_props->vendorID &&
+           header.deviceID == p_props->deviceID &&
+           memcmp(header.pipelineCacheUUID, p_props->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// Loads the cache of this device and driver, a missing or mismatching file starts an empty one
+void vk_PipelineCache_Create(Vk* p_vk) {
+    VERIFY(p_vk, "NULL pointer");
+    VERIFY(p_vk->device != VK_NULL_HANDLE, "device is VK_NULL_HANDLE");
+
+    VkPhysicalDeviceProperties props;
+    TRACK(vkGetPhysicalDeviceProperties(p_vk->physical_device, &props));
+
+    // one file per vendor, device and driver build, so switching GPUs does not thrash a shared file
+    char dir[VK_CACHE_PATH_SIZE];
+    bool has_dir = vk_DiskCache_Directory(NULL, dir, sizeof(dir));
+    char uuid[VK_UUID_SIZE * 2 + 1];
+    for (unsigned int i = 0; i < VK_UUID_SIZE; ++i) {
+        snprintf(&uuid[i * 2], 3, "%02x", props.pipelineCacheUUID[i]);
+    }
+    snprintf(p_vk->pipeline_cache_path, sizeof(p_vk->pipeline_cache_path), "%s/pipelines_%04x_%04x_%s.bin", dir, props.vendorID, props.deviceID, uuid);
+    if (!has_dir) {
+        p_vk->pipeline_cache_path[0] = '\0';
+    }
+
+    size_t size = 0;
+    void* p_data = p_vk->pipeline_cache_path[0] ? vk_DiskCache_Read(p_vk->pipeline_cache_path, &size) : NULL;
+    if (size && !HeaderMatches(p_data, size, &props)) {
+        printf("Warning: ignoring pipeline cache %s, it belongs to another device or driver\n", p_vk->pipeline_cache_path);
+        size = 0;
+    }
+
+    VkPipelineCacheCreateInfo create_info = {
+        .sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = size,
+        .pInitialData    = size ? p_data : NULL,
+    };
+    TRACK(VkResult result = vkCreatePipelineCache(p_vk->device, &create_info, NULL, &p_vk->pipeline_cache));
+    if (result != VK_SUCCESS && size) {
+        // a corrupt file is not fatal, start over with an empty cache
+        printf("Warning: pipeline cache %s rejected by the driver (%d)\n", p_vk->pipeline_cache_path, result);
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = NULL;
+        size = 0;
+        TRACK(result = vkCreatePipelineCache(p_vk->device, &create_info, NULL, &p_vk->pipeline_cache));
+    }
+    VERIFY(result == VK_SUCCESS, "Failed to create pipeline cache\n");
+
+    p_vk->pipeline_cache_saved_size = size;
+    p_vk->pipeline_cache_saved_hash = size ? vk_Hash_Fnv1a64(VK_FNV1A64_INIT, p_data, size) : 0;
+    if (p_data) free(p_data);
+    printf("Pipeline cache %s: %zu bytes loaded\n", p_vk->pipeline_cache_path[0] ? p_vk->pipeline_cache_path : "(memory only)", size);
+}
+
+// Writes the cache when its data changed since the last save, the driver may replace entries without growing
+void vk_PipelineCache_Save(Vk* p_vk) {
+    VERIFY(p_vk, "NULL pointer");
+    if (p_vk->pipeline_cache == VK_NULL_HANDLE || p_vk->pipeline_cache_path[0] == '\0') {
+        return;
+    }
+
+    pthread_mutex_lock(&save_mutex);
+    size_t size = 0;
+    char* p_data = NULL;
+    TRACK(VkResult result = vkGetPipelineCacheData(p_vk->device, p_vk->pipeline_cache, &size, NULL));
+    if (result == VK_SUCCESS && size) {
+        TRACK(p_data = alloc(NULL, size));
+        TRACK(result = vkGetPipelineCacheData(p_vk->device, p_vk->pipeline_cache, &size, p_data));
+    }
+    if (result == VK_SUCCESS && size) {
+        uint64_t hash = vk_Hash_Fnv1a64(VK_FNV1A64_INIT, p_data, size);
+        bool changed = size != p_vk->pipeline_cache_saved_size || hash != p_vk->pipeline_cache_saved_hash;
+        if (changed && vk_DiskCache_WriteAtomic(p_vk->pipeline_cache_path, p_data, size)) {
+            p_vk->pipeline_cache_saved_size = size;
+            p_vk->pipeline_cache_saved_hash = hash;
+        }
+    }
+    if (p_data) free(p_data);
+    pthread_mutex_unlock(&save_mutex);
+}
+
+void vk_PipelineCache_Destroy(Vk* p_vk) {
+    VERIFY(p_vk, "NULL pointer");
+    if (p_vk->pipeline_cache == VK_NULL_HANDLE) {
+        return;
+    }
+    TRACK(vk_PipelineCache_Save(p_vk));
+    TRACK(vkDestroyPipelineCache(p_vk->device, p_vk->pipeline_cache, NULL));
+    p_vk->pipeline_cache = VK_NULL_HANDLE;
+}
@@ -0,0 +1,152 @@
+#include "vk.h"
+
+static void AppendBytes(unsigned char** pp_bytes, size_t* p_size, const void* p_data, size_t size) {
+    TRACK(*pp_bytes = alloc(*pp_bytes, *p_size + size));
+    memcpy(*pp_bytes + *p_size, p_data, size);
+    *p_size += size;
+}
+
+// Names and values in the order given, callers asking for the same variant pass them the same way. A define
+// without a value and one with an empty value differ.
+static unsigned char* VariantDescription(const Vk_ShaderDefine* p_defines, size_t defines_count, const Vk_SpecConstant* p_constants, size_t constants_count, size_t* p_size) {
+    unsigned char* p_bytes = NULL;
+    *p_size = 0;
+    for (size_t i = 0; i < defines_count; ++i) {
+        unsigned char has_value = p_defines[i].value != NULL;
+        AppendBytes(&p_bytes, p_size, p_defines[i].name, strlen(p_defines[i].name) + 1);
+        AppendBytes(&p_bytes, p_size, &has_value, 1);
+        if (has_value) {
+            AppendBytes(&p_bytes, p_size, p_defines[i].value, strlen(p_defines[i].value) + 1);
+        }
+    }
+    // keeps defines and constants apart
+    AppendBytes(&p_bytes, p_size, "|", 1);
+    for (size_t i = 0; i < constants_count; ++i) {
+        AppendBytes(&p_bytes, p_size, p_constants[i].name, strlen(p_constants[i].name) + 1);
+        AppendBytes(&p_bytes, p_size, &p_constants[i].value, sizeof(p_constants[i].value));
+    }
+    return p_bytes;
+}
+
+// The hash only narrows the search, a variant matches when its description is the same bytes
+static Vk_PipelineVariant* FindVariant(Vk_PipelineVariants* p_variants, uint64_t key, const unsigned char* p_description, size_t description_size) {
+    for (unsigned int i = 0; i < p_variants->variants_count; ++i) {
+        Vk_PipelineVariant* p_variant = &p_variants->variants[i];
+        if (p_variant->key == key && p_variant->description_size == description_size &&
+            memcmp(p_variant->p_description, p_description, description_size) == 0) {
+            return p_variant;
+        }
+    }
+    return NULL;
+}
+
+// Defines change the SPIR-V, so they go through the compiler and its disk cache. Without defines the
+// prebuilt or embedded SPIR-V is used.
+static SpvShader LoadShader(Vk* p_vk, const char* filename, shaderc_shader_kind shader_kind, const Vk_ShaderDefine* p_defines, size_t defines_count) {
+    if (defines_count == 0) {
+        return vk_SpvShader_Load(p_vk, filename, shader_kind);
+    }
+#ifdef VK_NO_SHADERC
+    (void)p_defines;
+    printf("'%s' needs shaderc for its defines, release builds can only vary specialization constants\n", filename);
+    exit(EXIT_FAILURE);
+#else
+    char* p_glsl_code = NULL;
+    size_t glsl_size = readFile(filename, &p_glsl_code);
+    TRACK(SpvShader spv_shader = vk_SpvShader_CreateWithDefines(p_vk, p_glsl_code, glsl_size, filename, shader_kind, p_defines, defines_count));
+    free(p_glsl_code);
+    return spv_shader;
+#endif
+}
+
+// Every variant shares the layout, so defines and constants may change code paths but not the interface.
+// p_vertex_layout may be NULL to use the reflected vertex inputs, otherwise it has to outlive the variants.
+Vk_PipelineVariants Vk_PipelineVariants_Create(Vk* p_vk, VkPipelineLayout pipeline_layout, const char* vertex_filename, const char* fragment_filename, const Vk_VertexLayout* p_vertex_layout) {
+    VERIFY(p_vk && vertex_filename && fragment_filename, "NULL pointer");
+    VERIFY(pipeline_layout != VK_NULL_HANDLE, "pipeline_layout is VK_NULL_HANDLE");
+
+    Vk_PipelineVariants variants;
+    memset(&variants, 0, sizeof(Vk_PipelineVariants));
+    variants.p_vk = p_vk;
+    variants.pipeline_layout = pipeline_layout;
+    variants.p_vertex_layout = p_vertex_layout;
+    snprintf(variants.vertex_filename, sizeof(variants.vertex_filename), "%s", vertex_filename);
+    snprintf(variants.fragment_filename, sizeof(variants.fragment_filename), "%s", fragment_filename);
+    return variants;
+}
+
+// The cached pipeline for these defines and constants, built on the first request
+VkPipeline Vk_PipelineVariants_Get(Vk_PipelineVariants* p_variants, const Vk_ShaderDefine* p_defines, size_t defines_count, const Vk_SpecConstant* p_constants, size_t constants_count) {
+    VERIFY(p_variants, "NULL pointer");
+    VERIFY(p_defines || defines_count == 0, "NULL pointer");
+    VERIFY(p_constants || constants_count == 0, "NULL pointer");
+
+    size_t description_size;
+    unsigned char* p_description = VariantDescription(p_defines, defines_count, p_constants, constants_count, &description_size);
+    uint64_t key = vk_Hash_Fnv1a64(VK_FNV1A64_INIT, p_description, description_size);
+    Vk_PipelineVariant* p_variant = FindVariant(p_variants, key, p_description, description_size);
+    if (p_variant) {
+        free(p_description);
+        return p_variant->pipeline;
+    }
+    VERIFY(p_variants->variants_count < VK_PIPELINE_VARIANTS_MAX, "more than %d variants of %s", VK_PIPELINE_VARIANTS_MAX, p_variants->fragment_filename);
+
+    Vk* p_vk = p_variants->p_vk;
+    TRACK(SpvShader spv_vertex_shader = LoadShader(p_vk, p_variants->vertex_filename, shaderc_vertex_shader, p_defines, defines_count));
+    TRACK(SpvShader spv_fragment_shader = LoadShader(p_vk, p_variants->fragment_filename, shaderc_fragment_shader, p_defines, defines_count));
+    TRACK(VkPipeline pipeline = vk_Pipeline_Graphics_CreateSpecialized(p_vk, p_variants->pipeline_layout, spv_vertex_shader, spv_fragment_shader, p_constants, constants_count, p_variants->p_vertex_layout));
+    free((void*)spv_vertex_shader.code);
+    free((void*)spv_fragment_shader.code);
+
+    p_variants->variants[p_variants->variants_count++] = (Vk_PipelineVariant){
+        .key              = key,
+        .p_description    = p_description,
+        .description_size = description_size,
+        .pipeline         = pipeline,
+    };
+    printf("Pipeline variant %016llx of %s built, %u cached\n", (unsigned long long)key, p_variants->fragment_filename, p_variants->variants_count);
+    return pipeline;
+}
+
+// For a pipeline built elsewhere from the same shaders, such as a hot reload, the cache owns it afterwards
+void Vk_PipelineVariants_Add(Vk_PipelineVariants* p_variants, const Vk_ShaderDefine* p_defines, size_t defines_count, const Vk_SpecConstant* p_constants, size_t constants_count, VkPipeline pipeline) {
+    VERIFY(p_variants, "NULL pointer");
+    VERIFY(p_defines || defines_count == 0, "NULL pointer");
+    VERIFY(p_constants || constants_count == 0, "NULL pointer");
+    VERIFY(pipeline != VK_NULL_HANDLE, "pipeline is VK_NULL_HANDLE");
+
+    size_t description_size;
+    unsigned char* p_description = VariantDescription(p_defines, defines_count, p_constants, constants_count, &description_size);
+    uint64_t key = vk_Hash_Fnv1a64(VK_FNV1A64_INIT, p_description, description_size);
+    Vk_PipelineVariant* p_variant = FindVariant(p_variants, key, p_description, description_size);
+    if (p_variant) {
+        TRACK(vk_DeletionQueue_RetirePipeline(p_variants->p_vk, p_variant->pipeline));
+        p_variant->pipeline = pipeline;
+        free(p_description);
+        return;
+    }
+    VERIFY(p_variants->variants_count < VK_PIPELINE_VARIANTS_MAX, "more than %d variants of %s", VK_PIPELINE_VARIANTS_MAX, p_variants->fragment_filename);
+    p_variants->variants[p_variants->variants_count++] = (Vk_PipelineVariant){
+        .key              = key,
+        .p_description    = p_description,
+        .description_size = description_size,
+        .pipeline         = pipeline,
+    };
+}
+
+// After the shaders changed every variant is stale, they are retired and built again on their next request
+void Vk_PipelineVariants_Invalidate(Vk_PipelineVariants* p_variants) {
+    VERIFY(p_variants, "NULL pointer");
+    for (unsigned int i = 0; i < p_variants->variants_count; ++i) {
+        TRACK(vk_DeletionQueue_RetirePipeline(p_variants->p_vk, p_variants->variants[i].pipeline));
+        free(p_variants->variants[i].p_description);
+    }
+    p_variants->variants_count = 0;
+}
+
+// The layout belongs to the caller, the pipelines are retired in case a frame still uses them
+void Vk_PipelineVariants_Destroy(Vk_PipelineVariants* p_variants) {
+    VERIFY(p_variants, "NULL pointer");
+    TRACK(Vk_PipelineVariants_Invalidate(p_variants));
+    memset(p_variants, 0, sizeof(Vk_PipelineVariants));
+}
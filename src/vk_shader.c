@@ -1,5 +1,8 @@
  #include "vk.h"
 
+#include <sys/stat.h>
+#include <time.h>
+
 
 size_t readFile(const char* filename, char** dst_buffer) {
     FILE* file = fopen(filename, "rb");
@@ -32,7 +35,258 @@ size_t readFile(const char* filename, char** dst_buffer) {
     fclose(file);
     return (unsigned int)file_size;
 }
+#ifndef VK_NO_SHADERC
+// Compiled SPIR-V cached on disk, named by SpvCacheKey: a header, the code and its reflection, the same
+// layout a reflected SpvShader has in memory. Bump the version when Vk_ShaderReflection changes.
+#define SPV_CACHE_MAGIC     0x5650534cu     // "LSPV"
+#define SPV_CACHE_VERSION   2
+
+typedef struct {
+    unsigned int    magic;
+    unsigned int    version;
+    uint64_t        key;
+    uint64_t        payload_hash;   // of the code and reflection, a torn or corrupt file is a miss
+    uint64_t        code_size;
+    uint64_t        reflection_size;
+} SpvCacheHeader;
+
+// #include "x" is looked up next to the including file and then in SHADER_INCLUDE_DIR, #include <x> only
+// in SHADER_INCLUDE_DIR. `make shaders` passes the same directory to glslc.
+#define SHADER_INCLUDE_DIR          "include"
+#define SHADER_INCLUDE_MAX_DEPTH    8
+
+static bool ResolveInclude(const char* p_requested, bool relative, const char* p_requesting, char* p_path, size_t size) {
+    const char* p_slash = p_requesting ? strrchr(p_requesting, '/') : NULL;
+    if (relative && p_slash) {
+        snprintf(p_path, size, "%.*s/%s", (int)(p_slash - p_requesting), p_requesting, p_requested);
+    } else if (relative) {
+        snprintf(p_path, size, "%s", p_requested);
+    }
+    struct stat file_stat;
+    if (relative && stat(p_path, &file_stat) == 0) {
+        return true;
+    }
+    snprintf(p_path, size, "%s/%s", SHADER_INCLUDE_DIR, p_requested);
+    return stat(p_path, &file_stat) == 0;
+}
+
+typedef struct {
+    shaderc_include_result  result;
+    char                    path[VK_CACHE_PATH_SIZE];
+    char*                   p_content;
+    char                    error[VK_CACHE_PATH_SIZE + 64];
+} ShaderInclude;
+
+// Include callbacks for shaderc, they keep no state so any thread may compile
+shaderc_include_result* vk_ShaderInclude_Resolve(void* p_user_data, const char* p_requested, int type, const char* p_requesting, size_t depth) {
+    (void)p_user_data;
+    (void)depth;
+    TRACK(ShaderInclude* p_include = alloc(NULL, sizeof(ShaderInclude)));
+    memset(p_include, 0, sizeof(ShaderInclude));
+
+    size_t content_size = 0;
+    if (ResolveInclude(p_requested, type == shaderc_include_type_relative, p_requesting, p_include->path, sizeof(p_include->path))) {
+        p_include->p_content = vk_DiskCache_Read(p_include->path, &content_size);
+    }
+    if (p_include->p_content) {
+        p_include->result.source_name        = p_include->path;
+        p_include->result.source_name_length = strlen(p_include->path);
+        p_include->result.content            = p_include->p_content;
+        p_include->result.content_length     = content_size;
+    } else {
+        // an empty source name tells shaderc the include failed, the content is the message
+        snprintf(p_include->error, sizeof(p_include->error), "cannot find or read '%s'", p_requested);
+        p_include->result.source_name        = "";
+        p_include->result.source_name_length = 0;
+        p_include->result.content            = p_include->error;
+        p_include->result.content_length     = strlen(p_include->error);
+    }
+    p_include->result.user_data = p_include;
+    return &p_include->result;
+}
+
+void vk_ShaderInclude_Release(void* p_user_data, shaderc_include_result* p_result) {
+    (void)p_user_data;
+    ShaderInclude* p_include = p_result->user_data;
+    if (p_include->p_content) free(p_include->p_content);
+    free(p_include);
+}
+
+// Advances *pp_line past the next #include line before p_code_end and returns its file name, which has
+// to hold 128 bytes. Includes in inactive #if blocks are found too.
+static bool NextInclude(const char** pp_line, const char* p_code_end, char* p_name, bool* p_relative) {
+    while (*pp_line < p_code_end) {
+        const char* p_end = memchr(*pp_line, '\n', (size_t)(p_code_end - *pp_line));
+        if (!p_end) {
+            p_end = p_code_end;
+        }
+        char line[256];
+        snprintf(line, sizeof(line), "%.*s", (int)(p_end - *pp_line), *pp_line);
+        *pp_line = p_end + 1;
+
+        char delimiter = 0;
+        if (sscanf(line, " # include %c%127[^\">]", &delimiter, p_name) == 2 && (delimiter == '"' || delimiter == '<')) {
+            *p_relative = delimiter == '"';
+            return true;
+        }
+    }
+    return false;
+}
+
+// Hashes every file the source includes, resolved like vk_ShaderInclude_Resolve does. Includes in inactive
+// #if blocks count too, which at worst costs a compile.
+static uint64_t HashIncludes(uint64_t hash, const char* p_code, size_t size, const char* p_filename, unsigned int depth) {
+    if (depth >= SHADER_INCLUDE_MAX_DEPTH) {
+        return hash;
+    }
+    const char* p_line = p_code;
+    char name[128];
+    bool relative;
+    while (NextInclude(&p_line, p_code + size, name, &relative)) {
+        char path[VK_CACHE_PATH_SIZE];
+        size_t include_size = 0;
+        char* p_include = ResolveInclude(name, relative, p_filename, path, sizeof(path)) ? vk_DiskCache_Read(path, &include_size) : NULL;
+        // a missing file fails the compile, its name still goes in so adding it later changes the key
+        hash = vk_Hash_Fnv1a64(hash, name, strlen(name) + 1);
+        if (p_include) {
+            uint64_t include_size_64 = include_size;
+            hash = vk_Hash_Fnv1a64(hash, &include_size_64, sizeof(include_size_64));
+            hash = vk_Hash_Fnv1a64(hash, p_include, include_size);
+            hash = HashIncludes(hash, p_include, include_size, path, depth + 1);
+            free(p_include);
+        }
+    }
+    return hash;
+}
+
+// The newest modification time of p_filename and everything it includes, a .spv older than any of them
+// is out of date. 0 when p_filename cannot be read.
+static time_t NewestSourceTime(const char* p_filename, unsigned int depth) {
+    struct stat file_stat;
+    if (depth >= SHADER_INCLUDE_MAX_DEPTH || stat(p_filename, &file_stat) != 0) {
+        return 0;
+    }
+    time_t newest = file_stat.st_mtime;
+    size_t size = 0;
+    char* p_code = vk_DiskCache_Read(p_filename, &size);
+    if (!p_code) {
+        return newest;
+    }
+    const char* p_line = p_code;
+    char name[128];
+    bool relative;
+    while (NextInclude(&p_line, p_code + size, name, &relative)) {
+        char path[VK_CACHE_PATH_SIZE];
+        if (ResolveInclude(name, relative, p_filename, path, sizeof(path))) {
+            time_t include_time = NewestSourceTime(path, depth + 1);
+            newest = include_time > newest ? include_time : newest;
+        }
+    }
+    free(p_code);
+    return newest;
+}
+
+// Everything that decides the output: source text and the files it includes, stage, defines and compiler
+// options
+static uint64_t SpvCacheKey(Vk* p_vk, const char* p_glsl_code, size_t glsl_size, const char* glsl_filename, shaderc_shader_kind shader_kind, const Vk_ShaderDefine* p_defines, size_t defines_count) {
+    uint64_t hash = vk_Hash_Fnv1a64(VK_FNV1A64_INIT, &p_vk->shaderc_options_hash, sizeof(uint64_t));
+    unsigned int kind = (unsigned int)shader_kind;
+    hash = vk_Hash_Fnv1a64(hash, &kind, sizeof(kind));
+    uint64_t size = glsl_size;
+    hash = vk_Hash_Fnv1a64(hash, &size, sizeof(size));
+    hash = vk_Hash_Fnv1a64(hash, p_glsl_code, glsl_size);
+    hash = HashIncludes(hash, p_glsl_code, glsl_size, glsl_filename, 0);
+    for (size_t i = 0; i < defines_count; ++i) {
+        // the terminators keep {"AB", "C"} and {"A", "BC"} apart, a missing value differs from an empty one
+        hash = vk_Hash_Fnv1a64(hash, p_defines[i].name, strlen(p_defines[i].name) + 1);
+        hash = p_defines[i].value ? vk_Hash_Fnv1a64(hash, p_defines[i].value, strlen(p_defines[i].value) + 1)
+                                  : vk_Hash_Fnv1a64(hash, "\x01", 1);
+    }
+    return hash;
+}
+
+static bool SpvCacheLoad(Vk* p_vk, uint64_t key, SpvShader* p_spv_shader) {
+    char path[VK_CACHE_PATH_SIZE + 32];
+    snprintf(path, sizeof(path), "%s/%016llx.spv", p_vk->spv_cache_dir, (unsigned long long)key);
+    size_t size = 0;
+    unsigned char* p_data = vk_DiskCache_Read(path, &size);
+    if (!p_data) {
+        return false;
+    }
+
+    SpvCacheHeader header;
+    bool valid = size > sizeof(header);
+    if (valid) {
+        memcpy(&header, p_data, sizeof(header));
+        valid = header.magic == SPV_CACHE_MAGIC && header.version == SPV_CACHE_VERSION && header.key == key &&
+                header.reflection_size == sizeof(Vk_ShaderReflection) && header.code_size % 4 == 0 &&
+                header.code_size + header.reflection_size == size - sizeof(header) &&
+                header.payload_hash == vk_Hash_Fnv1a64(VK_FNV1A64_INIT, p_data + sizeof(header), size - sizeof(header));
+    }
+    if (valid) {
+        // SPIRV-Reflect is skipped entirely on a hit
+        TRACK(unsigned char* p_block = alloc(NULL, size - sizeof(header)));
+        memcpy(p_block, p_data + sizeof(header), size - sizeof(header));
+        p_spv_shader->code = (const unsigned int*)p_block;
+        p_spv_shader->size = header.code_size;
+        p_spv_shader->p_reflection = (const Vk_ShaderReflection*)(p_block + header.code_size);
+    }
+    free(p_data);
+    return valid;
+}
+
+// Racing writers of the same key produce identical files, whichever rename lands last wins
+static void SpvCacheStore(Vk* p_vk, uint64_t key, SpvShader spv_shader) {
+    VERIFY(spv_shader.p_reflection, "only reflected shaders are cached");
+    size_t payload_size = spv_shader.size + sizeof(Vk_ShaderReflection);
+    SpvCacheHeader header = {
+        .magic           = SPV_CACHE_MAGIC,
+        .version         = SPV_CACHE_VERSION,
+        .key             = key,
+        .code_size       = spv_shader.size,
+        .reflection_size = sizeof(Vk_ShaderReflection),
+    };
+    TRACK(unsigned char* p_data = alloc(NULL, sizeof(header) + payload_size));
+    memcpy(p_data + sizeof(header), spv_shader.code, spv_shader.size);
+    memcpy(p_data + sizeof(header) + spv_shader.size, spv_shader.p_reflection, sizeof(Vk_ShaderReflection));
+    header.payload_hash = vk_Hash_Fnv1a64(VK_FNV1A64_INIT, p_data + sizeof(header), payload_size);
+    memcpy(p_data, &header, sizeof(header));
+
+    char path[VK_CACHE_PATH_SIZE + 32];
+    snprintf(path, sizeof(path), "%s/%016llx.spv", p_vk->spv_cache_dir, (unsigned long long)key);
+    vk_DiskCache_WriteAtomic(path, p_data, sizeof(header) + payload_size);
+    free(p_data);
+}
+
 SpvShader vk_SpvShader_Create(Vk* p_vk, const char* p_glsl_code, size_t glsl_size, const char* glsl_filename, shaderc_shader_kind shader_kind) {
+    return vk_SpvShader_CreateWithDefines(p_vk, p_glsl_code, glsl_size, glsl_filename, shader_kind, NULL, 0);
+}
+
+// An unchanged shader is read back from the SPIR-V cache instead of being compiled again. Compile errors
+// are printed and return false.
+static bool TryCompile(Vk* p_vk, const char* p_glsl_code, size_t glsl_size, const char* glsl_filename, shaderc_shader_kind shader_kind, const Vk_ShaderDefine* p_defines, size_t defines_count, SpvShader* p_spv_shader) {
+    VERIFY(p_vk && p_glsl_code && p_spv_shader, "NULL pointer");
+    VERIFY(p_defines || defines_count == 0, "NULL pointer");
+
+    uint64_t key = 0;
+    if (p_vk->spv_cache_dir[0]) {
+        key = SpvCacheKey(p_vk, p_glsl_code, glsl_size, glsl_filename, shader_kind, p_defines, defines_count);
+        SpvShader cached = {0};
+        if (SpvCacheLoad(p_vk, key, &cached)) {
+            *p_spv_shader = cached;
+            return true;
+        }
+    }
+
+    // Defines go into a copy of the shared options, so threads can compile at the same time
+    shaderc_compile_options_t options = p_vk->shaderc_options;
+    if (defines_count) {
+        options = shaderc_compile_options_clone(p_vk->shaderc_options);
+        for (size_t i = 0; i < defines_count; ++i) {
+            const char* p_value = p_defines[i].value ? p_defines[i].value : "";
+            shaderc_compile_options_add_macro_definition(options, p_defines[i].name, strlen(p_defines[i].name), p_value, strlen(p_value));
+        }
+    }
 
     // Compile the GLSL code to SPIR-V
     shaderc_compilation_result_t result = shaderc_compile_into_spv(
@@ -42,14 +296,17 @@ SpvShader vk_SpvShader_Create(Vk* p_vk, const char* p_glsl_code, size_t glsl_siz
         shader_kind,
         glsl_filename,
         "main",
-        p_vk->shaderc_options
+        options
     );
+    if (options != p_vk->shaderc_options) {
+        shaderc_compile_options_release(options);
+    }
 
     // Check for compilation errors
     if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success) {
         printf("Shader compilation error in '%s':\n%s\n", glsl_filename, shaderc_result_get_error_message(result));
         shaderc_result_release(result);
-        exit(-1);
+        return false;
     }
 
     // Get the SPIR-V code size and pointer
@@ -80,6 +337,19 @@ SpvShader vk_SpvShader_Create(Vk* p_vk, const char* p_glsl_code, size_t glsl_siz
         exit(-1);
     }
 
+    TRACK(vk_SpvShader_Reflect(&spv_shader));
+    if (p_vk->spv_cache_dir[0]) {
+        SpvCacheStore(p_vk, key, spv_shader);
+    }
+    *p_spv_shader = spv_shader;
+    return true;
+}
+
+SpvShader vk_SpvShader_CreateWithDefines(Vk* p_vk, const char* p_glsl_code, size_t glsl_size, const char* glsl_filename, shaderc_shader_kind shader_kind, const Vk_ShaderDefine* p_defines, size_t defines_count) {
+    SpvShader spv_shader = {0};
+    if (!TryCompile(p_vk, p_glsl_code, glsl_size, glsl_filename, shader_kind, p_defines, defines_count, &spv_shader)) {
+        exit(-1);
+    }
     return spv_shader;
 }
 SpvShader vk_SpvShader_CreateFromGlslFile(Vk* p_vk, const char* glsl_filename, shaderc_shader_kind shader_kind) {
@@ -90,6 +360,18 @@ SpvShader vk_SpvShader_CreateFromGlslFile(Vk* p_vk, const char* glsl_filename, s
 
     return spv_shader;
 }
+// For reloading while running: a missing file or a compile error leaves p_spv_shader alone and returns false
+bool vk_SpvShader_TryCreateFromGlslFile(Vk* p_vk, const char* glsl_filename, shaderc_shader_kind shader_kind, SpvShader* p_spv_shader) {
+    size_t glsl_code_size = 0;
+    char* p_glsl_code = vk_DiskCache_Read(glsl_filename, &glsl_code_size);
+    if (!p_glsl_code) {
+        printf("Failed to read shader source '%s'\n", glsl_filename);
+        return false;
+    }
+    bool compiled = TryCompile(p_vk, p_glsl_code, glsl_code_size, glsl_filename, shader_kind, NULL, 0, p_spv_shader);
+    free(p_glsl_code);
+    return compiled;
+}
 void vk_SpvShader_CreateSpvFileFromGlslFile(Vk* p_vk, const char* glsl_filename, const char* spv_filename, shaderc_shader_kind shader_kind) {
     SpvShader spv_shader = vk_SpvShader_CreateFromGlslFile(p_vk, glsl_filename, shader_kind);
     FILE* spv_file = fopen(spv_filename, "wb");
@@ -98,6 +380,68 @@ void vk_SpvShader_CreateSpvFileFromGlslFile(Vk* p_vk, const char* glsl_filename,
     VERIFY(written == spv_shader.size, "?");
     fclose(spv_file);
 }
+#endif
+
+// SPIR-V built by `make shaders`, the caller owns the code like that of a compiled shader. Like every
+// loader it returns the shader reflected.
+SpvShader vk_SpvShader_CreateFromSpvFile(const char* spv_filename) {
+    char* p_code = NULL;
+    size_t size = readFile(spv_filename, &p_code);
+    VERIFY(size >= 4 && size % 4 == 0, "'%s' is not SPIR-V, its size is %zu\n", spv_filename, size);
+    VERIFY(((const unsigned int*)p_code)[0] == 0x07230203, "'%s' is not SPIR-V, bad magic number\n", spv_filename);
+
+    SpvShader spv_shader = {
+        .code = (const unsigned int*)p_code,
+        .size = size
+    };
+    TRACK(vk_SpvShader_Reflect(&spv_shader));
+    return spv_shader;
+}
+
+static bool FileModifiedTime(const char* filename, time_t* p_time) {
+    struct stat file_stat;
+    if (stat(filename, &file_stat) != 0) {
+        return false;
+    }
+    *p_time = file_stat.st_mtime;
+    return true;
+}
+
+// Embedded SPIR-V first, then a .spv next to the source that is not older than it or any file it includes,
+// and only then the GLSL through shaderc. Builds without shaderc stop at the .spv.
+SpvShader vk_SpvShader_Load(Vk* p_vk, const char* glsl_filename, shaderc_shader_kind shader_kind) {
+    VERIFY(glsl_filename, "NULL pointer");
+
+    // shaders/x.frag.glsl is built to shaders/x.frag.spv
+    char spv_filename[512];
+    size_t length = strlen(glsl_filename);
+    if (length > 5 && strcmp(&glsl_filename[length - 5], ".glsl") == 0) {
+        length -= 5;
+    }
+    snprintf(spv_filename, sizeof(spv_filename), "%.*s.spv", (int)length, glsl_filename);
+
+    SpvShader spv_shader = {0};
+    if (vk_SpvShader_FindEmbedded(spv_filename, &spv_shader)) {
+        TRACK(vk_SpvShader_Reflect(&spv_shader));
+        return spv_shader;
+    }
+
+    time_t spv_time;
+    bool has_spv = FileModifiedTime(spv_filename, &spv_time);
+#ifdef VK_NO_SHADERC
+    (void)p_vk;
+    (void)shader_kind;
+    VERIFY(has_spv, "'%s' is neither embedded nor on disk, run `make shaders`\n", spv_filename);
+    return vk_SpvShader_CreateFromSpvFile(spv_filename);
+#else
+    // a missing source counts as time 0, the .spv is then used as is
+    if (has_spv && spv_time >= NewestSourceTime(glsl_filename, 0)) {
+        return vk_SpvShader_CreateFromSpvFile(spv_filename);
+    }
+    return vk_SpvShader_CreateFromGlslFile(p_vk, glsl_filename, shader_kind);
+#endif
+}
+
 SpvReflectShaderModule vk_SpvReflectShaderModule_Create(SpvShader spv_shader) {
     SpvReflectShaderModule shaderModuleReflection;
     SpvReflectResult reflectResult = spvReflectCreateShaderModule(spv_shader.size, spv_shader.code, &shaderModuleReflection);
@@ -108,6 +452,102 @@ SpvReflectShaderModule vk_SpvReflectShaderModule_Create(SpvShader spv_shader) {
 
     return shaderModuleReflection;
 }
+
+// The single SPIRV-Reflect pass, everything later works from the compact result
+static void Reflect(const unsigned int* p_code, size_t size, Vk_ShaderReflection* p_reflection) {
+    SpvReflectShaderModule module;
+    TRACK(SpvReflectResult result = spvReflectCreateShaderModule(size, p_code, &module));
+    VERIFY(result == SPV_REFLECT_RESULT_SUCCESS, "Failed to create SPIRV-Reflect shader module\n");
+
+    memset(p_reflection, 0, sizeof(Vk_ShaderReflection));
+    p_reflection->stage = (VkShaderStageFlagBits)module.shader_stage;
+    if (module.entry_point_count > 0) {
+        p_reflection->local_size[0] = module.entry_points[0].local_size.x;
+        p_reflection->local_size[1] = module.entry_points[0].local_size.y;
+        p_reflection->local_size[2] = module.entry_points[0].local_size.z;
+    }
+
+    // vertex inputs are kept sorted by location while inserting
+    if (module.shader_stage == SPV_REFLECT_SHADER_STAGE_VERTEX_BIT) {
+        for (unsigned int i = 0; i < module.input_variable_count; ++i) {
+            const SpvReflectInterfaceVariable* p_var = module.input_variables[i];
+            if (p_var->decoration_flags & SPV_REFLECT_DECORATION_BUILT_IN) {
+                continue;
+            }
+            VERIFY(p_reflection->inputs_count < VK_REFLECT_MAX_INPUTS, "more than %d vertex inputs", VK_REFLECT_MAX_INPUTS);
+            unsigned int j = p_reflection->inputs_count++;
+            while (j > 0 && p_reflection->inputs[j - 1].location > p_var->location) {
+                p_reflection->inputs[j] = p_reflection->inputs[j - 1];
+                j--;
+            }
+            p_reflection->inputs[j] = (Vk_ReflectedInput){ .location = p_var->location, .format = (VkFormat)p_var->format };
+        }
+    }
+
+    VERIFY(module.descriptor_binding_count <= VK_REFLECT_MAX_BINDINGS, "more than %d descriptor bindings", VK_REFLECT_MAX_BINDINGS);
+    for (unsigned int i = 0; i < module.descriptor_binding_count; ++i) {
+        const SpvReflectDescriptorBinding* p_binding = &module.descriptor_bindings[i];
+        p_reflection->bindings[p_reflection->bindings_count++] = (Vk_ReflectedBinding){
+            .set     = p_binding->set,
+            .binding = p_binding->binding,
+            .type    = (VkDescriptorType)p_binding->descriptor_type,
+            .count   = p_binding->count,
+        };
+    }
+
+    // one range from the first to the last member this stage declares
+    for (unsigned int i = 0; i < module.push_constant_block_count; ++i) {
+        const SpvReflectBlockVariable* p_block = &module.push_constant_blocks[i];
+        for (unsigned int j = 0; j < (p_block->member_count ? p_block->member_count : 1); ++j) {
+            const SpvReflectBlockVariable* p_member = p_block->member_count ? &p_block->members[j] : p_block;
+            unsigned int begin = p_member->offset;
+            unsigned int end   = p_member->offset + p_member->size;
+            if (p_reflection->push_constant_size == 0) {
+                p_reflection->push_constant_offset = begin;
+                p_reflection->push_constant_size   = end - begin;
+                continue;
+            }
+            unsigned int range_end = p_reflection->push_constant_offset + p_reflection->push_constant_size;
+            p_reflection->push_constant_offset = begin < p_reflection->push_constant_offset ? begin : p_reflection->push_constant_offset;
+            p_reflection->push_constant_size   = (end > range_end ? end : range_end) - p_reflection->push_constant_offset;
+        }
+    }
+
+    VERIFY(module.spec_constant_count <= VK_REFLECT_MAX_SPEC_CONSTANTS, "more than %d specialization constants", VK_REFLECT_MAX_SPEC_CONSTANTS);
+    for (unsigned int i = 0; i < module.spec_constant_count; ++i) {
+        Vk_ReflectedSpecConstant* p_constant = &p_reflection->spec_constants[p_reflection->spec_constants_count++];
+        p_constant->constant_id = module.spec_constants[i].constant_id;
+        snprintf(p_constant->name, sizeof(p_constant->name), "%s", module.spec_constants[i].name ? module.spec_constants[i].name : "");
+    }
+
+    spvReflectDestroyShaderModule(&module);
+}
+
+// The code has to be a block the caller owns, it is reallocated to carry the reflection and may move
+void vk_SpvShader_Reflect(SpvShader* p_spv_shader) {
+    VERIFY(p_spv_shader && p_spv_shader->code, "NULL pointer");
+    if (p_spv_shader->p_reflection) {
+        return;
+    }
+    _Static_assert(_Alignof(Vk_ShaderReflection) <= 4, "the reflection follows the code words");
+    Vk_ShaderReflection reflection;
+    TRACK(Reflect(p_spv_shader->code, p_spv_shader->size, &reflection));
+    TRACK(unsigned char* p_block = alloc((void*)p_spv_shader->code, p_spv_shader->size + sizeof(Vk_ShaderReflection)));
+    memcpy(p_block + p_spv_shader->size, &reflection, sizeof(Vk_ShaderReflection));
+    p_spv_shader->code = (const unsigned int*)p_block;
+    p_spv_shader->p_reflection = (const Vk_ShaderReflection*)(p_block + p_spv_shader->size);
+}
+
+// The stored reflection when the shader has one, a fresh pass otherwise
+Vk_ShaderReflection vk_ShaderReflection_Create(SpvShader spv_shader) {
+    VERIFY(spv_shader.code, "NULL pointer");
+    if (spv_shader.p_reflection) {
+        return *spv_shader.p_reflection;
+    }
+    Vk_ShaderReflection reflection;
+    TRACK(Reflect(spv_shader.code, spv_shader.size, &reflection));
+    return reflection;
+}
 VkShaderModule vk_ShaderModule_Create(Vk* p_vk, SpvShader spv_shader) {
     VkShaderModuleCreateInfo create_info = {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
@@ -123,6 +563,7 @@ VkShaderModule vk_ShaderModule_Create(Vk* p_vk, SpvShader spv_shader) {
 
     return shader_module;
 }
+#ifndef VK_NO_SHADERC
 VkShaderModule vk_ShaderModule_CreateFromGlslFile(Vk* p_vk, const char* filename, shaderc_shader_kind shader_kind) {
 
 	char* p_glsl_code = NULL;
@@ -132,6 +573,7 @@ VkShaderModule vk_ShaderModule_CreateFromGlslFile(Vk* p_vk, const char* filename
 
     return vk_ShaderModule_Create(p_vk, spv_shader);
 }
+#endif
 
 static uint32_t FormatSize(VkFormat format) {
   uint32_t result = 0;
@@ -515,83 +957,27 @@ static uint32_t FormatSize(VkFormat format) {
   return result;
 }
 VkVertexInputAttributeDescription* vk_VertexInputAttributeDescriptions_CreateFromVertexShader( SpvShader spv_shader, uint32_t* p_attribute_count, uint32_t* p_binding_stride) {
+    Vk_ShaderReflection reflection = vk_ShaderReflection_Create(spv_shader);
+    return vk_VertexInputAttributeDescriptions_CreateFromReflection(&reflection, p_attribute_count, p_binding_stride);
+}
 
-    // Create SPIRV-Reflect shader module
-    SpvReflectShaderModule shader_module;
-    SpvReflectResult result = spvReflectCreateShaderModule(spv_shader.size, spv_shader.code, &shader_module);
-    if (result != SPV_REFLECT_RESULT_SUCCESS) {
-        printf("Failed to create SPIRV-Reflect shader module\n");
-        exit(EXIT_FAILURE);
-    }
-
-    // Ensure the shader module is a vertex shader
-    if (shader_module.shader_stage != SPV_REFLECT_SHADER_STAGE_VERTEX_BIT) {
-        printf("Provided shader is not a vertex shader\n");
-        exit(EXIT_FAILURE);
-    }
-
-    // Enumerate input variables
-    uint32_t input_var_count = 0;
-    result = spvReflectEnumerateInputVariables(&shader_module, &input_var_count, NULL);
-    if (result != SPV_REFLECT_RESULT_SUCCESS) {
-        printf("Failed to enumerate input variables\n");
-        exit(EXIT_FAILURE);
-    }
-
-    SpvReflectInterfaceVariable** input_vars = alloc(NULL, input_var_count * sizeof(SpvReflectInterfaceVariable*));
-    if (!input_vars) {
-        printf("Failed to allocate memory for input variables\n");
-        exit(EXIT_FAILURE);
-    }
-
-    result = spvReflectEnumerateInputVariables(&shader_module, &input_var_count, input_vars);
-    if (result != SPV_REFLECT_RESULT_SUCCESS) {
-        printf("Failed to get input variables\n");
-        exit(EXIT_FAILURE);
-    }
-
-    // Create an array to hold VkVertexInputAttributeDescription
-    VkVertexInputAttributeDescription* attribute_descriptions = alloc(NULL, input_var_count * sizeof(VkVertexInputAttributeDescription));
-    if (!attribute_descriptions) {
-        printf("Failed to allocate memory for vertex input attribute descriptions\n");
-        exit(EXIT_FAILURE);
-    }
-
-    uint32_t attribute_index = 0;
-    for (uint32_t i = 0; i < input_var_count; ++i) {
-        SpvReflectInterfaceVariable* refl_var = input_vars[i];
-
-        // Ignore built-in variables
-        if (refl_var->decoration_flags & SPV_REFLECT_DECORATION_BUILT_IN) {
-            continue;
-        }
-
-        VkVertexInputAttributeDescription attr_desc = {};
-        attr_desc.location = refl_var->location;
-        attr_desc.binding = 0;
-        attr_desc.format = (VkFormat)refl_var->format;
-        attr_desc.offset = 0; // WILL CALCULATE OFFSET LATER
-        attribute_descriptions[attribute_index++] = attr_desc;
-    }
-
-    // Update the attribute count
-    *p_attribute_count = attribute_index;
+// Offsets assume the buffer holds the reflected types back to back at 4 byte alignment. Instance buffers
+// use the layouts generated from instance_layout.inl instead.
+VkVertexInputAttributeDescription* vk_VertexInputAttributeDescriptions_CreateFromReflection( const Vk_ShaderReflection* p_reflection, uint32_t* p_attribute_count, uint32_t* p_binding_stride) {
+    VERIFY(p_reflection && p_attribute_count && p_binding_stride, "NULL pointer");
+    VERIFY(p_reflection->stage == VK_SHADER_STAGE_VERTEX_BIT, "Provided shader is not a vertex shader");
 
-    // Sort attributes by location
-    for (uint32_t i = 0; i < attribute_index - 1; ++i) {
-        for (uint32_t j = 0; j < attribute_index - i - 1; ++j) {
-            if (attribute_descriptions[j].location > attribute_descriptions[j + 1].location) {
-                VkVertexInputAttributeDescription temp = attribute_descriptions[j];
-                attribute_descriptions[j] = attribute_descriptions[j + 1];
-                attribute_descriptions[j + 1] = temp;
-            }
-        }
-    }
+    // Create an array to hold VkVertexInputAttributeDescription, the inputs are already sorted by location
+    TRACK(VkVertexInputAttributeDescription* attribute_descriptions = alloc(NULL, (p_reflection->inputs_count ? p_reflection->inputs_count : 1) * sizeof(VkVertexInputAttributeDescription)));
 
     // Compute offsets and binding stride
     uint32_t offset = 0;
-    for (uint32_t i = 0; i < attribute_index; ++i) {
+    for (uint32_t i = 0; i < p_reflection->inputs_count; ++i) {
         VkVertexInputAttributeDescription* attr_desc = &attribute_descriptions[i];
+        attr_desc->location = p_reflection->inputs[i].location;
+        attr_desc->binding = 0;
+        attr_desc->format = p_reflection->inputs[i].format;
+        attr_desc->offset = 0;
         uint32_t format_size = FormatSize(attr_desc->format);
 
         if (format_size == 0) {
@@ -606,9 +992,8 @@ VkVertexInputAttributeDescription* vk_VertexInputAttributeDescriptions_CreateFro
         offset += format_size;
     }
 
+    *p_attribute_count = p_reflection->inputs_count;
     *p_binding_stride = offset;
-    free(input_vars);
-    spvReflectDestroyShaderModule(&shader_module);
 
     print_attribute_descriptions(attribute_descriptions, *p_attribute_count);
 
@@ -0,0 +1,56 @@
+#include "vk.h"
+
+#ifdef VK_EMBED_SHADERS
+
+// embedded_shaders.inc is generated by `make release`, one VK_EMBEDDED_SHADER(symbol, "shaders/x.spv") per shader.
+// The assembler pulls every .spv into .rodata, so the binary runs without the shaders directory.
+#define VK_EMBEDDED_SHADER(symbol, path)            \
+    __asm__(".section .rodata\n"                    \
+            ".balign 4\n"                           \
+            #symbol "_begin:\n"                     \
+            ".incbin \"" path "\"\n"                \
+            #symbol "_end:\n"                       \
+            ".previous\n");                         \
+    extern const unsigned int symbol##_begin[];     \
+    extern const unsigned int symbol##_end[];
+#include "embedded_shaders.inc"
+#undef VK_EMBEDDED_SHADER
+
+typedef struct {
+    const char*         p_path;
+    const unsigned int* p_begin;
+    const unsigned int* p_end;
+} EmbeddedShader;
+
+static const EmbeddedShader embedded_shaders[] = {
+#define VK_EMBEDDED_SHADER(symbol, path) { path, symbol##_begin, symbol##_end },
+#include "embedded_shaders.inc"
+#undef VK_EMBEDDED_SHADER
+};
+
+// The code is copied, so the caller owns it the same way as a shader read from disk
+bool vk_SpvShader_FindEmbedded(const char* spv_filename, SpvShader* p_spv_shader) {
+    VERIFY(spv_filename && p_spv_shader, "NULL pointer");
+    for (size_t i = 0; i < sizeof(embedded_shaders) / sizeof(embedded_shaders[0]); ++i) {
+        if (strcmp(embedded_shaders[i].p_path, spv_filename) != 0) {
+            continue;
+        }
+        size_t size = (size_t)((const char*)embedded_shaders[i].p_end - (const char*)embedded_shaders[i].p_begin);
+        TRACK(unsigned int* p_code = alloc(NULL, size));
+        memcpy(p_code, embedded_shaders[i].p_begin, size);
+        p_spv_shader->code = p_code;
+        p_spv_shader->size = size;
+        return true;
+    }
+    return false;
+}
+
+#else
+
+bool vk_SpvShader_FindEmbedded(const char* spv_filename, SpvShader* p_spv_shader) {
+    (void)spv_filename;
+    (void)p_spv_shader;
+    return false;
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include "vk.h"
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define DEBOUNCE_MS 50
+
+static bool IsWatchedFile(const Vk_ShaderWatch* p_watch, const char* p_name) {
+    for (unsigned int i = 0; i < p_watch->files_count; ++i) {
+        if (strcmp(p_watch->files[i], p_name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Drains the inotify queue, true if one of the watched files was written or replaced
+static bool ReadEvents(Vk_ShaderWatch* p_watch) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    for (;;) {
+        ssize_t length = read(p_watch->inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return changed;
+        }
+        for (char* p = buffer; p < buffer + length; ) {
+            const struct inotify_event* p_event = (const struct inotify_event*)p;
+            if (p_event->len && IsWatchedFile(p_watch, p_event->name)) {
+                changed = true;
+            }
+            p += sizeof(struct inotify_event) + p_event->len;
+        }
+    }
+}
+
+// Builds the new pipeline here, so the render thread only swaps a handle. A failed build keeps whatever
+// is running and waits for the next save.
+static void* WatchThread(void* p_arg) {
+    Vk_ShaderWatch* p_watch = p_arg;
+    struct pollfd fds[2] = {
+        { .fd = p_watch->inotify_fd,  .events = POLLIN },
+        { .fd = p_watch->stop_fds[0], .events = POLLIN },
+    };
+    bool dirty = false;
+    for (;;) {
+        // editors write in several steps, wait until the files have been quiet for a moment
+        int ready = poll(fds, 2, dirty ? DEBOUNCE_MS : -1);
+        if (ready < 0) {
+            continue;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        if (fds[0].revents) {
+            dirty = ReadEvents(p_watch) || dirty;
+            continue;
+        }
+        if (!dirty) {
+            continue;
+        }
+        dirty = false;
+
+        printf("Shader change detected, rebuilding\n");
+        VkPipeline pipeline = p_watch->build(p_watch->p_arg);
+        if (pipeline == VK_NULL_HANDLE) {
+            printf("Shader reload failed, keeping the current pipeline\n");
+            continue;
+        }
+
+        pthread_mutex_lock(&p_watch->mutex);
+        VkPipeline superseded = p_watch->pending;
+        p_watch->pending = pipeline;
+        __atomic_add_fetch(&p_watch->generation, 1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&p_watch->mutex);
+
+        // never handed to the render thread, so the GPU has not seen it
+        if (superseded != VK_NULL_HANDLE) {
+            vkDestroyPipeline(p_watch->p_vk->device, superseded, NULL);
+        }
+    }
+    DebugThreadEnd();
+    return NULL;
+}
+
+// Watches files in one directory, p_files are paths like "shaders/shader.frag.glsl". build runs on the
+// watcher thread after a change, apply on the render thread from Vk_ShaderWatch_Apply.
+void Vk_ShaderWatch_Start(Vk_ShaderWatch* p_watch, Vk* p_vk, const char** p_files, unsigned int files_count, Vk_ShaderWatchBuild build, Vk_ShaderWatchApply apply, void* p_arg) {
+    VERIFY(p_watch && p_vk && p_files && build && apply, "NULL pointer");
+    VERIFY(files_count > 0 && files_count <= VK_SHADER_WATCH_MAX_FILES, "watching %u files, at most %d", files_count, VK_SHADER_WATCH_MAX_FILES);
+
+    memset(p_watch, 0, sizeof(Vk_ShaderWatch));
+    p_watch->p_vk = p_vk;
+    p_watch->build = build;
+    p_watch->apply = apply;
+    p_watch->p_arg = p_arg;
+    p_watch->inotify_fd = -1;
+
+    // inotify reports names relative to the watched directory
+    for (unsigned int i = 0; i < files_count; ++i) {
+        const char* p_slash = strrchr(p_files[i], '/');
+        char directory[VK_CACHE_PATH_SIZE];
+        snprintf(directory, sizeof(directory), "%.*s", p_slash ? (int)(p_slash - p_files[i]) : 1, p_slash ? p_files[i] : ".");
+        if (i == 0) {
+            snprintf(p_watch->directory, sizeof(p_watch->directory), "%s", directory);
+        }
+        VERIFY(strcmp(directory, p_watch->directory) == 0, "%s is not in %s\n", p_files[i], p_watch->directory);
+        snprintf(p_watch->files[i], sizeof(p_watch->files[i]), "%s", p_slash ? p_slash + 1 : p_files[i]);
+    }
+    p_watch->files_count = files_count;
+
+    p_watch->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (p_watch->inotify_fd < 0 || inotify_add_watch(p_watch->inotify_fd, p_watch->directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        printf("Warning: cannot watch %s, shaders will not reload\n", p_watch->directory);
+        if (p_watch->inotify_fd >= 0) close(p_watch->inotify_fd);
+        p_watch->inotify_fd = -1;
+        return;
+    }
+    int result = pipe(p_watch->stop_fds);
+    VERIFY(result == 0, "Failed to create pipe\n");
+    pthread_mutex_init(&p_watch->mutex, NULL);
+    result = pthread_create(&p_watch->thread, NULL, WatchThread, p_watch);
+    VERIFY(result == 0, "Failed to create shader watch thread\n");
+    p_watch->running = true;
+    printf("Watching %u shaders in %s\n", files_count, p_watch->directory);
+}
+
+// Call at a frame boundary on the render thread, swaps in the newest pipeline built since the last call
+void Vk_ShaderWatch_Apply(Vk_ShaderWatch* p_watch) {
+    VERIFY(p_watch, "NULL pointer");
+    if (!p_watch->running || __atomic_load_n(&p_watch->generation, __ATOMIC_ACQUIRE) == p_watch->applied_generation) {
+        return;
+    }
+    pthread_mutex_lock(&p_watch->mutex);
+    VkPipeline pipeline = p_watch->pending;
+    p_watch->pending = VK_NULL_HANDLE;
+    p_watch->applied_generation = p_watch->generation;
+    pthread_mutex_unlock(&p_watch->mutex);
+
+    if (pipeline != VK_NULL_HANDLE) {
+        TRACK(p_watch->apply(p_watch->p_arg, pipeline));
+        printf("Shader reload applied (generation %llu)\n", (unsigned long long)p_watch->applied_generation);
+    }
+}
+
+void Vk_ShaderWatch_Stop(Vk_ShaderWatch* p_watch) {
+    VERIFY(p_watch, "NULL pointer");
+    if (!p_watch->running) {
+        return;
+    }
+    char stop = 1;
+    ssize_t written = write(p_watch->stop_fds[1], &stop, 1);
+    VERIFY(written == 1, "Failed to stop the shader watch thread\n");
+    pthread_join(p_watch->thread, NULL);
+    close(p_watch->stop_fds[0]);
+    close(p_watch->stop_fds[1]);
+    close(p_watch->inotify_fd);
+    pthread_mutex_destroy(&p_watch->mutex);
+    if (p_watch->pending != VK_NULL_HANDLE) {
+        vkDestroyPipeline(p_watch->p_vk->device, p_watch->pending, NULL);
+    }
+    memset(p_watch, 0, sizeof(Vk_ShaderWatch));
+}
@@ -0,0 +1,157 @@
+#include "vk.h"
+
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    Vk_TaskGraph*   p_graph;
+    unsigned int    thread;
+} Worker;
+
+static double NowMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1000000.0;
+}
+
+// Called with the mutex held
+static Vk_Task* NextReadyTask(Vk_TaskGraph* p_graph, unsigned int thread) {
+    for (unsigned int i = 0; i < p_graph->tasks_count; ++i) {
+        Vk_Task* p_task = &p_graph->tasks[i];
+        if (p_task->started || (p_task->main_thread && thread != 0)) {
+            continue;
+        }
+        bool ready = true;
+        for (unsigned int d = 0; d < p_task->dependencies_count && ready; ++d) {
+            ready = p_graph->tasks[p_task->dependencies[d]].finished;
+        }
+        if (ready) {
+            return p_task;
+        }
+    }
+    return NULL;
+}
+
+static void WorkUntilDone(Vk_TaskGraph* p_graph, unsigned int thread) {
+    pthread_mutex_lock(&p_graph->mutex);
+    while (p_graph->finished_count < p_graph->tasks_count) {
+        Vk_Task* p_task = NextReadyTask(p_graph, thread);
+        if (!p_task) {
+            pthread_cond_wait(&p_graph->condition, &p_graph->mutex);
+            continue;
+        }
+        p_task->started = true;
+        p_task->thread = thread;
+        p_task->start_ms = NowMs() - p_graph->run_start_ms;
+        pthread_mutex_unlock(&p_graph->mutex);
+
+        TRACK(p_task->function(p_task->p_arg));
+
+        pthread_mutex_lock(&p_graph->mutex);
+        p_task->end_ms = NowMs() - p_graph->run_start_ms;
+        p_task->finished = true;
+        p_graph->finished_count++;
+        pthread_cond_broadcast(&p_graph->condition);
+    }
+    pthread_mutex_unlock(&p_graph->mutex);
+}
+
+static void* WorkerMain(void* p_arg) {
+    Worker* p_worker = (Worker*)p_arg;
+    WorkUntilDone(p_worker->p_graph, p_worker->thread);
+    DebugThreadEnd();
+    return NULL;
+}
+
+// threads_count includes the calling thread, 0 uses one thread per online core
+Vk_TaskGraph Vk_TaskGraph_Create(unsigned int threads_count) {
+    Vk_TaskGraph graph;
+    memset(&graph, 0, sizeof(Vk_TaskGraph));
+    if (threads_count == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads_count = cores > 0 ? (unsigned int)cores : 1;
+    }
+    graph.threads_count = threads_count < VK_TASK_GRAPH_MAX_THREADS ? threads_count : VK_TASK_GRAPH_MAX_THREADS;
+    return graph;
+}
+
+// Dependencies are ids returned by earlier calls, which keeps the graph acyclic
+unsigned int Vk_TaskGraph_Add(Vk_TaskGraph* p_graph, const char* p_name, Vk_TaskFunction function, void* p_arg, bool main_thread, const unsigned int* p_dependencies, unsigned int dependencies_count) {
+    VERIFY(p_graph, "NULL pointer");
+    VERIFY(function, "NULL pointer");
+    VERIFY(p_graph->tasks_count < VK_TASK_GRAPH_MAX_TASKS, "more than %d tasks", VK_TASK_GRAPH_MAX_TASKS);
+    VERIFY(dependencies_count <= VK_TASK_MAX_DEPENDENCIES, "more than %d dependencies", VK_TASK_MAX_DEPENDENCIES);
+    VERIFY(p_dependencies || dependencies_count == 0, "NULL pointer");
+
+    unsigned int id = p_graph->tasks_count++;
+    Vk_Task* p_task = &p_graph->tasks[id];
+    memset(p_task, 0, sizeof(Vk_Task));
+    p_task->p_name = p_name;
+    p_task->function = function;
+    p_task->p_arg = p_arg;
+    p_task->main_thread = main_thread;
+    for (unsigned int i = 0; i < dependencies_count; ++i) {
+        VERIFY(p_dependencies[i] < id, "task '%s' depends on a task added after it", p_name);
+        p_task->dependencies[i] = p_dependencies[i];
+    }
+    p_task->dependencies_count = dependencies_count;
+    return id;
+}
+
+// Runs every task once its dependencies finished, on the calling thread and threads_count - 1 workers
+void Vk_TaskGraph_Run(Vk_TaskGraph* p_graph) {
+    VERIFY(p_graph, "NULL pointer");
+    pthread_mutex_init(&p_graph->mutex, NULL);
+    pthread_cond_init(&p_graph->condition, NULL);
+    p_graph->finished_count = 0;
+    p_graph->run_start_ms = NowMs();
+
+    // no point in more workers than tasks
+    unsigned int workers_count = p_graph->threads_count - 1;
+    if (workers_count > p_graph->tasks_count) {
+        workers_count = p_graph->tasks_count;
+    }
+    pthread_t threads[VK_TASK_GRAPH_MAX_THREADS];
+    Worker workers[VK_TASK_GRAPH_MAX_THREADS];
+    for (unsigned int i = 0; i < workers_count; ++i) {
+        workers[i] = (Worker){ .p_graph = p_graph, .thread = i + 1 };
+        VERIFY(pthread_create(&threads[i], NULL, WorkerMain, &workers[i]) == 0, "Failed to create task graph worker %u\n", i + 1);
+    }
+    WorkUntilDone(p_graph, 0);
+    for (unsigned int i = 0; i < workers_count; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    p_graph->run_ms = NowMs() - p_graph->run_start_ms;
+    pthread_cond_destroy(&p_graph->condition);
+    pthread_mutex_destroy(&p_graph->mutex);
+}
+
+// Per task timings in start order, and how much the threads saved over running everything serially
+void Vk_TaskGraph_PrintReport(const Vk_TaskGraph* p_graph) {
+    VERIFY(p_graph, "NULL pointer");
+
+    unsigned int order[VK_TASK_GRAPH_MAX_TASKS];
+    for (unsigned int i = 0; i < p_graph->tasks_count; ++i) {
+        order[i] = i;
+    }
+    for (unsigned int i = 1; i < p_graph->tasks_count; ++i) {
+        unsigned int id = order[i];
+        unsigned int j = i;
+        while (j > 0 && p_graph->tasks[order[j - 1]].start_ms > p_graph->tasks[id].start_ms) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = id;
+    }
+
+    double serial_ms = 0.0;
+    printf("startup: %u tasks on %u threads\n", p_graph->tasks_count, p_graph->threads_count);
+    for (unsigned int i = 0; i < p_graph->tasks_count; ++i) {
+        const Vk_Task* p_task = &p_graph->tasks[order[i]];
+        double duration_ms = p_task->end_ms - p_task->start_ms;
+        serial_ms += duration_ms;
+        printf("  %-20s thread %2u  %8.2f ms .. %8.2f ms  %8.2f ms\n", p_task->p_name, p_task->thread, p_task->start_ms, p_task->end_ms, duration_ms);
+    }
+    printf("startup: %.2f ms wall, %.2f ms if serial\n", p_graph->run_ms, serial_ms);
+}
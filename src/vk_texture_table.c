@@ -0,0 +1,151 @@
+#include "vk.h"
+
+// Combined image samplers count against both the sampled image and the sampler limits
+static unsigned int TableCapacity(Vk* p_vk) {
+    VkPhysicalDeviceDescriptorIndexingProperties indexing = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES };
+    VkPhysicalDeviceProperties2 props = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &indexing };
+    TRACK(vkGetPhysicalDeviceProperties2(p_vk->physical_device, &props));
+    unsigned int limits[] = {
+        indexing.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        indexing.maxPerStageDescriptorUpdateAfterBindSamplers,
+        indexing.maxDescriptorSetUpdateAfterBindSampledImages,
+        indexing.maxDescriptorSetUpdateAfterBindSamplers,
+    };
+    unsigned int capacity = VK_TEXTURE_TABLE_CAPACITY;
+    for (unsigned int i = 0; i < sizeof(limits) / sizeof(limits[0]); ++i) {
+        capacity = limits[i] < capacity ? limits[i] : capacity;
+    }
+    return capacity;
+}
+
+// One set that stays bound for the lifetime of the device. Update after bind lets images register while
+// frames sampling other slots are in flight, partially bound lets the slots nobody registered stay empty.
+void vk_TextureTable_Create(Vk* p_vk) {
+    VERIFY(p_vk, "NULL pointer");
+    VERIFY(p_vk->caps.descriptor_indexing, "the texture table needs descriptor indexing");
+    Vk_TextureTable* p_table = &p_vk->texture_table;
+    memset(p_table, 0, sizeof(Vk_TextureTable));
+    p_table->capacity = TableCapacity(p_vk);
+    VERIFY(p_table->capacity > 1, "the device allows %u update after bind samplers", p_table->capacity);
+    p_table->used = 1;
+    TRACK(p_table->p_free = alloc(NULL, p_table->capacity * sizeof(unsigned int)));
+    VkResult result;
+
+    VkDescriptorBindingFlags binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                             VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext        = &(VkDescriptorSetLayoutBindingFlagsCreateInfo) {
+            .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .bindingCount  = 1,
+            .pBindingFlags = &binding_flags,
+        },
+        .flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = 1,
+        .pBindings    = &(VkDescriptorSetLayoutBinding) {
+            .binding         = VK_TEXTURE_TABLE_BINDING,
+            .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = p_table->capacity,
+            .stageFlags      = VK_SHADER_STAGE_ALL,
+        },
+    };
+    TRACK(result = vkCreateDescriptorSetLayout(p_vk->device, &layout_info, NULL, &p_table->set_layout));
+    VERIFY(result == VK_SUCCESS, "Failed to create the texture table layout\n");
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets       = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes    = &(VkDescriptorPoolSize) {
+            .type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = p_table->capacity,
+        },
+    };
+    TRACK(result = vkCreateDescriptorPool(p_vk->device, &pool_info, NULL, &p_table->pool));
+    VERIFY(result == VK_SUCCESS, "Failed to create the texture table pool\n");
+
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext              = &(VkDescriptorSetVariableDescriptorCountAllocateInfo) {
+            .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
+            .descriptorSetCount = 1,
+            .pDescriptorCounts  = &p_table->capacity,
+        },
+        .descriptorPool     = p_table->pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts        = &p_table->set_layout,
+    };
+    TRACK(result = vkAllocateDescriptorSets(p_vk->device, &alloc_info, &p_table->set));
+    VERIFY(result == VK_SUCCESS, "Failed to allocate the texture table set. result = %d", result);
+    printf("Texture table with %u slots\n", p_table->capacity);
+}
+
+// After the device is idle, destroying the pool frees the set
+void vk_TextureTable_Destroy(Vk* p_vk) {
+    VERIFY(p_vk, "NULL pointer");
+    Vk_TextureTable* p_table = &p_vk->texture_table;
+    if (p_table->pool != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(p_vk->device, p_table->pool, NULL);
+    if (p_table->set_layout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(p_vk->device, p_table->set_layout, NULL);
+    if (p_table->p_free)
+        free(p_table->p_free);
+    memset(p_table, 0, sizeof(Vk_TextureTable));
+}
+
+// The slot instances pass as tex_index to sample p_image. 0 when the table is full, the image then draws
+// untextured. The descriptor expects the image in SHADER_READ_ONLY_OPTIMAL whenever it is sampled.
+unsigned int vk_TextureTable_Register(Vk* p_vk, const Image* p_image) {
+    VERIFY(p_vk && p_image, "NULL pointer");
+    VERIFY(p_image->view != VK_NULL_HANDLE && p_image->sampler != VK_NULL_HANDLE, "the image has no view or sampler");
+    Vk_TextureTable* p_table = &p_vk->texture_table;
+    VERIFY(p_table->set != VK_NULL_HANDLE, "the texture table is not created");
+
+    unsigned int texture_index;
+    if (p_table->free_count > 0) {
+        texture_index = p_table->p_free[--p_table->free_count];
+    } else if (p_table->used < p_table->capacity) {
+        texture_index = p_table->used++;
+    } else {
+        printf("Warning: the texture table is full, %u slots\n", p_table->capacity);
+        return 0;
+    }
+
+    VkWriteDescriptorSet desc_write = {
+        .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet          = p_table->set,
+        .dstBinding      = VK_TEXTURE_TABLE_BINDING,
+        .dstArrayElement = texture_index,
+        .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .pImageInfo      = &(VkDescriptorImageInfo) {
+            .sampler     = p_image->sampler,
+            .imageView   = p_image->view,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        },
+    };
+    TRACK(vkUpdateDescriptorSets(p_vk->device, 1, &desc_write, 0, NULL));
+    return texture_index;
+}
+
+// The stale descriptor stays until the slot is reused, frames still in flight may sample it. Images retired
+// through the deletion queue release their slot once those frames are done.
+void vk_TextureTable_Unregister(Vk* p_vk, unsigned int texture_index) {
+    VERIFY(p_vk, "NULL pointer");
+    Vk_TextureTable* p_table = &p_vk->texture_table;
+    if (texture_index == 0 || p_table->p_free == NULL) {
+        return;
+    }
+    VERIFY(texture_index < p_table->used && p_table->free_count < p_table->capacity, "texture slot %u was not registered", texture_index);
+    p_table->p_free[p_table->free_count++] = texture_index;
+}
+
+// A reflected set that is the texture table, its layout and set are the shared ones instead of per pipeline
+bool vk_TextureTable_IsLayout(Vk* p_vk, unsigned int set_number, const VkDescriptorSetLayoutCreateInfo* p_create_info) {
+    VERIFY(p_vk && p_create_info, "NULL pointer");
+    return set_number == VK_TEXTURE_TABLE_SET && p_create_info->bindingCount == 1 &&
+           p_create_info->pBindings[0].binding == VK_TEXTURE_TABLE_BINDING &&
+           p_create_info->pBindings[0].descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER &&
+           p_create_info->pBindings[0].descriptorCount == p_vk->texture_table.capacity;
+}